@@ -3,6 +3,47 @@ USE bh1750_db;
 
 CREATE TABLE IF NOT EXISTS data (
     id INT AUTO_INCREMENT PRIMARY KEY,
-    timestamp TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
-    lux FLOAT
-)
\ No newline at end of file
+    timestamp TIMESTAMP(6) DEFAULT CURRENT_TIMESTAMP(6), -- Device time of the sample
+    received_at TIMESTAMP(3) NULL,  -- Server time of the upload, only for latency metrics
+    lux FLOAT,                  -- Set by JSON uploads that already carry lux
+    raw SMALLINT UNSIGNED,      -- BH1750 count from binary frames, lux is derived on read
+    mode TINYINT UNSIGNED,      -- BH1750 measurement mode of raw
+    mtreg TINYINT UNSIGNED,     -- BH1750 MTreg of raw
+    channel TINYINT UNSIGNED NOT NULL DEFAULT 0, -- Sensor channel on the device (2 * I2C port + ADDR pin)
+    device INT UNSIGNED NOT NULL DEFAULT 0,      -- Device id of binary frames (low 4 bytes of the MAC), 0 for JSON uploads
+    INDEX idx_data_time (timestamp, id),                  -- /history pages, newest first
+    INDEX idx_data_channel_time (channel, timestamp, id), -- Per-channel ranges and pages
+    INDEX idx_data_channel_device_time (channel, device, timestamp) -- Ranges of one device, /api/steps
+);
+
+-- One row per channel and aggregation window, sent instead of the raw samples
+CREATE TABLE IF NOT EXISTS data_window (
+    id INT AUTO_INCREMENT PRIMARY KEY,
+    timestamp TIMESTAMP(3) NOT NULL,     -- Window start, device time
+    received_at TIMESTAMP(3) NULL,       -- Server time of the upload, only for latency metrics
+    window_ms INT UNSIGNED NOT NULL,     -- Window length
+    channel TINYINT UNSIGNED NOT NULL DEFAULT 0,
+    device INT UNSIGNED NOT NULL DEFAULT 0, -- Always 0, windows only arrive as JSON
+    count SMALLINT UNSIGNED NOT NULL,    -- Samples in the window
+    lux_min FLOAT,
+    lux_max FLOAT,
+    lux_mean FLOAT,
+    lux_stddev FLOAT,                    -- Sample standard deviation
+    lux_first FLOAT,
+    lux_last FLOAT,
+    INDEX idx_window_channel_time (channel, timestamp)
+);
+
+-- Lux aggregates of the data table per channel, device and fixed bucket, for /api/series over long ranges.
+-- Kept up to date by every insert into data, rebuilt from it with server/rollup.py.
+CREATE TABLE IF NOT EXISTS data_rollup (
+    channel TINYINT UNSIGNED NOT NULL,
+    device INT UNSIGNED NOT NULL DEFAULT 0,
+    resolution_s INT UNSIGNED NOT NULL,  -- Bucket length, 60 or 3600
+    bucket TIMESTAMP NOT NULL,           -- Bucket start, a multiple of resolution_s since the epoch
+    count INT UNSIGNED NOT NULL,         -- Samples with a lux value in the bucket
+    lux_min FLOAT NOT NULL,
+    lux_max FLOAT NOT NULL,
+    lux_sum DOUBLE NOT NULL,             -- Mean is lux_sum / count, sums merge where means do not
+    PRIMARY KEY (channel, device, resolution_s, bucket) -- A series of one device reads a key range
+);
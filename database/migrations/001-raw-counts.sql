@@ -0,0 +1,8 @@
+-- Raw BH1750 counts from binary frames, lux is derived on read.
+-- Existing rows keep their lux and get NULL counts.
+USE bh1750_db;
+
+ALTER TABLE data
+    ADD COLUMN raw SMALLINT UNSIGNED AFTER lux,
+    ADD COLUMN mode TINYINT UNSIGNED AFTER raw,
+    ADD COLUMN mtreg TINYINT UNSIGNED AFTER mode;
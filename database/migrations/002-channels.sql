@@ -0,0 +1,6 @@
+-- Sensor channel of every sample, for devices with several BH1750s.
+-- Existing rows come from single-sensor firmware and get channel 0.
+USE bh1750_db;
+
+ALTER TABLE data
+    ADD COLUMN channel TINYINT UNSIGNED NOT NULL DEFAULT 0 AFTER mtreg;
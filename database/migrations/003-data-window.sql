@@ -0,0 +1,17 @@
+-- Window summaries from on-device aggregation.
+USE bh1750_db;
+
+CREATE TABLE IF NOT EXISTS data_window (
+    id INT AUTO_INCREMENT PRIMARY KEY,
+    timestamp TIMESTAMP(3) NOT NULL,
+    window_ms INT UNSIGNED NOT NULL,
+    channel TINYINT UNSIGNED NOT NULL DEFAULT 0,
+    count SMALLINT UNSIGNED NOT NULL,
+    lux_min FLOAT,
+    lux_max FLOAT,
+    lux_mean FLOAT,
+    lux_stddev FLOAT,
+    lux_first FLOAT,
+    lux_last FLOAT,
+    INDEX idx_window_channel_time (channel, timestamp)
+);
@@ -0,0 +1,13 @@
+-- Samples are stored at their device time in us, the receive time goes into received_at.
+-- Existing timestamps keep their value, which is the time the server stored them, and
+-- get NULL in received_at, so /api/latency leaves them out.
+-- The explicit DEFAULT also drops the ON UPDATE CURRENT_TIMESTAMP that MySQL adds to the
+-- first TIMESTAMP column of a table without explicit_defaults_for_timestamp.
+USE bh1750_db;
+
+ALTER TABLE data
+    MODIFY COLUMN timestamp TIMESTAMP(6) DEFAULT CURRENT_TIMESTAMP(6),
+    ADD COLUMN received_at TIMESTAMP(3) NULL AFTER timestamp;
+
+ALTER TABLE data_window
+    ADD COLUMN received_at TIMESTAMP(3) NULL AFTER timestamp;
@@ -0,0 +1,8 @@
+-- Indexes for the keyset pages of /history and per-channel ranges.
+-- Built online, inserts go on while they are built.
+USE bh1750_db;
+
+ALTER TABLE data
+    ADD INDEX idx_data_time (timestamp, id),
+    ADD INDEX idx_data_channel_time (channel, timestamp, id),
+    ALGORITHM = INPLACE, LOCK = NONE;
@@ -0,0 +1,15 @@
+-- Lux rollups for /api/series. The table starts empty: once this has run and the
+-- server or gateway of this version is up, fill it from the stored samples with
+--   python server/rollup.py
+USE bh1750_db;
+
+CREATE TABLE IF NOT EXISTS data_rollup (
+    channel TINYINT UNSIGNED NOT NULL,
+    resolution_s INT UNSIGNED NOT NULL,
+    bucket TIMESTAMP NOT NULL,
+    count INT UNSIGNED NOT NULL,
+    lux_min FLOAT NOT NULL,
+    lux_max FLOAT NOT NULL,
+    lux_sum DOUBLE NOT NULL,
+    PRIMARY KEY (channel, resolution_s, bucket)
+);
@@ -0,0 +1,15 @@
+-- Device id of binary frames with every row, and in the rollup key.
+-- Rows stored before carry no device id and get 0, like JSON uploads. Their rollups
+-- are kept and get device 0 as well, so they still match the data table.
+USE bh1750_db;
+
+ALTER TABLE data
+    ADD COLUMN device INT UNSIGNED NOT NULL DEFAULT 0 AFTER channel;
+
+ALTER TABLE data_window
+    ADD COLUMN device INT UNSIGNED NOT NULL DEFAULT 0 AFTER channel;
+
+ALTER TABLE data_rollup
+    ADD COLUMN device INT UNSIGNED NOT NULL DEFAULT 0 AFTER bucket,
+    DROP PRIMARY KEY,
+    ADD PRIMARY KEY (channel, resolution_s, bucket, device);
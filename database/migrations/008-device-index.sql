@@ -0,0 +1,7 @@
+-- Index for the ranges of one device on a channel, /api/steps reads one device's reports at a time.
+-- Built online, inserts go on while it is built.
+USE bh1750_db;
+
+ALTER TABLE data
+    ADD INDEX idx_data_channel_device_time (channel, device, timestamp),
+    ALGORITHM = INPLACE, LOCK = NONE;
@@ -0,0 +1,6 @@
+-- /api/series reads one device of a channel, the rollup key leads with both.
+USE bh1750_db;
+
+ALTER TABLE data_rollup
+    DROP PRIMARY KEY,
+    ADD PRIMARY KEY (channel, device, resolution_s, bucket);
@@ -0,0 +1,278 @@
+/*
+ * SPDX-FileCopyrightText: 2015-2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "sdkconfig.h"
+#include "bh1750.h"
+#include "i2c_bus.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/projdefs.h" // for pdMS_TO_TICKS
+#include "freertos/task.h"
+
+#define BH_1750_MEASUREMENT_ACCURACY    1.2f   /*!< the typical measurement accuracy of  BH1750 sensor */
+
+#define BH1750_H_RES_CONVERSION_US  120000 /*!< Typical H-Resolution conversion time at the default MTreg*/
+#define BH1750_L_RES_CONVERSION_US  16000  /*!< Typical L-Resolution conversion time at the default MTreg*/
+
+#define BH1750_POWER_DOWN        0x00    /*!< Command to set Power Down*/
+#define BH1750_POWER_ON          0x01    /*!< Command to set Power On*/
+#define I2C_CLK_SPEED            400000  /*!< Fast-mode, the bus manager may run slower for other devices*/
+
+typedef struct {
+    i2c_bus_device_handle_t i2c_handle;
+    bh1750_measure_mode_t mode;
+    uint8_t mtreg;
+    int timeout_ms;
+    /* Pending asynchronous call */
+    i2c_bus_op_t op;
+    uint8_t buf[2];
+    bh1750_measure_mode_t pending_mode;
+    bh1750_raw_data_t *data;
+    bh1750_done_cb_t cb;
+    void *cb_arg;
+    volatile bool busy;
+} bh1750_dev_t;
+
+#if CONFIG_BH1750_STATIC_INSTANCES > 0
+static bh1750_dev_t s_pool[CONFIG_BH1750_STATIC_INSTANCES];
+static bool s_pool_used[CONFIG_BH1750_STATIC_INSTANCES];
+static portMUX_TYPE s_pool_lock = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+/**
+ * @brief Take a zeroed handle from the static pool, or from the heap without one.
+ */
+static bh1750_dev_t *bh1750_alloc(void)
+{
+#if CONFIG_BH1750_STATIC_INSTANCES > 0
+    bh1750_dev_t *sens = NULL;
+    portENTER_CRITICAL(&s_pool_lock);
+    for (size_t i = 0; i < CONFIG_BH1750_STATIC_INSTANCES; i++) {
+        if (!s_pool_used[i]) {
+            s_pool_used[i] = true;
+            sens = &s_pool[i];
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_pool_lock);
+    if (sens) {
+        memset(sens, 0, sizeof(*sens));
+    }
+    return sens;
+#else
+    return (bh1750_dev_t *) calloc(1, sizeof(bh1750_dev_t));
+#endif
+}
+
+static void bh1750_free(bh1750_dev_t *sens)
+{
+#if CONFIG_BH1750_STATIC_INSTANCES > 0
+    portENTER_CRITICAL(&s_pool_lock);
+    s_pool_used[sens - s_pool] = false;
+    portEXIT_CRITICAL(&s_pool_lock);
+#else
+    free(sens);
+#endif
+}
+
+static esp_err_t bh1750_write_byte(const bh1750_dev_t *const sens, const uint8_t byte)
+{
+    return i2c_bus_transmit(sens->i2c_handle, &byte, 1, sens->timeout_ms);
+}
+
+static void bh1750_async_done(i2c_bus_op_t *op)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) op->arg;
+    if (ESP_OK == op->result) {
+        if (op->rx) {
+            sens->data->raw = (uint16_t)(sens->buf[0] << 8 | sens->buf[1]);
+            sens->data->mode = sens->mode;
+            sens->data->mtreg = sens->mtreg;
+        } else {
+            sens->mode = sens->pending_mode;
+        }
+    }
+    sens->busy = false;
+    if (sens->cb) {
+        sens->cb(sens, op->result, sens->cb_arg);
+    } else {
+        xTaskNotifyGive(op->notify_task);
+    }
+}
+
+static esp_err_t bh1750_submit(bh1750_dev_t *sens, bool read, bh1750_done_cb_t cb, void *arg)
+{
+    if (sens->busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sens->busy = true;
+    sens->cb = cb;
+    sens->cb_arg = arg;
+    sens->op = (i2c_bus_op_t) {
+        .dev = sens->i2c_handle,
+        .tx = read ? NULL : sens->buf,
+        .rx = read ? sens->buf : NULL,
+        .len = read ? 2 : 1,
+        .timeout_ms = sens->timeout_ms,
+        .done_cb = bh1750_async_done,
+        .notify_task = xTaskGetCurrentTaskHandle(),
+        .arg = sens,
+        .result = ESP_ERR_INVALID_STATE,
+    };
+    esp_err_t ret = i2c_bus_submit(&sens->op);
+    if (ESP_OK != ret) {
+        sens->op.result = ret;
+        sens->busy = false;
+    }
+    return ret;
+}
+
+esp_err_t bh1750_create(i2c_master_bus_handle_t i2c_bus, const uint8_t dev_addr, bh1750_handle_t *handle_ret)
+{
+    esp_err_t ret = ESP_OK;
+    bh1750_dev_t *sensor = bh1750_alloc();
+    if (!sensor) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Register with the shared bus, creating the same sensor twice shares one device
+    ret = i2c_bus_add_device(i2c_bus, dev_addr, I2C_CLK_SPEED, &sensor->i2c_handle);
+    if (ret != ESP_OK) {
+        bh1750_free(sensor);
+        return ret;
+    }
+
+    assert(sensor->i2c_handle);
+    sensor->mode = BH1750_CONTINUE_1LX_RES;
+    sensor->mtreg = BH1750_MTREG_DEFAULT;
+    sensor->timeout_ms = BH1750_I2C_TIMEOUT_MS_DEFAULT;
+    sensor->op.result = ESP_OK;
+    *handle_ret = sensor;
+    return ret;
+}
+
+esp_err_t bh1750_delete(bh1750_handle_t sensor)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    if (sens->i2c_handle) {
+        i2c_bus_remove_device(sens->i2c_handle);
+    }
+    bh1750_free(sens);
+    return ESP_OK;
+}
+
+esp_err_t bh1750_power_down(bh1750_handle_t sensor)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    return bh1750_write_byte(sens, BH1750_POWER_DOWN);
+}
+
+esp_err_t bh1750_power_on(bh1750_handle_t sensor)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    return bh1750_write_byte(sens, BH1750_POWER_ON);
+}
+
+esp_err_t bh1750_set_measure_time(bh1750_handle_t sensor, const uint8_t measure_time)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    uint32_t i = 0;
+    uint8_t buf[2] = {0x40, 0x60}; // constant part of the the MTreg
+    buf[0] |= measure_time >> 5;
+    buf[1] |= measure_time & 0x1F;
+    for (i = 0; i < 2; i++) {
+        esp_err_t ret = bh1750_write_byte(sens, buf[i]);
+        if (ESP_OK != ret) {
+            return ret;
+        }
+    }
+    sens->mtreg = measure_time;
+    return ESP_OK;
+}
+
+esp_err_t bh1750_set_measure_mode(bh1750_handle_t sensor, const bh1750_measure_mode_t cmd_measure)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    esp_err_t ret = bh1750_write_byte(sens, (uint8_t)cmd_measure);
+    if (ESP_OK == ret) {
+        sens->mode = cmd_measure;
+    }
+    return ret;
+}
+
+esp_err_t bh1750_get_raw_data(bh1750_handle_t sensor, bh1750_raw_data_t *const data)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    uint8_t read_buffer[2];
+    esp_err_t ret = i2c_bus_receive(sens->i2c_handle, read_buffer, sizeof(read_buffer), sens->timeout_ms);
+    if (ESP_OK != ret) {
+        return ret;
+    }
+    data->raw = (uint16_t)(read_buffer[0] << 8 | read_buffer[1]);
+    data->mode = sens->mode;
+    data->mtreg = sens->mtreg;
+    return ESP_OK;
+}
+
+esp_err_t bh1750_set_timeout(bh1750_handle_t sensor, int timeout_ms)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    sens->timeout_ms = timeout_ms;
+    return ESP_OK;
+}
+
+esp_err_t bh1750_set_measure_mode_async(bh1750_handle_t sensor, const bh1750_measure_mode_t cmd_measure, bh1750_done_cb_t cb, void *arg)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    if (sens->busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sens->buf[0] = (uint8_t)cmd_measure;
+    sens->pending_mode = cmd_measure;
+    return bh1750_submit(sens, false, cb, arg);
+}
+
+esp_err_t bh1750_get_raw_data_async(bh1750_handle_t sensor, bh1750_raw_data_t *const data, bh1750_done_cb_t cb, void *arg)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    if (sens->busy) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sens->data = data;
+    return bh1750_submit(sens, true, cb, arg);
+}
+
+esp_err_t bh1750_async_result(bh1750_handle_t sensor)
+{
+    bh1750_dev_t *sens = (bh1750_dev_t *) sensor;
+    return sens->busy ? ESP_ERR_INVALID_STATE : sens->op.result;
+}
+
+float bh1750_lux_per_count(const bh1750_measure_mode_t mode, const uint8_t mtreg)
+{
+    float lux_per_count = (float)BH1750_MTREG_DEFAULT / (BH_1750_MEASUREMENT_ACCURACY * (mtreg ? mtreg : BH1750_MTREG_DEFAULT));
+    if (mode == BH1750_CONTINUE_HALFLX_RES || mode == BH1750_ONETIME_HALFLX_RES) {
+        lux_per_count /= 2;
+    }
+    return lux_per_count;
+}
+
+uint32_t bh1750_conversion_time_us(const bh1750_measure_mode_t mode, const uint8_t mtreg)
+{
+    uint32_t base_us = (mode == BH1750_CONTINUE_4LX_RES || mode == BH1750_ONETIME_4LX_RES) ? BH1750_L_RES_CONVERSION_US : BH1750_H_RES_CONVERSION_US;
+    return base_us * (mtreg ? mtreg : BH1750_MTREG_DEFAULT) / BH1750_MTREG_DEFAULT;
+}
+
+esp_err_t bh1750_get_data(bh1750_handle_t sensor, float *const data)
+{
+    bh1750_raw_data_t raw_data;
+    esp_err_t ret = bh1750_get_raw_data(sensor, &raw_data);
+    if (ESP_OK != ret) {
+        return ret;
+    }
+    *data = raw_data.raw * bh1750_lux_per_count(raw_data.mode, raw_data.mtreg);
+    return ESP_OK;
+}
@@ -0,0 +1,268 @@
+/*
+ * SPDX-FileCopyrightText: 2015-2025 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/**
+ * @file
+ * @brief BH1750 driver
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "driver/i2c_types.h"
+#include "esp_err.h"
+
+typedef enum {
+    BH1750_CONTINUE_1LX_RES       = 0x10,   /*!< Command to set measure mode as Continuously H-Resolution mode*/
+    BH1750_CONTINUE_HALFLX_RES    = 0x11,   /*!< Command to set measure mode as Continuously H-Resolution mode2*/
+    BH1750_CONTINUE_4LX_RES       = 0x13,   /*!< Command to set measure mode as Continuously L-Resolution mode*/
+    BH1750_ONETIME_1LX_RES        = 0x20,   /*!< Command to set measure mode as One Time H-Resolution mode*/
+    BH1750_ONETIME_HALFLX_RES     = 0x21,   /*!< Command to set measure mode as One Time H-Resolution mode2*/
+    BH1750_ONETIME_4LX_RES        = 0x23,   /*!< Command to set measure mode as One Time L-Resolution mode*/
+} bh1750_measure_mode_t;
+
+#define BH1750_I2C_ADDRESS_DEFAULT   (0x23)
+#define BH1750_I2C_ADDRESS_HIGH      (0x5C)    /*!< Address with the ADDR pin pulled high*/
+#define BH1750_MTREG_DEFAULT         (69)      /*!< MTreg value after power on*/
+#define BH1750_I2C_TIMEOUT_MS_DEFAULT (50)     /*!< I2C transfer timeout until bh1750_set_timeout() is called*/
+typedef void *bh1750_handle_t;
+
+/**
+ * @brief Raw measurement result together with the settings it was taken with
+ */
+typedef struct {
+    uint16_t raw;                   /*!< 16-bit count from the data register*/
+    bh1750_measure_mode_t mode;     /*!< Measurement mode active when the count was read*/
+    uint8_t mtreg;                  /*!< MTreg active when the count was read*/
+} bh1750_raw_data_t;
+
+/**
+ * @brief Completion callback of the asynchronous calls
+ *
+ * Called from the I2C bus worker task, keep it short and do not block.
+ *
+ * @param sensor object handle of bh1750
+ * @param result ESP_OK or the error of the transfer
+ * @param arg    argument given when the call was submitted
+ */
+typedef void (*bh1750_done_cb_t)(bh1750_handle_t sensor, esp_err_t result, void *arg);
+
+/**
+ * @brief Set bh1750 as power down mode (low current)
+ *
+ * @param sensor object handle of bh1750
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail
+ */
+esp_err_t bh1750_power_down(bh1750_handle_t sensor);
+
+/**
+ * @brief Set bh1750 as power on mode
+ *
+ * @param sensor object handle of bh1750
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail
+ */
+esp_err_t bh1750_power_on(bh1750_handle_t sensor);
+
+/**
+ * @brief Get light intensity from bh1750
+ *
+ * @param     sensor object handle of bh1750
+ * @param[in] cmd_measure the instruction to set measurement mode
+ *
+ * @note
+ *        You should call this funtion to set measurement mode before call bh1750_get_data() to acquire data.
+ *        If you set onetime mode, you just can get one measurement result.
+ *        If you set continuous mode, you can call bh1750_get_data() to acquire data repeatedly.
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail
+ */
+esp_err_t bh1750_set_measure_mode(bh1750_handle_t sensor, const bh1750_measure_mode_t cmd_measure);
+
+/**
+ * @brief Get light intensity from BH1750
+ *
+ * Returns light intensity in [lx] corrected by typical BH1750 Measurement Accuracy (= 1.2),
+ * the active MTreg and the resolution of the active measurement mode.
+ *
+ * @see BH1750 datasheet Rev. D page 2
+ *
+ * @note
+ *        You should acquire data from the sensor after the measurement time is over,
+ *        so take care of measurement time in different modes.
+ *
+ * @param      sensor object handle of bh1750
+ * @param[out] data light intensity value got from bh1750 in [lx]
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail
+ */
+esp_err_t bh1750_get_data(bh1750_handle_t sensor, float *const data);
+
+/**
+ * @brief Get the raw 16-bit count from BH1750 without converting it to lux
+ *
+ * The active measurement mode and MTreg are returned with the count, so the
+ * conversion can be done later with bh1750_lux_per_count().
+ *
+ * @param      sensor object handle of bh1750
+ * @param[out] data raw count, mode and MTreg
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail
+ */
+esp_err_t bh1750_get_raw_data(bh1750_handle_t sensor, bh1750_raw_data_t *const data);
+
+/**
+ * @brief Set the I2C transfer timeout
+ *
+ * A transfer that times out is followed by a bus recovery, so a short timeout
+ * bounds how long a hung bus stalls the caller.
+ *
+ * @param sensor     object handle of bh1750
+ * @param timeout_ms timeout of each transfer, -1 to wait forever
+ *
+ * @return
+ *     - ESP_OK Success
+ */
+esp_err_t bh1750_set_timeout(bh1750_handle_t sensor, int timeout_ms);
+
+/**
+ * @brief Asynchronous bh1750_set_measure_mode()
+ *
+ * Queues the command to the I2C bus worker and returns right away. On
+ * completion cb is called, or the calling task is notified with
+ * xTaskNotifyGive() if cb is NULL and the result is read with bh1750_async_result().
+ * One asynchronous call per sensor can be pending.
+ *
+ * @param     sensor object handle of bh1750
+ * @param[in] cmd_measure the instruction to set measurement mode
+ * @param     cb  completion callback, NULL to notify the calling task
+ * @param     arg passed to cb
+ *
+ * @return
+ *     - ESP_OK Submitted
+ *     - ESP_ERR_INVALID_STATE An asynchronous call of this sensor is still pending
+ *     - ESP_ERR_TIMEOUT The bus queue is full
+ */
+esp_err_t bh1750_set_measure_mode_async(bh1750_handle_t sensor, const bh1750_measure_mode_t cmd_measure, bh1750_done_cb_t cb, void *arg);
+
+/**
+ * @brief Asynchronous bh1750_get_raw_data()
+ *
+ * Completes like bh1750_set_measure_mode_async(). data is written before
+ * completion is reported and must stay valid until then.
+ *
+ * @param      sensor object handle of bh1750
+ * @param[out] data raw count, mode and MTreg
+ * @param      cb  completion callback, NULL to notify the calling task
+ * @param      arg passed to cb
+ *
+ * @return
+ *     - ESP_OK Submitted
+ *     - ESP_ERR_INVALID_STATE An asynchronous call of this sensor is still pending
+ *     - ESP_ERR_TIMEOUT The bus queue is full
+ */
+esp_err_t bh1750_get_raw_data_async(bh1750_handle_t sensor, bh1750_raw_data_t *const data, bh1750_done_cb_t cb, void *arg);
+
+/**
+ * @brief Result of the last asynchronous call
+ *
+ * @param sensor object handle of bh1750
+ *
+ * @return
+ *     - ESP_OK Success, or no asynchronous call made yet
+ *     - ESP_ERR_INVALID_STATE Still pending
+ *     - Others Error of the transfer
+ */
+esp_err_t bh1750_async_result(bh1750_handle_t sensor);
+
+/**
+ * @brief Lux represented by one count for the given mode and MTreg
+ *
+ * lux = count / 1.2 * (69 / MTreg), halved in H-Resolution mode2.
+ *
+ * @see BH1750 datasheet Rev. D page 11
+ *
+ * @param[in] mode  measurement mode the count was taken with
+ * @param[in] mtreg MTreg the count was taken with
+ *
+ * @return lux per count
+ */
+float bh1750_lux_per_count(const bh1750_measure_mode_t mode, const uint8_t mtreg);
+
+/**
+ * @brief Typical conversion time for the given mode and MTreg
+ *
+ * 120 ms in the H-Resolution modes and 16 ms in L-Resolution mode at the
+ * default MTreg, scaled by MTreg / 69. The datasheet maximum is 1.5 times this.
+ *
+ * @see BH1750 datasheet Rev. D page 2 and 11
+ *
+ * @param[in] mode  measurement mode
+ * @param[in] mtreg MTreg
+ *
+ * @return conversion time in microseconds
+ */
+uint32_t bh1750_conversion_time_us(const bh1750_measure_mode_t mode, const uint8_t mtreg);
+
+/**
+ * @brief Set measurement time
+ *
+ * This function is used to adjust BH1750 sensitivity, i.e. compensating influence from optical window.
+ *
+ * @see BH1750 datasheet Rev. D page 11
+ *
+ * @param     sensor object handle of bh1750
+ * @param[in] measure_time measurement time
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail
+ */
+esp_err_t bh1750_set_measure_time(bh1750_handle_t sensor, const uint8_t measure_time);
+
+/**
+ * @brief Create and init sensor object and return a sensor handle
+ *
+ * @param[in]  i2c_bus    I2C bus handle. Obtained from i2c_new_master_bus().s
+ * @param[in]  dev_addr   I2C device address of sensor. Use BH1750_I2C_ADDRESS_DEFAULT for default address, BH1750_I2C_ADDRESS_HIGH with ADDR pulled high.
+ * @param[out] handle_ret Handle to created BH1750 driver object.
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_NO_MEM Not enough memory for the driver, or all CONFIG_BH1750_STATIC_INSTANCES handles in use
+ *     - ESP_ERR_NOT_FOUND Sensor not found on the I2C bus
+ *     - Others Error from underlying I2C driver
+ */
+esp_err_t bh1750_create(i2c_master_bus_handle_t i2c_bus, const uint8_t dev_addr, bh1750_handle_t *handle_ret);
+
+/**
+ * @brief Delete and release a sensor object
+ *
+ * @param sensor object handle of bh1750
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL Fail
+ */
+esp_err_t bh1750_delete(bh1750_handle_t sensor);
+
+#ifdef __cplusplus
+}
+#endif
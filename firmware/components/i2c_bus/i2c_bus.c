@@ -0,0 +1,401 @@
+/**
+ * @file
+ * @brief Shared I2C bus manager, see i2c_bus.h
+ */
+
+#include <sys/lock.h>
+#include "sdkconfig.h"
+#include "i2c_bus.h"
+#include "driver/i2c_master.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+
+typedef struct i2c_bus_t i2c_bus_t;
+
+struct i2c_bus_device_t {
+    i2c_bus_t *bus;
+    i2c_master_dev_handle_t handle; /*!< Driver handle, replaced when the clock changes*/
+    uint16_t addr;
+    uint32_t max_scl_hz;
+    uint8_t refs;                   /*!< Registrations of this address, 0 for a free slot*/
+};
+
+struct i2c_bus_t {
+    i2c_master_bus_handle_t handle; /*!< NULL for a free slot*/
+    SemaphoreHandle_t lock;         /*!< Held for every transaction and while devices are moved*/
+    QueueHandle_t queue;            /*!< Submitted i2c_bus_op_t pointers, NULL until the first submit*/
+    uint32_t max_scl_hz;            /*!< Limit of the wiring*/
+    uint32_t scl_hz;                /*!< Clock the devices are registered with*/
+    struct i2c_bus_device_t devices[I2C_BUS_MAX_DEVICES];
+    portMUX_TYPE stats_lock;
+    i2c_bus_stats_t stats;
+#if CONFIG_I2C_BUS_STATIC_ALLOCATION
+    StaticSemaphore_t lock_buf;
+    StaticQueue_t queue_buf;
+    uint8_t queue_storage[I2C_BUS_QUEUE_DEPTH * sizeof(i2c_bus_op_t *)];
+    StaticTask_t task_buf;
+    StackType_t task_stack[I2C_BUS_TASK_STACK_SIZE];
+#endif
+};
+
+static i2c_bus_t s_buses[I2C_BUS_MAX_BUSES];
+static _lock_t s_registry_lock; /*!< Serializes registration, lock order is registry, then bus*/
+
+/**
+ * @brief Find the entry of a bus, optionally creating it. Call with s_registry_lock held.
+ */
+static i2c_bus_t *find_bus(i2c_master_bus_handle_t handle, bool create)
+{
+    i2c_bus_t *free_slot = NULL;
+    if (!handle) {
+        return NULL;
+    }
+    for (size_t i = 0; i < I2C_BUS_MAX_BUSES; i++) {
+        if (s_buses[i].handle == handle) {
+            return &s_buses[i];
+        }
+        if (!s_buses[i].handle && !free_slot) {
+            free_slot = &s_buses[i];
+        }
+    }
+    if (!create || !free_slot) {
+        return NULL;
+    }
+    if (!free_slot->lock) {
+#if CONFIG_I2C_BUS_STATIC_ALLOCATION
+        free_slot->lock = xSemaphoreCreateMutexStatic(&free_slot->lock_buf);
+#else
+        free_slot->lock = xSemaphoreCreateMutex();
+#endif
+        if (!free_slot->lock) {
+            return NULL;
+        }
+    }
+    free_slot->handle = handle;
+    free_slot->max_scl_hz = I2C_BUS_DEFAULT_MAX_SPEED;
+    free_slot->scl_hz = 0;
+    free_slot->stats_lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+    return free_slot;
+}
+
+static esp_err_t attach(i2c_bus_t *bus, struct i2c_bus_device_t *dev)
+{
+    const i2c_device_config_t dev_cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = dev->addr,
+        .scl_speed_hz = bus->scl_hz,
+    };
+    return i2c_master_bus_add_device(bus->handle, &dev_cfg, &dev->handle);
+}
+
+/**
+ * @brief Pick the fastest clock all devices and the wiring support and register
+ * every device with it. Devices without a driver handle yet are registered too.
+ * Call with s_registry_lock and the bus mutex held.
+ */
+static esp_err_t negotiate(i2c_bus_t *bus)
+{
+    uint32_t scl_hz = bus->max_scl_hz;
+    for (size_t i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        if (bus->devices[i].refs && bus->devices[i].max_scl_hz < scl_hz) {
+            scl_hz = bus->devices[i].max_scl_hz;
+        }
+    }
+    bool changed = (scl_hz != bus->scl_hz);
+    bus->scl_hz = scl_hz;
+
+    for (size_t i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+        struct i2c_bus_device_t *dev = &bus->devices[i];
+        if (!dev->refs) {
+            continue;
+        }
+        // The clock is fixed when a device is added to the driver, so moving it means adding it again
+        if (dev->handle && changed) {
+            esp_err_t ret = i2c_master_bus_rm_device(dev->handle);
+            if (ESP_OK != ret) {
+                return ret;
+            }
+            dev->handle = NULL;
+        }
+        if (!dev->handle) {
+            esp_err_t ret = attach(bus, dev);
+            if (ESP_OK != ret) {
+                return ret;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+static void record(i2c_bus_t *bus, int64_t wait_us, int64_t xfer_us, esp_err_t ret)
+{
+    portENTER_CRITICAL(&bus->stats_lock);
+    i2c_bus_stats_t *stats = &bus->stats;
+    stats->transactions++;
+    if (ESP_OK != ret) {
+        stats->errors++;
+    }
+    if (ESP_ERR_TIMEOUT == ret) {
+        stats->timeouts++;
+    }
+    stats->wait_us += (uint64_t)wait_us;
+    if (wait_us > stats->max_wait_us) {
+        stats->max_wait_us = (uint32_t)wait_us;
+    }
+    stats->xfer_us += (uint64_t)xfer_us;
+    if (xfer_us > stats->max_xfer_us) {
+        stats->max_xfer_us = (uint32_t)xfer_us;
+    }
+    portEXIT_CRITICAL(&bus->stats_lock);
+}
+
+/**
+ * @brief Reset the controller, the driver also clocks SCL until a stuck slave releases SDA.
+ * Call with the bus mutex held.
+ */
+static esp_err_t recover(i2c_bus_t *bus)
+{
+    esp_err_t ret = i2c_master_bus_reset(bus->handle);
+    portENTER_CRITICAL(&bus->stats_lock);
+    bus->stats.recoveries++;
+    portEXIT_CRITICAL(&bus->stats_lock);
+    return ret;
+}
+
+static TickType_t lock_ticks(int timeout_ms)
+{
+    return (timeout_ms < 0) ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms) + 1;
+}
+
+esp_err_t i2c_bus_set_max_speed(i2c_master_bus_handle_t bus_handle, uint32_t max_scl_hz)
+{
+    if (!max_scl_hz) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _lock_acquire(&s_registry_lock);
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    i2c_bus_t *bus = find_bus(bus_handle, true);
+    if (bus) {
+        xSemaphoreTake(bus->lock, portMAX_DELAY);
+        bus->max_scl_hz = max_scl_hz;
+        ret = negotiate(bus);
+        xSemaphoreGive(bus->lock);
+    }
+    _lock_release(&s_registry_lock);
+    return ret;
+}
+
+esp_err_t i2c_bus_add_device(i2c_master_bus_handle_t bus_handle, uint16_t dev_addr, uint32_t max_scl_hz, i2c_bus_device_handle_t *handle_ret)
+{
+    if (!max_scl_hz) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    _lock_acquire(&s_registry_lock);
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    i2c_bus_t *bus = find_bus(bus_handle, true);
+    struct i2c_bus_device_t *dev = NULL, *free_slot = NULL;
+    for (size_t i = 0; bus && i < I2C_BUS_MAX_DEVICES; i++) {
+        if (bus->devices[i].refs && bus->devices[i].addr == dev_addr) {
+            dev = &bus->devices[i];
+            break;
+        }
+        if (!bus->devices[i].refs && !free_slot) {
+            free_slot = &bus->devices[i];
+        }
+    }
+
+    if (dev) {
+        // Already registered, share it. A second driver may support less than the first one
+        dev->refs++;
+        ret = ESP_OK;
+        if (max_scl_hz < dev->max_scl_hz) {
+            dev->max_scl_hz = max_scl_hz;
+            xSemaphoreTake(bus->lock, portMAX_DELAY);
+            ret = negotiate(bus);
+            xSemaphoreGive(bus->lock);
+        }
+    } else if (free_slot) {
+        dev = free_slot;
+        *dev = (struct i2c_bus_device_t) {
+            .bus = bus,
+            .addr = dev_addr,
+            .max_scl_hz = max_scl_hz,
+            .refs = 1,
+        };
+        xSemaphoreTake(bus->lock, portMAX_DELAY);
+        ret = negotiate(bus);
+        if (ESP_OK != ret) {
+            if (dev->handle) {
+                i2c_master_bus_rm_device(dev->handle);
+            }
+            dev->handle = NULL;
+            dev->refs = 0;
+            negotiate(bus);
+        }
+        xSemaphoreGive(bus->lock);
+    }
+    _lock_release(&s_registry_lock);
+
+    if (ESP_OK == ret) {
+        *handle_ret = dev;
+    }
+    return ret;
+}
+
+esp_err_t i2c_bus_remove_device(i2c_bus_device_handle_t dev)
+{
+    esp_err_t ret = ESP_OK;
+    _lock_acquire(&s_registry_lock);
+    if (dev->refs && --dev->refs == 0) {
+        i2c_bus_t *bus = dev->bus;
+        xSemaphoreTake(bus->lock, portMAX_DELAY);
+        ret = i2c_master_bus_rm_device(dev->handle);
+        dev->handle = NULL;
+        if (ESP_OK == ret) {
+            // The slowest device may be gone, let the others speed up
+            ret = negotiate(bus);
+        }
+        xSemaphoreGive(bus->lock);
+    }
+    _lock_release(&s_registry_lock);
+    return ret;
+}
+
+esp_err_t i2c_bus_probe(i2c_master_bus_handle_t bus_handle, uint16_t dev_addr, int timeout_ms)
+{
+    _lock_acquire(&s_registry_lock);
+    i2c_bus_t *bus = find_bus(bus_handle, true);
+    _lock_release(&s_registry_lock);
+    if (!bus) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    if (xSemaphoreTake(bus->lock, lock_ticks(timeout_ms)) != pdTRUE) {
+        record(bus, esp_timer_get_time() - start_us, 0, ESP_ERR_TIMEOUT);
+        return ESP_ERR_TIMEOUT;
+    }
+    int64_t locked_us = esp_timer_get_time();
+    esp_err_t ret = i2c_master_probe(bus->handle, dev_addr, timeout_ms);
+    int64_t done_us = esp_timer_get_time();
+    xSemaphoreGive(bus->lock);
+    // A missing device is an answer, not a bus error
+    record(bus, locked_us - start_us, done_us - locked_us, (ESP_ERR_NOT_FOUND == ret) ? ESP_OK : ret);
+    return ret;
+}
+
+/**
+ * @brief Run one transfer while holding the bus and time it, tx for a write, rx for a read
+ */
+static esp_err_t transfer(i2c_bus_device_handle_t dev, const uint8_t *tx, uint8_t *rx, size_t len, int timeout_ms)
+{
+    i2c_bus_t *bus = dev->bus;
+    int64_t start_us = esp_timer_get_time();
+    if (xSemaphoreTake(bus->lock, lock_ticks(timeout_ms)) != pdTRUE) {
+        record(bus, esp_timer_get_time() - start_us, 0, ESP_ERR_TIMEOUT);
+        return ESP_ERR_TIMEOUT;
+    }
+    int64_t locked_us = esp_timer_get_time();
+    esp_err_t ret = tx ? i2c_master_transmit(dev->handle, tx, len, timeout_ms)
+                    : i2c_master_receive(dev->handle, rx, len, timeout_ms);
+    int64_t done_us = esp_timer_get_time();
+    if (ESP_ERR_TIMEOUT == ret) {
+        // The slave or the controller hung mid-transfer, free the bus before the next one
+        recover(bus);
+    }
+    xSemaphoreGive(bus->lock);
+    record(bus, locked_us - start_us, done_us - locked_us, ret);
+    return ret;
+}
+
+esp_err_t i2c_bus_transmit(i2c_bus_device_handle_t dev, const uint8_t *data, size_t len, int timeout_ms)
+{
+    return transfer(dev, data, NULL, len, timeout_ms);
+}
+
+esp_err_t i2c_bus_receive(i2c_bus_device_handle_t dev, uint8_t *data, size_t len, int timeout_ms)
+{
+    return transfer(dev, NULL, data, len, timeout_ms);
+}
+
+static void bus_task(void *arg)
+{
+    i2c_bus_t *bus = (i2c_bus_t *) arg;
+    i2c_bus_op_t *op;
+    // i2c_bus_submit() publishes the queue once this task exists, under the registry lock
+    _lock_acquire(&s_registry_lock);
+    QueueHandle_t queue = bus->queue;
+    _lock_release(&s_registry_lock);
+    while (1) {
+        if (xQueueReceive(queue, &op, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        op->result = transfer(op->dev, op->tx, op->rx, op->len, op->timeout_ms);
+        if (op->done_cb) {
+            op->done_cb(op);
+        } else if (op->notify_task) {
+            xTaskNotifyGive(op->notify_task);
+        }
+    }
+}
+
+esp_err_t i2c_bus_submit(i2c_bus_op_t *op)
+{
+    i2c_bus_t *bus = op->dev->bus;
+    if (!bus->queue) {
+        _lock_acquire(&s_registry_lock);
+        if (!bus->queue) {
+#if CONFIG_I2C_BUS_STATIC_ALLOCATION
+            // Cannot fail with static buffers
+            QueueHandle_t queue = xQueueCreateStatic(I2C_BUS_QUEUE_DEPTH, sizeof(i2c_bus_op_t *), bus->queue_storage, &bus->queue_buf);
+            xTaskCreateStatic(bus_task, "i2c_bus", I2C_BUS_TASK_STACK_SIZE, bus, I2C_BUS_TASK_PRIORITY, bus->task_stack, &bus->task_buf);
+#else
+            QueueHandle_t queue = xQueueCreate(I2C_BUS_QUEUE_DEPTH, sizeof(i2c_bus_op_t *));
+            if (queue && xTaskCreate(bus_task, "i2c_bus", I2C_BUS_TASK_STACK_SIZE, bus, I2C_BUS_TASK_PRIORITY, NULL) != pdPASS) {
+                vQueueDelete(queue);
+                queue = NULL;
+            }
+#endif
+            bus->queue = queue;
+        }
+        _lock_release(&s_registry_lock);
+        if (!bus->queue) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    return (xQueueSend(bus->queue, &op, 0) == pdTRUE) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+esp_err_t i2c_bus_recover(i2c_master_bus_handle_t bus_handle)
+{
+    _lock_acquire(&s_registry_lock);
+    i2c_bus_t *bus = find_bus(bus_handle, false);
+    _lock_release(&s_registry_lock);
+    if (!bus) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    xSemaphoreTake(bus->lock, portMAX_DELAY);
+    esp_err_t ret = recover(bus);
+    xSemaphoreGive(bus->lock);
+    return ret;
+}
+
+esp_err_t i2c_bus_get_stats(i2c_master_bus_handle_t bus_handle, i2c_bus_stats_t *stats)
+{
+    _lock_acquire(&s_registry_lock);
+    i2c_bus_t *bus = find_bus(bus_handle, false);
+    if (bus) {
+        portENTER_CRITICAL(&bus->stats_lock);
+        *stats = bus->stats;
+        portEXIT_CRITICAL(&bus->stats_lock);
+        stats->devices = 0;
+        for (size_t i = 0; i < I2C_BUS_MAX_DEVICES; i++) {
+            stats->devices += bus->devices[i].refs ? 1 : 0;
+        }
+        stats->scl_speed_hz = stats->devices ? bus->scl_hz : 0;
+    }
+    _lock_release(&s_registry_lock);
+    return bus ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file
+ * @brief Shared I2C bus manager
+ *
+ * Owns the device handles of every bus it has seen. Drivers register their
+ * device with the fastest SCL clock they support, registering the same address
+ * twice returns the same handle. All devices of a bus run at the fastest clock
+ * every one of them supports, capped by i2c_bus_set_max_speed().
+ *
+ * Transactions take a per-bus mutex, so several tasks can share a bus, and
+ * are timed into per-bus counters (i2c_bus_get_stats()).
+ *
+ * i2c_bus_submit() queues a transaction to a worker task of the bus and
+ * returns right away, completion is reported through a callback or a task
+ * notification. A transfer that times out is followed by a bus recovery
+ * (i2c_bus_recover()), so a hung slave costs one short timeout instead of
+ * stalling the bus.
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include "driver/i2c_types.h"
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define I2C_BUS_MAX_BUSES           2       /*!< Buses the manager can track*/
+#define I2C_BUS_MAX_DEVICES         8       /*!< Devices per bus*/
+#define I2C_BUS_DEFAULT_MAX_SPEED   400000  /*!< Bus limit when i2c_bus_set_max_speed() was not called, Fast-mode*/
+#define I2C_BUS_QUEUE_DEPTH         8       /*!< Submitted transactions waiting per bus*/
+#define I2C_BUS_TASK_STACK_SIZE     3072
+#define I2C_BUS_TASK_PRIORITY       6       /*!< Above the application tasks, transfers are short*/
+
+typedef struct i2c_bus_device_t *i2c_bus_device_handle_t;
+
+/**
+ * @brief Transaction counters of one bus
+ */
+typedef struct {
+    uint32_t transactions;  /*!< Transmits and receives, failed ones included*/
+    uint32_t errors;        /*!< Transactions that did not return ESP_OK*/
+    uint32_t timeouts;      /*!< Transactions that returned ESP_ERR_TIMEOUT, lock timeouts included*/
+    uint64_t xfer_us;       /*!< Total time spent in the I2C driver*/
+    uint32_t max_xfer_us;   /*!< Longest single transaction*/
+    uint64_t wait_us;       /*!< Total time spent waiting for the bus mutex*/
+    uint32_t max_wait_us;   /*!< Longest single wait for the bus mutex*/
+    uint32_t recoveries;    /*!< Bus resets after a timed out transfer*/
+    uint32_t scl_speed_hz;  /*!< Negotiated SCL clock, 0 without devices*/
+    uint8_t devices;        /*!< Registered devices*/
+} i2c_bus_stats_t;
+
+typedef struct i2c_bus_op_t i2c_bus_op_t;
+
+/**
+ * @brief Completion callback of a submitted transaction, called from the worker task of the bus
+ */
+typedef void (*i2c_bus_done_cb_t)(i2c_bus_op_t *op);
+
+/**
+ * @brief Transaction for i2c_bus_submit(), owned by the caller until it completes
+ */
+struct i2c_bus_op_t {
+    i2c_bus_device_handle_t dev;    /*!< Target device*/
+    const uint8_t *tx;              /*!< Bytes to write, NULL for a read*/
+    uint8_t *rx;                    /*!< Destination of a read*/
+    size_t len;                     /*!< Number of bytes*/
+    int timeout_ms;                 /*!< Transfer timeout*/
+    i2c_bus_done_cb_t done_cb;      /*!< Called on completion, NULL to notify notify_task instead*/
+    TaskHandle_t notify_task;       /*!< Gets xTaskNotifyGive() on completion when done_cb is NULL*/
+    void *arg;                      /*!< Free for the caller*/
+    esp_err_t result;               /*!< Outcome, valid once completed*/
+};
+
+/**
+ * @brief Limit the SCL clock of a bus, e.g. for weak pull-ups or long wires
+ *
+ * Devices already registered are moved to the new clock.
+ *
+ * @param[in] bus          I2C bus handle. Obtained from i2c_new_master_bus().
+ * @param[in] max_scl_hz   Fastest clock the wiring supports
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG max_scl_hz is 0
+ *     - ESP_ERR_NO_MEM Too many buses
+ *     - Others Error from underlying I2C driver
+ */
+esp_err_t i2c_bus_set_max_speed(i2c_master_bus_handle_t bus, uint32_t max_scl_hz);
+
+/**
+ * @brief Register a device, or take another reference to it if its address is already registered
+ *
+ * If max_scl_hz is below the current bus clock, all devices of the bus are
+ * moved to the slower clock.
+ *
+ * @param[in]  bus         I2C bus handle. Obtained from i2c_new_master_bus().
+ * @param[in]  dev_addr    7-bit device address
+ * @param[in]  max_scl_hz  Fastest clock the device supports
+ * @param[out] handle_ret  Device handle, release it with i2c_bus_remove_device()
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG max_scl_hz is 0
+ *     - ESP_ERR_NO_MEM Too many buses or devices
+ *     - Others Error from underlying I2C driver
+ */
+esp_err_t i2c_bus_add_device(i2c_master_bus_handle_t bus, uint16_t dev_addr, uint32_t max_scl_hz, i2c_bus_device_handle_t *handle_ret);
+
+/**
+ * @brief Drop one reference to a device, the last one removes it from the bus
+ *
+ * @param dev device handle from i2c_bus_add_device()
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - Others Error from underlying I2C driver
+ */
+esp_err_t i2c_bus_remove_device(i2c_bus_device_handle_t dev);
+
+/**
+ * @brief Check whether a device acknowledges its address, serialized with the other transactions
+ *
+ * @param[in] bus         I2C bus handle
+ * @param[in] dev_addr    7-bit device address
+ * @param[in] timeout_ms  Timeout, -1 to wait forever
+ *
+ * @return
+ *     - ESP_OK Device answered
+ *     - ESP_ERR_NOT_FOUND No acknowledge
+ *     - ESP_ERR_TIMEOUT Bus busy
+ */
+esp_err_t i2c_bus_probe(i2c_master_bus_handle_t bus, uint16_t dev_addr, int timeout_ms);
+
+/**
+ * @brief Write to a device while holding the bus
+ *
+ * @param dev         device handle
+ * @param data        bytes to write
+ * @param len         number of bytes
+ * @param timeout_ms  timeout for the lock and the transfer each, -1 to wait forever
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_TIMEOUT Bus busy or transfer timed out
+ *     - Others Error from underlying I2C driver
+ */
+esp_err_t i2c_bus_transmit(i2c_bus_device_handle_t dev, const uint8_t *data, size_t len, int timeout_ms);
+
+/**
+ * @brief Read from a device while holding the bus
+ *
+ * @param dev         device handle
+ * @param data        destination buffer
+ * @param len         number of bytes
+ * @param timeout_ms  timeout for the lock and the transfer each, -1 to wait forever
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_TIMEOUT Bus busy or transfer timed out
+ *     - Others Error from underlying I2C driver
+ */
+esp_err_t i2c_bus_receive(i2c_bus_device_handle_t dev, uint8_t *data, size_t len, int timeout_ms);
+
+/**
+ * @brief Queue a transaction and return without waiting for the bus
+ *
+ * The transfer runs in the worker task of the bus, which is created on the
+ * first submit. op must stay valid until it completes.
+ *
+ * @param op transaction, dev and the buffer of the direction used must be set
+ *
+ * @return
+ *     - ESP_OK Queued, op->result is reported on completion
+ *     - ESP_ERR_TIMEOUT Queue full
+ *     - ESP_ERR_NO_MEM Worker task or queue could not be created
+ */
+esp_err_t i2c_bus_submit(i2c_bus_op_t *op);
+
+/**
+ * @brief Reset the bus controller and clock out a slave that holds SDA low
+ *
+ * Done automatically after a timed out transfer, waits for the running transaction.
+ *
+ * @param bus I2C bus handle
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_NOT_FOUND Unknown bus
+ *     - Others Error from underlying I2C driver
+ */
+esp_err_t i2c_bus_recover(i2c_master_bus_handle_t bus);
+
+/**
+ * @brief Snapshot of the counters and the negotiated clock of a bus
+ *
+ * @param[in]  bus    I2C bus handle
+ * @param[out] stats  counters
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_NOT_FOUND The bus has no registered devices and no speed limit
+ */
+esp_err_t i2c_bus_get_stats(i2c_master_bus_handle_t bus, i2c_bus_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,24 +3,126 @@
 // =========================== WIFI CONFIG ==============================
 #define ESP_WIFI_STA_SSID "SSIoT-02"
 #define ESP_WIFI_STA_PSW "SSIoT-02"
-#define ESP_WIFI_MAX_RETRY 3
-#define ESP_WIFI_FAIL_BIT BIT0
 #define ESP_WIFI_CONNECTED_BIT BIT1
+#define WIFI_BACKOFF_BASE_MS 500        // First retry delay, doubled after every failed attempt
+#define WIFI_BACKOFF_MAX_MS 60000       // Upper bound of the retry delay
+#define WIFI_FAST_RECONNECT_ATTEMPTS 2  // Attempts on the cached BSSID/channel before a full scan
+#define WIFI_FAST_BOOT_STATIC_IP 1      // 1: reuse the cached DHCP lease as static IP on fast attempts
+#define WIFI_LEASE_MAX_AGE_S 3600       // Cached lease is reused this long after DHCP gave it, keep below the router's lease time
+#define WIFI_LEASE_MAX_STARTS 3         // ...or for this many starts while the clock is unset, e.g. power-on before SNTP
 
 
 // =========================== I2C CONFIG ================================
 #define I2C_MASTER_SDA_IO 21     // GPIO for I2C SDA
 #define I2C_MASTER_SCL_IO 22     // GPIO for I2C SCL
 #define I2C_MASTER_NUM I2C_NUM_0 // I2C port number for master
-#define I2C_MASTER_FREQ_HZ 100000
+#define I2C_MASTER_FREQ_HZ 400000 // SCL limit of the wiring, the bus runs at the fastest clock all devices support below it
+#define I2C1_MASTER_ENABLE 1       // 1: probe a second sensor bus on I2C_NUM_1
+#define I2C1_MASTER_SDA_IO 18
+#define I2C1_MASTER_SCL_IO 19
+#define I2C1_MASTER_NUM I2C_NUM_1
 
 
 // ========================= BH1750 CONFIG ===============================
-#define BH1750_SENSOR_ADDR BH1750_I2C_ADDRESS_DEFAULT   // Address of the BH1750 sensor
-#define BH1750_MEASUREMENT_MODE BH1750_CONTINUE_1LX_RES // Measurement mode of BH1750 sensor
+#define SENSOR_ARRAY_MAX_CHANNELS 4                     // 0x23 and 0x5C on both I2C ports
+#define SENSOR_ARRAY_PROBE_TIMEOUT_MS 20
+#define SENSOR_I2C_TIMEOUT_MS 20                        // Per transfer, the bus is reset after a timeout
+#define BH1750_MEASUREMENT_MODE BH1750_ONETIME_1LX_RES  // One-shot mode issued for every sample
+#define SENSOR_CONVERSION_MARGIN_PCT 10                 // Added to the typical conversion time before reading
+#define SENSOR_AUTO_RANGE 1                             // 1: pick mode and MTreg per sample, 0: BH1750_MEASUREMENT_MODE at MTreg 69
+#define SENSOR_RANGE_UP_COUNT 50000                     // Switch to a less sensitive range at this count
+#define SENSOR_RANGE_DOWN_COUNT 40000                   // Switch to a more sensitive range if the count there stays below this
+#define SENSOR_MAX_CONVERSION_MS 400                    // Ranges with a longer conversion are not used
 
 
+// ========================= UPLOAD CONFIG ===============================
+#define SERVER_URL "http://192.168.1.100:5000/api/data" // Flask /api/data route
+#define SAMPLE_PERIOD_MS 500          // Time between two sensor reads, > SENSOR_MAX_CONVERSION_MS, hardware-timed so a few ms work with L-res ranges
+#define SAMPLE_BUFFER_CAPACITY 64     // Samples kept while waiting for upload
+#define SAMPLE_BATCH_MAX_COUNT 20     // Flush when this many samples are buffered
+#define SAMPLE_BATCH_MAX_AGE_MS 10000 // ...or when the oldest sample is this old
+#define POST_DATA_MAX_LEN 8192        // Size of the upload payload buffer
+#define HTTP_TIMEOUT_MS 5000          // Network timeout of one POST
+#define UPLOAD_QUEUE_LEN 32           // Samples waiting between sampler and uploader, a power of two
+#define UPLOAD_TASK_STACK_SIZE 6144
+#define UPLOAD_TASK_PRIORITY 4
+#define UPLOAD_TASK_CORE 0            // Same core as the Wi-Fi stack
+#define UPLOAD_USE_BINARY_FRAME 1     // 1: binary telemetry frames, 0: JSON arrays
+#define UPLOAD_PHY_RATE_KBPS 6000     // Nominal Wi-Fi PHY rate used for the airtime estimate
+#define UPLOAD_BUSY_BACKOFF_MS 5000   // Pause after a 429/503 without Retry-After
+#define UPLOAD_BUSY_BACKOFF_MAX_MS 300000 // Upper bound of a server-requested pause
+
+
+// ========================= SAMPLER CONFIG ==============================
+#define SAMPLER_TASK_CORE 1           // Sampling runs alone on the core Wi-Fi does not use
+#define SAMPLER_TASK_PRIORITY 10      // Above the uploader and the I2C bus task
+#define SAMPLER_TASK_STACK_SIZE 4096
+#define STATS_LOG_INTERVAL_MS 60000   // Log the I2C bus counters (and benchmark results) this often, 0: never
+#define SAMPLER_BENCHMARK 0           // 1: load the uploader to show it does not affect the sampling jitter
+#define BENCH_UPLOADER_BUSY_MS 200    // Per uploader iteration: spin on core 0 this long...
+#define BENCH_UPLOADER_BLOCK_MS 2000  // ...then stall the consumer this long, the ring fills up
+
+
+// ====================== AGGREGATION CONFIG =============================
+#define AGGREGATE_ENABLE 1              // 1: upload one summary per channel and window instead of every sample (not in SLEEP_MODE_ENABLE)
+#define AGGREGATE_WINDOW_MS 60000       // Tumbling window length, aligned to the epoch
+#define AGGREGATE_RAW_PASSTHROUGH 0     // 1: upload the raw samples as well
+#define WINDOW_BUFFER_CAPACITY 32       // Summaries kept while waiting for upload, oldest dropped when full
+#define UPLOAD_WINDOW_QUEUE_LEN 8       // Summaries waiting between sampler and uploader, a power of two
+
+
+// ===================== REPORT-BY-EXCEPTION CONFIG ======================
+// Filters raw samples only, so it needs SLEEP_MODE_ENABLE, AGGREGATE_ENABLE 0 or AGGREGATE_RAW_PASSTHROUGH 1.
+// Window summaries always go out, the build fails if nothing would be filtered.
+#define REPORT_BY_EXCEPTION 0           // 1: upload a raw sample only if it left the deadband or the heartbeat is due
+#define REPORT_DEADBAND_LUX 1.0f        // Absolute deadband around the last reported value
+#define REPORT_DEADBAND_PCT 5           // Relative deadband, the wider of both applies
+#define REPORT_HEARTBEAT_MS 300000      // Report at least this often per channel, so silence means unchanged
+
+
+// ========================= TIME SYNC CONFIG ============================
+#define TIME_SYNC_SERVER "pool.ntp.org"
+#define TIME_SYNC_INTERVAL_MS 900000    // SNTP poll interval, >= 15000
+#define TIME_SYNC_SLEW_MS 60000         // A sync error is spread over this long instead of stepping the clock...
+#define TIME_SYNC_STEP_MS 500           // ...unless it is larger than this
+#define TIME_SYNC_MAX_DRIFT_PPM 500     // Bound of the oscillator drift estimate
+#define TIME_SYNC_VALID_AFTER_S 1704067200 // 2024-01-01, earlier clock values are taken as unset
+#define TIME_SYNC_WAIT_MS 5000          // SLEEP_MODE_ENABLE: wait this long for a sync while the clock is unset
+
+
+// ========================= MEMORY CONFIG ===============================
+#define STATIC_ALLOCATION 1             // 1: app tasks, queues and sync objects use static storage, needs the I2C bus and BH1750 options in sdkconfig
+#define MEMORY_REPORT_MAX_REGIONS 16    // Arenas and stacks listed in the boot memory map
+#define HEAP_GROWTH_WARN_BYTES 1024     // Warn once the heap in use grew this much since the first stats log
+
+
+// ========================= SPOOL CONFIG ================================
+#define SPOOL_PARTITION_LABEL "spool"     // Data partition in partitions.csv
+#define SPOOL_DRAIN_BATCH 200             // Samples per upload while draining the backlog
+#define SPOOL_DRAIN_MAX_SAMPLES_PER_S 400 // Rate cap for draining the backlog
+
+
+
+// ========================= SLEEP CONFIG ================================
+#define SLEEP_MODE_ENABLE 0                           // 1: one-shot reading and deep sleep per sample, for battery nodes
+#define SLEEP_SAMPLE_PERIOD_MS 10000                  // Wake-up period
+#define SLEEP_UPLOAD_BATCH 60                         // Upload once this many samples are held (<= SAMPLE_BUFFER_CAPACITY)
+#define SLEEP_UPLOAD_DEADLINE_MS 600000               // ...or once the oldest one is this old
+#define SLEEP_WIFI_TIMEOUT_MS 10000                   // Go back to sleep if there is no IP within this time
+// Energy model for the logged per-sample estimate. Typical ESP32-WROOM datasheet figures, not measured
+// on this board, the estimate is no better than these until they are calibrated with a current meter
+#define SLEEP_SUPPLY_MV 3300
+#define SLEEP_ACTIVE_CURRENT_MA 40    // CPU running, radio off
+#define SLEEP_WIFI_CURRENT_MA 130     // Radio on, averaged over association and upload
+#define SLEEP_DEEP_SLEEP_CURRENT_UA 10
+#define SLEEP_BOOT_OVERHEAD_MS 60     // ROM and bootloader time after a wake-up, not seen by esp_timer
+
 // =========================== LOG TAGS ==================================
 static const char *TAG_i = "i2c";
 static const char *TAG_b = "bh1750";
-static const char *TAG_w = "wifi"; // WiFi Tag
\ No newline at end of file
+static const char *TAG_w = "wifi"; // WiFi Tag
+static const char *TAG_h = "http"; // HTTP Tag
+static const char *TAG_s = "spool"; // Flash spool Tag
+static const char *TAG_d = "duty"; // Duty cycle Tag
+static const char *TAG_t = "time"; // SNTP Tag
+static const char *TAG_m = "memory"; // Memory report Tag
\ No newline at end of file
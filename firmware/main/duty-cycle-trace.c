@@ -0,0 +1,40 @@
+#include "config.h"
+#include "duty-cycle-trace.h"
+
+uint64_t duty_cycle_energy_uj(uint64_t active_us, uint64_t wifi_us, uint64_t sleep_us)
+{
+    // mV * mA = uW, uW * us = pJ
+    uint64_t pj = active_us * ((uint64_t)SLEEP_SUPPLY_MV * SLEEP_ACTIVE_CURRENT_MA) +
+                  wifi_us * ((uint64_t)SLEEP_SUPPLY_MV * SLEEP_WIFI_CURRENT_MA) +
+                  sleep_us * ((uint64_t)SLEEP_SUPPLY_MV * SLEEP_DEEP_SLEEP_CURRENT_UA) / 1000;
+    return pj / 1000000;
+}
+
+bool duty_cycle_upload_due(size_t held, int64_t oldest_age_ms)
+{
+    return held >= SLEEP_UPLOAD_BATCH || (held > 0 && oldest_age_ms >= SLEEP_UPLOAD_DEADLINE_MS);
+}
+
+duty_cycle_phases_t duty_cycle_trace_end(duty_cycle_trace_t *trace, int64_t timer_us, int64_t wifi_us, uint32_t samples)
+{
+    duty_cycle_phases_t phases = {.wifi_us = wifi_us};
+    // esp_timer starts counting when the app starts after the wake-up
+    phases.awake_us = timer_us + SLEEP_BOOT_OVERHEAD_MS * 1000;
+    phases.sleep_us = (int64_t)SLEEP_SAMPLE_PERIOD_MS * 1000 - phases.awake_us;
+    if (phases.sleep_us < 1000)
+    {
+        phases.sleep_us = 1000;
+    }
+    phases.energy_uj = duty_cycle_energy_uj(phases.awake_us - wifi_us, wifi_us, phases.sleep_us);
+
+    trace->active_us += phases.awake_us - wifi_us;
+    trace->wifi_us += wifi_us;
+    trace->sleep_us += phases.sleep_us;
+    trace->samples += samples;
+    return phases;
+}
+
+uint64_t duty_cycle_trace_uj_per_sample(const duty_cycle_trace_t *trace)
+{
+    return trace->samples ? duty_cycle_energy_uj(trace->active_us, trace->wifi_us, trace->sleep_us) / trace->samples : 0;
+}
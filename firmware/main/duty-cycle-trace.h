@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Timing trace and energy model of the duty cycle, see duty-cycle.h.
+ *
+ * Times come in as esp_timer readings, which start at 0 when the app starts
+ * after a wake-up, so the same code runs against a fake clock in the test app.
+ */
+
+/**
+ * @brief Time spent in each power state since the first cold boot, kept across deep sleep
+ */
+typedef struct
+{
+    uint64_t active_us; // Awake with the radio off, incl. SLEEP_BOOT_OVERHEAD_MS per wake-up
+    uint64_t wifi_us;   // Awake with the radio on
+    uint64_t sleep_us;  // Deep sleep
+    uint32_t samples;
+} duty_cycle_trace_t;
+
+/**
+ * @brief Phases of one wake/sample/sleep cycle
+ */
+typedef struct
+{
+    int64_t awake_us;   // Incl. SLEEP_BOOT_OVERHEAD_MS and wifi_us
+    int64_t wifi_us;    // Radio on
+    int64_t sleep_us;   // Until the next wake-up
+    uint64_t energy_uj; // Model energy of the whole cycle
+} duty_cycle_phases_t;
+
+/**
+ * @brief Energy in uJ for the given time per power state, from the SLEEP_* model in config.h.
+ */
+uint64_t duty_cycle_energy_uj(uint64_t active_us, uint64_t wifi_us, uint64_t sleep_us);
+
+/**
+ * @brief Whether the held samples are due for upload.
+ * @param held Samples in the RTC buffer
+ * @param oldest_age_ms Age of the oldest one
+ */
+bool duty_cycle_upload_due(size_t held, int64_t oldest_age_ms);
+
+/**
+ * @brief End a cycle: work out its phases and add them to the trace.
+ * The sleep time keeps wake-ups SLEEP_SAMPLE_PERIOD_MS apart, and is 1 ms if the cycle overran the period.
+ * @param trace Trace to add to
+ * @param timer_us esp_timer time at the end of the cycle
+ * @param wifi_us Part of it with the radio on
+ * @param samples Samples taken in the cycle
+ */
+duty_cycle_phases_t duty_cycle_trace_end(duty_cycle_trace_t *trace, int64_t timer_us, int64_t wifi_us, uint32_t samples);
+
+/**
+ * @brief Model energy per sample over the whole trace, 0 before the first sample.
+ */
+uint64_t duty_cycle_trace_uj_per_sample(const duty_cycle_trace_t *trace);
@@ -0,0 +1,100 @@
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "config.h"
+#include "duty-cycle.h"
+#include "duty-cycle-trace.h"
+#include "http-uploader.h"
+#include "sample-buffer.h"
+#include "sensor-array.h"
+#include "report-filter.h"
+#include "time-sync.h"
+#include "wifi-config-module.h"
+
+static RTC_DATA_ATTR sample_buffer_t s_rtc_buffer;
+static RTC_DATA_ATTR duty_cycle_trace_t s_trace;
+
+/**
+ * @brief Start Wi-Fi and upload everything in the RTC buffer.
+ * Samples stay in the buffer if the upload fails, they go out with the next attempt.
+ * @return Time the radio was on in us
+ */
+static int64_t upload_rtc_buffer(void)
+{
+    static char post_data[POST_DATA_MAX_LEN];
+    static sample_t batch[SAMPLE_BUFFER_CAPACITY];
+    int64_t start_us = esp_timer_get_time();
+
+    esp_err_t err = wifi_manager_start(NULL);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_w, "Wi-Fi unavailable (%s), %u samples kept", esp_err_to_name(err), (unsigned)s_rtc_buffer.count);
+    }
+    else if (wifi_manager_wait_connected(SLEEP_WIFI_TIMEOUT_MS))
+    {
+        size_t n = sample_buffer_peek(&s_rtc_buffer, batch, SAMPLE_BUFFER_CAPACITY);
+        size_t sent;
+        err = http_uploader_send(batch, n, post_data, sizeof(post_data), &sent);
+        sample_buffer_consume(&s_rtc_buffer, sent);
+        if (err != ESP_OK)
+        {
+            ESP_LOGW(TAG_h, "Upload failed, %u samples kept for the next cycle", (unsigned)s_rtc_buffer.count);
+        }
+        // The RTC keeps the system clock through deep sleep, so one sync after a cold boot is enough
+        if (!time_sync_is_valid() && time_sync_start() == ESP_OK && !time_sync_wait(TIME_SYNC_WAIT_MS))
+        {
+            ESP_LOGW(TAG_t, "No SNTP sync within %d ms, samples keep unset timestamps", TIME_SYNC_WAIT_MS);
+        }
+    }
+    else
+    {
+        ESP_LOGW(TAG_w, "No connection within %d ms, %u samples kept", SLEEP_WIFI_TIMEOUT_MS, (unsigned)s_rtc_buffer.count);
+    }
+    wifi_manager_stop();
+    return esp_timer_get_time() - start_us;
+}
+
+void duty_cycle_run(void)
+{
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_TIMER)
+    {
+        // Cold boot, RTC memory holds no valid state
+        sample_buffer_init(&s_rtc_buffer);
+        s_trace = (duty_cycle_trace_t){0};
+    }
+
+    // One-shot conversions, the sensors power themselves down when they are done
+    sample_t samples[SENSOR_ARRAY_MAX_CHANNELS];
+    size_t n = sensor_array_read(samples, SENSOR_ARRAY_MAX_CHANNELS);
+    for (size_t i = 0; i < n; i++)
+    {
+        ESP_LOGI(TAG_b, "Light[%u]: %u counts", samples[i].channel, samples[i].raw);
+#if REPORT_BY_EXCEPTION
+        if (!report_filter_pass(&samples[i]))
+        {
+            continue; // Unchanged, fewer held samples mean fewer radio wake-ups
+        }
+#endif
+        if (!sample_buffer_push(&s_rtc_buffer, &samples[i]))
+        {
+            ESP_LOGW(TAG_b, "RTC buffer full, oldest sample dropped (%lu total)", (unsigned long)s_rtc_buffer.dropped);
+        }
+    }
+    ESP_LOGI(TAG_b, "%u samples held", (unsigned)s_rtc_buffer.count);
+
+    int64_t wifi_us = 0;
+    int64_t oldest_age_ms = s_rtc_buffer.count ? (sample_now_us() - s_rtc_buffer.samples[s_rtc_buffer.head].timestamp_us) / 1000 : 0;
+    if (duty_cycle_upload_due(s_rtc_buffer.count, oldest_age_ms))
+    {
+        wifi_us = upload_rtc_buffer();
+    }
+
+    duty_cycle_phases_t cycle = duty_cycle_trace_end(&s_trace, esp_timer_get_time(), wifi_us, n);
+    ESP_LOGI(TAG_d, "Cycle: awake %lld ms (Wi-Fi %lld ms), model ~%llu uJ/cycle, ~%llu uJ/sample over %lu samples",
+             cycle.awake_us / 1000, cycle.wifi_us / 1000, cycle.energy_uj, duty_cycle_trace_uj_per_sample(&s_trace),
+             (unsigned long)s_trace.samples);
+
+    esp_sleep_enable_timer_wakeup(cycle.sleep_us);
+    esp_deep_sleep_start();
+}
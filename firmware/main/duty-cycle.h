@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+ * Duty-cycled sampling for battery nodes (SLEEP_MODE_ENABLE).
+ *
+ * Every wake-up takes one one-shot reading from each sensor of the array,
+ * appends them to a sample buffer kept in RTC slow memory and goes back to
+ * deep sleep. Wi-Fi is only started when
+ * SLEEP_UPLOAD_BATCH samples are held or the oldest one is older than
+ * SLEEP_UPLOAD_DEADLINE_MS. Each cycle logs its timing trace, and the trace
+ * times the SLEEP_*_CURRENT figures of config.h as a model energy per sample.
+ * Those currents are datasheet-typical, not measured on this board, so the
+ * logged energy is only an estimate until they are calibrated.
+ */
+
+/**
+ * @brief Take one sample, upload if due, and enter deep sleep. Never returns.
+ * NVS and the sensor array must be initialized before.
+ */
+void duty_cycle_run(void) __attribute__((noreturn));
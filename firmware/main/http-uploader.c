@@ -0,0 +1,640 @@
+#include <stdlib.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_http_client.h"
+#include "http-uploader.h"
+#include "json-encoder.h"
+#include "telemetry-frame.h"
+#include "sample-spool.h"
+#include "spsc-ring.h"
+#include "memory-report.h"
+#include "esp_mac.h"
+
+// Sampler -> uploader, lock-free so a stalled uploader never delays the sampler
+static spsc_ring_t s_sample_ring;
+static spsc_ring_t s_window_ring;
+static sample_t s_sample_storage[UPLOAD_QUEUE_LEN];
+static sample_window_t s_window_storage[UPLOAD_WINDOW_QUEUE_LEN];
+static TaskHandle_t s_task;
+static esp_http_client_handle_t s_client;
+static http_uploader_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_device_id;
+static volatile bool s_online;
+static bool s_spool_ready;
+static bool s_first_upload_logged;
+static int32_t s_retry_after_s;      // Retry-After of the last response, -1 if it had none
+static int64_t s_busy_until_us;      // No requests before this esp_timer time, the server asked to back off
+
+/**
+ * @brief Record the latency of one request.
+ */
+static void stats_record(int64_t latency_us, bool ok)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.requests++;
+    if (!ok)
+    {
+        s_stats.failures++;
+    }
+    s_stats.last_us = latency_us;
+    s_stats.total_us += latency_us;
+    if (s_stats.requests == 1 || latency_us < s_stats.min_us)
+    {
+        s_stats.min_us = latency_us;
+    }
+    if (latency_us > s_stats.max_us)
+    {
+        s_stats.max_us = latency_us;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+}
+
+/**
+ * @brief Parse a Retry-After value in delta-seconds.
+ * The HTTP-date form is not supported, the servers only send seconds, and
+ * yields -1 so the default backoff applies instead of no backoff at all.
+ * @return Seconds to wait, -1 if the value is not a plain number
+ */
+static int32_t parse_retry_after(const char *value)
+{
+    while (*value == ' ')
+    {
+        value++;
+    }
+    if (*value < '0' || *value > '9')
+    {
+        return -1;
+    }
+    char *end;
+    unsigned long seconds = strtoul(value, &end, 10);
+    while (*end == ' ')
+    {
+        end++;
+    }
+    if (*end != '\0')
+    {
+        return -1;
+    }
+    return (seconds < UPLOAD_BUSY_BACKOFF_MAX_MS / 1000) ? (int32_t)seconds : UPLOAD_BUSY_BACKOFF_MAX_MS / 1000;
+}
+
+/**
+ * @brief Remember the Retry-After header of a response.
+ */
+static esp_err_t http_event_handler(esp_http_client_event_t *evt)
+{
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Retry-After") == 0)
+    {
+        s_retry_after_s = parse_retry_after(evt->header_value);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Whether the server asked to back off and that time has not come yet.
+ */
+static bool http_backing_off(void)
+{
+    return esp_timer_get_time() < s_busy_until_us;
+}
+
+/**
+ * @brief Create the keep-alive client on first use.
+ * The TCP connection itself is opened lazily by esp_http_client_perform()
+ * and reused for every following request until the server or an error closes it.
+ */
+static esp_http_client_handle_t get_client(void)
+{
+    if (s_client == NULL)
+    {
+        esp_http_client_config_t config = {
+            .url = SERVER_URL,
+            .method = HTTP_METHOD_POST,
+            .timeout_ms = HTTP_TIMEOUT_MS,
+            .keep_alive_enable = true,
+            .event_handler = http_event_handler};
+        s_client = esp_http_client_init(&config);
+    }
+    return s_client;
+}
+
+/**
+ * @brief POST a payload over the persistent connection.
+ * @param post_data The payload to send
+ * @param post_len Length of post_data
+ * @param content_type "application/json" or TELEMETRY_FRAME_CONTENT_TYPE
+ * @return
+ *     - ESP_OK The server answered with status 200
+ *     - ESP_ERR_INVALID_STATE The server answered 429 or 503, or asked earlier to retry later and that time has not come
+ *     - ESP_ERR_INVALID_ARG The server refused the payload with another 4xx status, sending it again cannot help
+ *     - ESP_FAIL or a transport error otherwise
+ */
+static esp_err_t http_post(const char *post_data, size_t post_len, const char *content_type)
+{
+    if (http_backing_off())
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_http_client_handle_t client = get_client();
+    if (client == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_http_client_set_header(client, "Content-Type", content_type);
+    esp_http_client_set_post_field(client, post_data, (int)post_len);
+
+    s_retry_after_s = -1;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = esp_http_client_perform(client);
+    int64_t latency_us = esp_timer_get_time() - start_us;
+
+    int status = esp_http_client_get_status_code(client);
+    if (err == ESP_OK && status != 200)
+    {
+        err = ESP_FAIL;
+    }
+    stats_record(latency_us, err == ESP_OK);
+
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG_h, "POST status = %d, latency = %lld ms", status, latency_us / 1000);
+        if (!s_first_upload_logged)
+        {
+            ESP_LOGI(TAG_h, "Boot to first upload: %lld ms", esp_timer_get_time() / 1000);
+            s_first_upload_logged = true;
+        }
+    }
+    else if (status == 429 || status == 503)
+    {
+        // Server overloaded: hold everything back, samples wait in the buffer and the spool
+        int64_t backoff_ms = (s_retry_after_s >= 0) ? s_retry_after_s * 1000LL : UPLOAD_BUSY_BACKOFF_MS;
+        backoff_ms = (backoff_ms < UPLOAD_BUSY_BACKOFF_MAX_MS) ? backoff_ms : UPLOAD_BUSY_BACKOFF_MAX_MS;
+        s_busy_until_us = esp_timer_get_time() + backoff_ms * 1000;
+        ESP_LOGW(TAG_h, "Server busy (status %d), retrying in %lld ms", status, backoff_ms);
+        err = ESP_ERR_INVALID_STATE;
+    }
+    else if (status >= 400 && status < 500)
+    {
+        ESP_LOGE(TAG_h, "POST refused (status %d)", status);
+        err = ESP_ERR_INVALID_ARG;
+    }
+    else
+    {
+        ESP_LOGE(TAG_h, "POST failed: %s (status %d)", esp_err_to_name(err), status);
+        // Drop the connection, the next request reconnects
+        esp_http_client_close(client);
+    }
+    return err;
+}
+
+/**
+ * @brief Log the payload size per 1000 samples and the airtime it costs at UPLOAD_PHY_RATE_KBPS.
+ */
+static void log_bandwidth(void)
+{
+    http_uploader_stats_t stats;
+    http_uploader_get_stats(&stats);
+    if (stats.samples_sent == 0)
+    {
+        return;
+    }
+    uint64_t bytes_per_1000 = stats.payload_bytes * 1000 / stats.samples_sent;
+    uint64_t airtime_us_per_1000 = bytes_per_1000 * 8 * 1000 / UPLOAD_PHY_RATE_KBPS;
+    ESP_LOGI(TAG_h, "Payload: %llu bytes / 1000 samples, ~%llu ms airtime", bytes_per_1000, airtime_us_per_1000 / 1000);
+}
+
+/**
+ * @brief Encode and POST one batch.
+ * @param batch The samples to upload, oldest first
+ * @param n Number of samples
+ * @param post_data Scratch buffer for the payload
+ * @param len Size of post_data
+ * @param sent Number of leading samples the server accepted, or refused with ESP_ERR_INVALID_ARG
+ * @return ESP_OK if the server accepted the upload, ESP_ERR_INVALID_STATE while it asks to back off,
+ * ESP_ERR_INVALID_ARG if it refused the batch, which is then counted as dropped (see http_post()).
+ */
+static esp_err_t upload_batch(const sample_t *batch, size_t n, char *post_data, size_t len, size_t *sent)
+{
+    size_t post_len;
+#if UPLOAD_USE_BINARY_FRAME
+    const char *content_type = TELEMETRY_FRAME_CONTENT_TYPE;
+    esp_err_t err = telemetry_frame_encode(s_device_id, batch, n, (uint8_t *)post_data, len, &post_len, &n);
+#else
+    const char *content_type = "application/json";
+    if (n > (len - 2) / JSON_SAMPLE_MAX_LEN)
+    {
+        n = (len - 2) / JSON_SAMPLE_MAX_LEN; // The rest goes out with the next request
+    }
+    esp_err_t err = json_encode_batch(batch, n, post_data, len, &post_len);
+#endif
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_h, "Batch of %u samples does not fit in %u bytes", (unsigned)n, (unsigned)len);
+        return err;
+    }
+    err = http_post(post_data, post_len, content_type);
+    if (err == ESP_OK)
+    {
+        *sent = n;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.samples_sent += n;
+        s_stats.payload_bytes += post_len;
+        portEXIT_CRITICAL(&s_stats_lock);
+        ESP_LOGI(TAG_h, "Uploaded %u samples in %u bytes", (unsigned)n, (unsigned)post_len);
+        log_bandwidth();
+    }
+    else if (err == ESP_ERR_INVALID_ARG)
+    {
+        // Retrying or spooling a refused batch would block everything behind it
+        *sent = n;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.samples_refused += n;
+        portEXIT_CRITICAL(&s_stats_lock);
+        ESP_LOGW(TAG_h, "Dropped %u samples the server refused", (unsigned)n);
+    }
+    return err;
+}
+
+/**
+ * @brief Move everything in the RAM buffer to the flash spool.
+ */
+static void spill_to_spool(sample_buffer_t *buf)
+{
+    static sample_t batch[SAMPLE_BUFFER_CAPACITY];
+    size_t n = sample_buffer_peek(buf, batch, SAMPLE_BUFFER_CAPACITY);
+    if (n && sample_spool_append(batch, n) == ESP_OK)
+    {
+        sample_buffer_consume(buf, n);
+    }
+}
+
+/**
+ * @brief Upload the buffered samples as one batch, samples are only removed after the server accepted them.
+ * If the upload fails they are moved to the spool, so a long outage cannot overflow the RAM buffer.
+ * A batch the server refused is dropped, sending it again would fail the same way.
+ * While the server asks to back off nothing is sent and they stay in RAM, the
+ * task spills the buffer only once it is full.
+ * @param buf The sample buffer to flush
+ * @param post_data Scratch buffer for the payload
+ * @param len Size of post_data
+ */
+static void flush_samples(sample_buffer_t *buf, char *post_data, size_t len)
+{
+    static sample_t batch[SAMPLE_BATCH_MAX_COUNT];
+    if (http_backing_off())
+    {
+        return;
+    }
+    size_t n = sample_buffer_peek(buf, batch, SAMPLE_BATCH_MAX_COUNT);
+    size_t sent;
+    esp_err_t err = upload_batch(batch, n, post_data, len, &sent);
+    if (err == ESP_OK || err == ESP_ERR_INVALID_ARG)
+    {
+        sample_buffer_consume(buf, sent);
+    }
+    else if (err != ESP_ERR_INVALID_STATE && s_spool_ready)
+    {
+        spill_to_spool(buf);
+    }
+}
+
+/**
+ * @brief Upload the oldest spooled samples in one large batch.
+ * A batch the server refused is consumed as well, otherwise it would hold up the whole backlog.
+ * @return Number of samples taken off the spool
+ */
+static size_t drain_spool(char *post_data, size_t len)
+{
+    static sample_t batch[SPOOL_DRAIN_BATCH];
+    size_t n = sample_spool_peek(batch, SPOOL_DRAIN_BATCH);
+    size_t sent = 0;
+    if (n == 0)
+    {
+        return 0;
+    }
+    esp_err_t err = upload_batch(batch, n, post_data, len, &sent);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_ARG)
+    {
+        return 0;
+    }
+    sample_spool_consume(sent);
+    return sent;
+}
+
+/**
+ * @brief Window summaries waiting for upload, the oldest is dropped when full.
+ * They are few and small, so they stay in RAM and are not spooled.
+ */
+typedef struct
+{
+    sample_window_t windows[WINDOW_BUFFER_CAPACITY];
+    size_t head;
+    size_t count;
+    uint32_t dropped;
+} window_buffer_t;
+
+static void window_buffer_push(window_buffer_t *buf, const sample_window_t *window)
+{
+    if (buf->count == WINDOW_BUFFER_CAPACITY)
+    {
+        buf->head = (buf->head + 1) % WINDOW_BUFFER_CAPACITY;
+        buf->count--;
+        buf->dropped++;
+        portENTER_CRITICAL(&s_stats_lock);
+        s_stats.windows_dropped++;
+        portEXIT_CRITICAL(&s_stats_lock);
+        ESP_LOGW(TAG_h, "Window buffer full, oldest summary dropped (%lu total)", (unsigned long)buf->dropped);
+    }
+    buf->windows[(buf->head + buf->count) % WINDOW_BUFFER_CAPACITY] = *window;
+    buf->count++;
+}
+
+/**
+ * @brief Upload the buffered window summaries as one JSON array, remove them once the server accepted
+ * or refused them.
+ */
+static void flush_windows(window_buffer_t *buf, char *post_data, size_t len)
+{
+    static sample_window_t batch[WINDOW_BUFFER_CAPACITY];
+    size_t n = buf->count;
+    if (n > (len - 2) / JSON_WINDOW_MAX_LEN)
+    {
+        n = (len - 2) / JSON_WINDOW_MAX_LEN;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        batch[i] = buf->windows[(buf->head + i) % WINDOW_BUFFER_CAPACITY];
+    }
+    size_t post_len;
+    if (json_encode_windows(batch, n, post_data, len, &post_len) != ESP_OK)
+    {
+        return;
+    }
+    esp_err_t err = http_post(post_data, post_len, "application/json");
+    if (err != ESP_OK && err != ESP_ERR_INVALID_ARG)
+    {
+        return; // Kept for the next attempt
+    }
+    buf->head = (buf->head + n) % WINDOW_BUFFER_CAPACITY;
+    buf->count -= n;
+    portENTER_CRITICAL(&s_stats_lock);
+    if (err == ESP_OK)
+    {
+        s_stats.windows_sent += n;
+        s_stats.payload_bytes += post_len;
+    }
+    else
+    {
+        s_stats.windows_refused += n;
+    }
+    portEXIT_CRITICAL(&s_stats_lock);
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG_h, "Uploaded %u window summaries in %u bytes", (unsigned)n, (unsigned)post_len);
+    }
+    else
+    {
+        ESP_LOGW(TAG_h, "Dropped %u window summaries the server refused", (unsigned)n);
+    }
+}
+
+#if SAMPLER_BENCHMARK
+/**
+ * @brief Keep core 0 busy, then stall the consumer, to show the sampler on core 1 is not affected.
+ */
+static void benchmark_load(void)
+{
+    int64_t busy_until_us = esp_timer_get_time() + BENCH_UPLOADER_BUSY_MS * 1000LL;
+    while (esp_timer_get_time() < busy_until_us)
+    {
+        // Saturated: spin without yielding
+    }
+    vTaskDelay(pdMS_TO_TICKS(BENCH_UPLOADER_BLOCK_MS));
+}
+#endif
+
+/**
+ * @brief Uploader task: drains the sample ring into the batch buffer and flushes it.
+ * While offline, or while a backlog is being drained, new samples are appended to the
+ * flash spool instead so they are uploaded in order.
+ */
+static void http_uploader_task(void *arg)
+{
+    static char post_data[POST_DATA_MAX_LEN];
+    static sample_buffer_t sample_buffer;
+    static window_buffer_t window_buffer;
+    sample_buffer_init(&sample_buffer);
+
+    // Drain pacing runs on esp_timer, sample_now_ms() steps when SNTP corrects the clock
+    int64_t next_drain_ms = 0;
+    int64_t drain_start_ms = 0;
+    size_t drain_samples = 0;
+    sample_t sample;
+    while (1)
+    {
+        bool online = s_online;
+        bool backlog = s_spool_ready && sample_spool_pending() > 0;
+
+        // Wake up at least once per period so the age threshold is honoured
+        TickType_t wait = pdMS_TO_TICKS(SAMPLE_PERIOD_MS);
+        if (online && backlog)
+        {
+            // Come back as soon as the rate cap allows the next drain batch
+            int64_t until_drain_ms = next_drain_ms - esp_timer_get_time() / 1000;
+            if (until_drain_ms < SAMPLE_PERIOD_MS)
+            {
+                wait = (until_drain_ms > 0) ? pdMS_TO_TICKS(until_drain_ms) : 0;
+            }
+        }
+        // The sampler notifies after every push, the rings themselves never block
+        ulTaskNotifyTake(pdTRUE, wait);
+        // Read again, the link may have gone down while waiting
+        online = s_online;
+        backlog = s_spool_ready && sample_spool_pending() > 0;
+#if SAMPLER_BENCHMARK
+        benchmark_load();
+#endif
+        while (spsc_ring_pop(&s_sample_ring, &sample))
+        {
+            if (s_spool_ready && (!online || backlog))
+            {
+                sample_spool_append(&sample, 1);
+            }
+            else
+            {
+                if (s_spool_ready && sample_buffer.count == SAMPLE_BUFFER_CAPACITY)
+                {
+                    // Held back while the server asks to back off, flash instead of overwriting the oldest
+                    spill_to_spool(&sample_buffer);
+                }
+                if (!sample_buffer_push(&sample_buffer, &sample))
+                {
+                    portENTER_CRITICAL(&s_stats_lock);
+                    s_stats.samples_dropped++;
+                    portEXIT_CRITICAL(&s_stats_lock);
+                    ESP_LOGW(TAG_h, "Sample buffer full, oldest sample dropped (%lu total)", (unsigned long)sample_buffer.dropped);
+                }
+            }
+        }
+        sample_window_t window;
+        while (spsc_ring_pop(&s_window_ring, &window))
+        {
+            window_buffer_push(&window_buffer, &window);
+        }
+
+        if (!online)
+        {
+            // Keep nothing in RAM while offline, the spool survives a reboot
+            if (s_spool_ready && sample_buffer.count)
+            {
+                spill_to_spool(&sample_buffer);
+            }
+            continue;
+        }
+
+        if (window_buffer.count)
+        {
+            flush_windows(&window_buffer, post_data, sizeof(post_data));
+        }
+
+        if (backlog)
+        {
+            int64_t now_ms = esp_timer_get_time() / 1000;
+            if (now_ms < next_drain_ms)
+            {
+                continue;
+            }
+            if (drain_samples == 0)
+            {
+                drain_start_ms = now_ms;
+                ESP_LOGI(TAG_s, "Draining %u spooled samples", (unsigned)sample_spool_pending());
+            }
+            size_t sent = drain_spool(post_data, sizeof(post_data));
+            drain_samples += sent;
+            // Rate cap: the next batch may go out once this one's share of the budget has passed
+            next_drain_ms = esp_timer_get_time() / 1000 + (sent ? (int64_t)sent * 1000 / SPOOL_DRAIN_MAX_SAMPLES_PER_S : SAMPLE_PERIOD_MS);
+            if (sample_spool_pending() == 0)
+            {
+                int64_t drain_ms = esp_timer_get_time() / 1000 - drain_start_ms;
+                ESP_LOGI(TAG_s, "Backlog of %u samples drained in %lld ms (%lld samples/s)", (unsigned)drain_samples, drain_ms,
+                         drain_ms > 0 ? (int64_t)drain_samples * 1000 / drain_ms : 0);
+                drain_samples = 0;
+            }
+        }
+        else if (sample_buffer_should_flush(&sample_buffer, sample_now_us()))
+        {
+            flush_samples(&sample_buffer, post_data, sizeof(post_data));
+        }
+    }
+}
+
+void http_uploader_set_online(bool online)
+{
+    s_online = online;
+    // Start draining the backlog now rather than at the next periodic wake-up
+    if (s_task)
+    {
+        xTaskNotifyGive(s_task);
+    }
+}
+
+/**
+ * @brief Last 4 bytes of the station MAC identify this device in binary frames.
+ */
+static void device_id_init(void)
+{
+    uint8_t mac[6];
+    ESP_ERROR_CHECK(esp_read_mac(mac, ESP_MAC_WIFI_STA));
+    s_device_id = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+}
+
+esp_err_t http_uploader_start(void)
+{
+    device_id_init();
+
+    esp_err_t err = sample_spool_init();
+    s_spool_ready = (err == ESP_OK);
+    if (!s_spool_ready)
+    {
+        ESP_LOGE(TAG_s, "Spool unavailable (%s), samples taken offline will be lost", esp_err_to_name(err));
+    }
+
+    if (!spsc_ring_init(&s_sample_ring, s_sample_storage, sizeof(sample_t), UPLOAD_QUEUE_LEN) ||
+        !spsc_ring_init(&s_window_ring, s_window_storage, sizeof(sample_window_t), UPLOAD_WINDOW_QUEUE_LEN))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memory_report_add("sample ring", s_sample_storage, sizeof(s_sample_storage));
+    memory_report_add("window ring", s_window_storage, sizeof(s_window_storage));
+
+    // Core 0 next to the Wi-Fi stack, core 1 is left to the sampler
+#if STATIC_ALLOCATION
+    static StaticTask_t s_task_buf;
+    static StackType_t s_task_stack[UPLOAD_TASK_STACK_SIZE];
+    s_task = xTaskCreateStaticPinnedToCore(http_uploader_task, "http_uploader", UPLOAD_TASK_STACK_SIZE, NULL, UPLOAD_TASK_PRIORITY,
+                                           s_task_stack, &s_task_buf, UPLOAD_TASK_CORE);
+    memory_report_add_task(s_task, s_task_stack, sizeof(s_task_stack));
+#else
+    if (xTaskCreatePinnedToCore(http_uploader_task, "http_uploader", UPLOAD_TASK_STACK_SIZE, NULL, UPLOAD_TASK_PRIORITY,
+                                &s_task, UPLOAD_TASK_CORE) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memory_report_add_task(s_task, NULL, UPLOAD_TASK_STACK_SIZE);
+#endif
+    return ESP_OK;
+}
+
+esp_err_t http_uploader_send(const sample_t *samples, size_t n, char *post_data, size_t len, size_t *sent)
+{
+    if (s_device_id == 0)
+    {
+        device_id_init();
+    }
+    *sent = 0;
+    while (*sent < n)
+    {
+        // A frame ends at a range change, keep going until everything is out
+        size_t batch_sent;
+        esp_err_t err = upload_batch(samples + *sent, n - *sent, post_data, len, &batch_sent);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_ARG)
+        {
+            return err;
+        }
+        *sent += batch_sent; // Refused samples are dropped too, the rest still goes out
+    }
+    return ESP_OK;
+}
+
+bool http_uploader_submit(const sample_t *sample)
+{
+    if (!spsc_ring_push(&s_sample_ring, sample))
+    {
+        return false;
+    }
+    xTaskNotifyGive(s_task);
+    return true;
+}
+
+bool http_uploader_submit_window(const sample_window_t *window)
+{
+    if (!spsc_ring_push(&s_window_ring, window))
+    {
+        return false;
+    }
+    xTaskNotifyGive(s_task);
+    return true;
+}
+
+void http_uploader_get_stats(http_uploader_stats_t *out)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+    out->samples_dropped += atomic_load(&s_sample_ring.dropped);
+    out->windows_dropped += atomic_load(&s_window_ring.dropped);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample-buffer.h"
+#include "sample-aggregator.h"
+
+/**
+ * @brief Per-request latency statistics of the uploader
+ */
+typedef struct
+{
+    uint32_t requests;      // POSTs attempted
+    uint32_t failures;      // POSTs that failed or got a non-200 status
+    int64_t last_us;        // Latency of the most recent request
+    int64_t min_us;
+    int64_t max_us;
+    int64_t total_us;       // Sum of all latencies, total_us / requests = mean
+    uint64_t samples_sent;  // Samples accepted by the server
+    uint64_t windows_sent;  // Window summaries accepted by the server
+    uint32_t samples_dropped; // Samples lost before upload: the sampler -> uploader ring or the RAM buffer was full
+    uint32_t windows_dropped; // Window summaries lost the same way, in their ring or buffer
+    uint32_t samples_refused; // Samples the server refused with a 4xx status other than 429, dropped instead of retried
+    uint32_t windows_refused; // Window summaries refused the same way
+    uint64_t payload_bytes; // Request body bytes of the accepted uploads
+} http_uploader_stats_t;
+
+/**
+ * @brief Open the flash spool, set up the sample rings and start the uploader task on UPLOAD_TASK_CORE.
+ * The task owns one keep-alive HTTP client for its whole life and uploads
+ * the queued samples in batches, so the sampler never waits on the network.
+ * @return ESP_OK on success, ESP_ERR_INVALID_SIZE if a ring length is not a power of two, ESP_ERR_NO_MEM if the task could not be created.
+ */
+esp_err_t http_uploader_start(void);
+
+/**
+ * @brief Upload samples synchronously from the calling task, for callers that run without the uploader task.
+ * @param samples The samples to upload, oldest first
+ * @param n Number of samples
+ * @param post_data Scratch buffer for the payload
+ * @param len Size of post_data
+ * @param sent Number of leading samples the server accepted or refused, refused ones are dropped
+ * @return ESP_OK if all samples were accepted or refused, see http_uploader_stats_t.samples_refused.
+ */
+esp_err_t http_uploader_send(const sample_t *samples, size_t n, char *post_data, size_t len, size_t *sent);
+
+/**
+ * @brief Hand one sample to the uploader task, never blocks.
+ * Lock-free, only one task (the sampler) may call this and http_uploader_submit_window().
+ * @param sample The sample to upload
+ * @return true  If the sample was queued.
+ * @return false If the queue is full and the sample was dropped.
+ */
+bool http_uploader_submit(const sample_t *sample);
+
+/**
+ * @brief Hand one window summary to the uploader task, never blocks.
+ * Summaries are uploaded as JSON as soon as the network is up.
+ * @param window The summary to upload
+ * @return true  If the summary was queued.
+ * @return false If the queue is full and the summary was dropped.
+ */
+bool http_uploader_submit_window(const sample_window_t *window);
+
+/**
+ * @brief Tell the uploader whether the network is usable.
+ * While offline, samples are written to the flash spool and uploaded, oldest first, once back online.
+ * @param online true when the station got an IP, false when it lost the connection
+ */
+void http_uploader_set_online(bool online);
+
+/**
+ * @brief Copy the current latency statistics.
+ * @param out Destination
+ */
+void http_uploader_get_stats(http_uploader_stats_t *out);
@@ -0,0 +1,199 @@
+#include <math.h>
+#include "json-encoder.h"
+
+#define JSON_LUX_CHUNK 16 // Samples converted to lux per pass
+#define JSON_FIXED2_MAX_CENTI 99999999999LL // 999999999.99, the widest value JSON_SAMPLE_MAX_LEN and JSON_WINDOW_MAX_LEN leave room for
+
+/**
+ * @brief Bounded output cursor, once overflow is set every further write is ignored.
+ */
+typedef struct
+{
+    char *buf;
+    size_t len;
+    size_t pos;
+    bool overflow;
+} json_writer_t;
+
+static void put_char(json_writer_t *w, char c)
+{
+    // Keep one byte for the terminating NUL
+    if (w->overflow || w->pos + 1 >= w->len)
+    {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->pos++] = c;
+}
+
+static void put_str(json_writer_t *w, const char *s)
+{
+    while (*s)
+    {
+        put_char(w, *s++);
+    }
+}
+
+static void put_uint64(json_writer_t *w, uint64_t v)
+{
+    char digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n)
+    {
+        put_char(w, digits[--n]);
+    }
+}
+
+static void put_int64(json_writer_t *w, int64_t v)
+{
+    if (v < 0)
+    {
+        put_char(w, '-');
+        put_uint64(w, (uint64_t)0 - (uint64_t)v);
+    }
+    else
+    {
+        put_uint64(w, (uint64_t)v);
+    }
+}
+
+/**
+ * @brief Write a value with 2 fixed decimals using integer math only.
+ * printf("%f") goes through newlib's dtoa, which allocates from the heap.
+ * Values beyond JSON_FIXED2_MAX_CENTI are clamped, NaN and infinity written as null.
+ */
+static void put_fixed2(json_writer_t *w, float value)
+{
+    if (!isfinite(value))
+    {
+        put_str(w, "null"); // JSON has no NaN or infinity
+        return;
+    }
+    // Clamp before rounding, llroundf() is undefined outside the int64 range
+    int64_t centi = JSON_FIXED2_MAX_CENTI;
+    if (fabsf(value) < JSON_FIXED2_MAX_CENTI / 100)
+    {
+        // Whole part and fraction apart, value * 100 alone loses the cents above 2^24 / 100
+        float whole = truncf(fabsf(value));
+        centi = (int64_t)whole * 100 + lroundf((fabsf(value) - whole) * 100.0f);
+        centi = (centi < JSON_FIXED2_MAX_CENTI) ? centi : JSON_FIXED2_MAX_CENTI;
+    }
+    if (value < 0 && centi)
+    {
+        put_char(w, '-');
+    }
+    put_uint64(w, (uint64_t)(centi / 100));
+    put_char(w, '.');
+    put_char(w, (char)('0' + (centi / 10) % 10));
+    put_char(w, (char)('0' + centi % 10));
+}
+
+static void put_sample(json_writer_t *w, const sample_t *sample, float lux)
+{
+    put_str(w, "{\"lux\":");
+    put_fixed2(w, lux);
+    // Range metadata, lets the server tell resolution and saturation apart
+    put_str(w, ",\"raw\":");
+    put_uint64(w, sample->raw);
+    put_str(w, ",\"mode\":");
+    put_uint64(w, sample->mode);
+    put_str(w, ",\"mtreg\":");
+    put_uint64(w, sample->mtreg);
+    put_str(w, ",\"ch\":");
+    put_uint64(w, sample->channel);
+    put_str(w, ",\"ts_us\":");
+    put_int64(w, sample->timestamp_us);
+    put_char(w, '}');
+}
+
+static void put_window(json_writer_t *w, const sample_window_t *window)
+{
+    put_str(w, "{\"ch\":");
+    put_uint64(w, window->channel);
+    put_str(w, ",\"ts\":");
+    put_int64(w, window->start_ms);
+    put_str(w, ",\"win\":");
+    put_uint64(w, window->window_ms);
+    put_str(w, ",\"n\":");
+    put_uint64(w, window->count);
+    put_str(w, ",\"min\":");
+    put_fixed2(w, window->min);
+    put_str(w, ",\"max\":");
+    put_fixed2(w, window->max);
+    put_str(w, ",\"mean\":");
+    put_fixed2(w, window->mean);
+    put_str(w, ",\"sd\":");
+    put_fixed2(w, window->stddev);
+    put_str(w, ",\"first\":");
+    put_fixed2(w, window->first);
+    put_str(w, ",\"last\":");
+    put_fixed2(w, window->last);
+    put_char(w, '}');
+}
+
+static esp_err_t finish(json_writer_t *w, size_t *out_len)
+{
+    if (w->overflow || w->len == 0)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    w->buf[w->pos] = '\0';
+    if (out_len)
+    {
+        *out_len = w->pos;
+    }
+    return ESP_OK;
+}
+
+esp_err_t json_encode_sample(const sample_t *sample, char *buf, size_t len, size_t *out_len)
+{
+    json_writer_t w = {.buf = buf, .len = len};
+    float lux;
+    sample_to_lux(sample, &lux, 1);
+    put_sample(&w, sample, lux);
+    return finish(&w, out_len);
+}
+
+esp_err_t json_encode_batch(const sample_t *samples, size_t n, char *buf, size_t len, size_t *out_len)
+{
+    json_writer_t w = {.buf = buf, .len = len};
+    float lux[JSON_LUX_CHUNK];
+    put_char(&w, '[');
+    for (size_t i = 0; i < n && !w.overflow; i++)
+    {
+        // Convert counts to lux a chunk at a time, right before they are written
+        if (i % JSON_LUX_CHUNK == 0)
+        {
+            size_t chunk = (n - i < JSON_LUX_CHUNK) ? n - i : JSON_LUX_CHUNK;
+            sample_to_lux(&samples[i], lux, chunk);
+        }
+        if (i)
+        {
+            put_char(&w, ',');
+        }
+        put_sample(&w, &samples[i], lux[i % JSON_LUX_CHUNK]);
+    }
+    put_char(&w, ']');
+    return finish(&w, out_len);
+}
+
+esp_err_t json_encode_windows(const sample_window_t *windows, size_t n, char *buf, size_t len, size_t *out_len)
+{
+    json_writer_t w = {.buf = buf, .len = len};
+    put_char(&w, '[');
+    for (size_t i = 0; i < n && !w.overflow; i++)
+    {
+        if (i)
+        {
+            put_char(&w, ',');
+        }
+        put_window(&w, &windows[i]);
+    }
+    put_char(&w, ']');
+    return finish(&w, out_len);
+}
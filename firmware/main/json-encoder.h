@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "sample-buffer.h"
+#include "sample-aggregator.h"
+
+#define JSON_SAMPLE_MAX_LEN 96  // Upper bound of one encoded sample including the separator
+#define JSON_WINDOW_MAX_LEN 192 // Upper bound of one encoded window summary including the separator
+
+/**
+ * @brief Encode one sample as {"lux":123.45,"raw":148,"mode":32,"mtreg":69,"ch":0,"ts_us":1727000000000000}
+ * Writes straight into the caller's buffer, never allocates, always NUL-terminates on success.
+ * Lux is computed from the raw count and written with 2 decimals, the count is sent along with the
+ * mode and MTreg it was taken with. ch is the sensor channel id, ts_us is Unix epoch time in microseconds.
+ * @param sample The sample to encode
+ * @param buf Destination buffer
+ * @param len Size of buf
+ * @param out_len Length of the JSON string (without the NUL), may be NULL
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_SIZE buf is too small, buf content is undefined
+ */
+esp_err_t json_encode_sample(const sample_t *sample, char *buf, size_t len, size_t *out_len);
+
+/**
+ * @brief Encode a batch of samples as a JSON array of sample objects.
+ * @param samples The samples to encode, oldest first
+ * @param n Number of samples
+ * @param buf Destination buffer
+ * @param len Size of buf
+ * @param out_len Length of the JSON string (without the NUL), may be NULL
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_SIZE buf is too small, buf content is undefined
+ */
+esp_err_t json_encode_batch(const sample_t *samples, size_t n, char *buf, size_t len, size_t *out_len);
+
+/**
+ * @brief Encode window summaries as a JSON array of
+ * {"ch":0,"ts":1727000000000,"win":60000,"n":120,"min":1.00,"max":2.00,"mean":1.50,"sd":0.25,"first":1.00,"last":2.00}
+ * ts is the window start in Unix epoch ms, win its length in ms, n the number of samples, all values in lux
+ * with 2 decimals, clamped to +-999999999.99, NaN and infinity as null.
+ * @param windows The summaries to encode, oldest first
+ * @param n Number of summaries
+ * @param buf Destination buffer
+ * @param len Size of buf
+ * @param out_len Length of the JSON string (without the NUL), may be NULL
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_SIZE buf is too small, buf content is undefined
+ */
+esp_err_t json_encode_windows(const sample_window_t *windows, size_t n, char *buf, size_t len, size_t *out_len);
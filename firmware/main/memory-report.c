@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "config.h"
+#include "memory-report.h"
+
+#if STATIC_ALLOCATION && !(CONFIG_I2C_BUS_STATIC_ALLOCATION && CONFIG_BH1750_STATIC_INSTANCES >= SENSOR_ARRAY_MAX_CHANNELS)
+#error "STATIC_ALLOCATION needs CONFIG_I2C_BUS_STATIC_ALLOCATION=y and CONFIG_BH1750_STATIC_INSTANCES >= SENSOR_ARRAY_MAX_CHANNELS"
+#endif
+
+// Section bounds from the ESP-IDF linker script
+extern int _data_start, _data_end, _bss_start, _bss_end;
+extern int _rtc_data_start, _rtc_data_end, _rtc_bss_start, _rtc_bss_end;
+
+typedef struct
+{
+    const char *name;
+    const void *addr;  // NULL for a task stack on the heap
+    size_t size;
+    TaskHandle_t task; // Set for task stacks
+} memory_region_t;
+
+static memory_region_t s_regions[MEMORY_REPORT_MAX_REGIONS];
+static size_t s_region_count;
+static size_t s_baseline_free; // Free heap at the first check, 0 before it
+
+static void add_region(const char *name, const void *addr, size_t size, TaskHandle_t task)
+{
+    if (s_region_count == MEMORY_REPORT_MAX_REGIONS)
+    {
+        ESP_LOGW(TAG_m, "Memory map full, %s not listed", name);
+        return;
+    }
+    s_regions[s_region_count++] = (memory_region_t){.name = name, .addr = addr, .size = size, .task = task};
+}
+
+void memory_report_add(const char *name, const void *addr, size_t size)
+{
+    add_region(name, addr, size, NULL);
+}
+
+void memory_report_add_task(TaskHandle_t task, const void *stack, size_t size)
+{
+    add_region(pcTaskGetName(task), stack, size, task);
+}
+
+static void log_section(const char *name, const int *start, const int *end)
+{
+    ESP_LOGI(TAG_m, "  %-12s %p %7u B", name, (const void *)start, (unsigned)((const char *)end - (const char *)start));
+}
+
+void memory_report_log(void)
+{
+    ESP_LOGI(TAG_m, "Memory map (%s allocation):", STATIC_ALLOCATION ? "static" : "heap");
+    log_section(".data", &_data_start, &_data_end);
+    log_section(".bss", &_bss_start, &_bss_end);
+    log_section(".rtc.data", &_rtc_data_start, &_rtc_data_end);
+    log_section(".rtc.bss", &_rtc_bss_start, &_rtc_bss_end);
+
+    size_t arenas = 0;
+    for (size_t i = 0; i < s_region_count; i++)
+    {
+        const memory_region_t *r = &s_regions[i];
+        if (r->task)
+        {
+            // High water mark in bytes, the stack depth unit is one byte on ESP-IDF
+            ESP_LOGI(TAG_m, "  %-12s %p %7u B stack%s, %u B never used", r->name, r->addr, (unsigned)r->size,
+                     r->addr ? "" : " on the heap", (unsigned)uxTaskGetStackHighWaterMark(r->task));
+        }
+        else
+        {
+            ESP_LOGI(TAG_m, "  %-12s %p %7u B", r->name, r->addr, (unsigned)r->size);
+        }
+        arenas += r->addr ? r->size : 0;
+    }
+    ESP_LOGI(TAG_m, "  %u B in listed static arenas", (unsigned)arenas);
+
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, MALLOC_CAP_INTERNAL);
+    ESP_LOGI(TAG_m, "  internal heap: %u B free of %u B, %u B largest block, %u B minimum free",
+             (unsigned)info.total_free_bytes, (unsigned)(info.total_free_bytes + info.total_allocated_bytes),
+             (unsigned)info.largest_free_block, (unsigned)info.minimum_free_bytes);
+}
+
+void memory_report_check_heap(void)
+{
+    size_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    if (s_baseline_free == 0)
+    {
+        s_baseline_free = free_bytes;
+    }
+    long growth = (long)s_baseline_free - (long)free_bytes;
+    ESP_LOGI(TAG_m, "Heap: %u B free (%+ld B in use since the first check), %u B minimum free, %u B largest block",
+             (unsigned)free_bytes, growth, (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+             (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    if (growth > HEAP_GROWTH_WARN_BYTES)
+    {
+        ESP_LOGW(TAG_m, "Heap use grew by %ld B", growth);
+    }
+}
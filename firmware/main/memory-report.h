@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Boot-time memory map and heap watch. Modules register their compile-time
+ * arenas and task stacks, memory_report_log() prints them together with the
+ * linker sections and the heap. memory_report_check_heap() runs with the
+ * periodic stats and flags heap use that keeps growing, which with
+ * STATIC_ALLOCATION can only come from ESP-IDF itself.
+ */
+
+/**
+ * @brief Add a static arena to the memory map.
+ * @param name Label, must stay valid
+ * @param addr Start of the arena
+ * @param size Size in bytes
+ */
+void memory_report_add(const char *name, const void *addr, size_t size);
+
+/**
+ * @brief Add a task stack to the memory map, the report shows its high water mark.
+ * @param task The task
+ * @param stack Start of a static stack, NULL if it came from the heap
+ * @param size Stack size in bytes
+ */
+void memory_report_add_task(TaskHandle_t task, const void *stack, size_t size);
+
+/**
+ * @brief Log the linker sections, the registered arenas and stacks, and the heap.
+ */
+void memory_report_log(void);
+
+/**
+ * @brief Log the heap and warn if the heap in use grew by more than HEAP_GROWTH_WARN_BYTES
+ * since the first call.
+ */
+void memory_report_check_heap(void);
@@ -0,0 +1,38 @@
+#include <math.h>
+#include "esp_attr.h"
+#include "report-filter.h"
+
+/**
+ * @brief Last report of one channel
+ */
+typedef struct
+{
+    int64_t timestamp_us;
+    float lux;
+    bool valid; // false until the first report
+} report_state_t;
+
+static RTC_DATA_ATTR report_state_t s_reported[SENSOR_ARRAY_MAX_CHANNELS];
+
+bool report_filter_pass(const sample_t *sample)
+{
+    if (sample->channel >= SENSOR_ARRAY_MAX_CHANNELS)
+    {
+        return true;
+    }
+    report_state_t *last = &s_reported[sample->channel];
+    float lux;
+    sample_to_lux(sample, &lux, 1);
+
+    // The band is the wider of the absolute and the relative limit, so dark readings do not chatter
+    float band = fmaxf(REPORT_DEADBAND_LUX, fabsf(last->lux) * REPORT_DEADBAND_PCT / 100.0f);
+    bool report = !last->valid ||
+                  fabsf(lux - last->lux) > band ||
+                  sample->timestamp_us - last->timestamp_us >= REPORT_HEARTBEAT_MS * 1000LL ||
+                  sample->timestamp_us < last->timestamp_us; // Clock stepped back
+    if (report)
+    {
+        *last = (report_state_t){.timestamp_us = sample->timestamp_us, .lux = lux, .valid = true};
+    }
+    return report;
+}
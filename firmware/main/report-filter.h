@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include "sample-buffer.h"
+
+/*
+ * Report-by-exception. A sample of a channel is reported only if its lux
+ * value left the deadband around the last reported value of that channel,
+ * or if REPORT_HEARTBEAT_MS passed since that report. Between two reports
+ * the light stayed within the deadband, so the receiver rebuilds the series
+ * as steps holding the last reported value.
+ *
+ * The state is kept in RTC memory, so the filter also works across deep sleep.
+ *
+ * Only raw samples pass through the filter: in the duty-cycled mode before
+ * they are buffered, in continuous mode on the raw upload path. Window
+ * summaries of AGGREGATE_ENABLE are uploaded unfiltered, so continuous mode
+ * needs AGGREGATE_ENABLE 0 or AGGREGATE_RAW_PASSTHROUGH 1 for the filter to
+ * have an effect. sampler-task.c refuses to build otherwise.
+ */
+
+/**
+ * @brief Decide whether a sample is reported, and remember it if it is.
+ * @param sample The sample, in the order they were taken
+ * @return true If the sample has to be uploaded.
+ */
+bool report_filter_pass(const sample_t *sample);
@@ -0,0 +1,83 @@
+#include <math.h>
+#include "sample-aggregator.h"
+
+/**
+ * @brief Running statistics of one channel
+ */
+typedef struct
+{
+    int64_t start_ms; // Start of the running window
+    uint32_t count;   // 0 while no window is running
+    float mean;
+    float m2;         // Sum of squared differences from the mean
+    float min;
+    float max;
+    float first;
+    float last;
+} window_state_t;
+
+static window_state_t s_windows[SENSOR_ARRAY_MAX_CHANNELS];
+
+static void window_close(const window_state_t *w, uint8_t channel, sample_window_t *out)
+{
+    *out = (sample_window_t){
+        .start_ms = w->start_ms,
+        .window_ms = AGGREGATE_WINDOW_MS,
+        .count = (uint16_t)(w->count > UINT16_MAX ? UINT16_MAX : w->count),
+        .channel = channel,
+        .min = w->min,
+        .max = w->max,
+        .mean = w->mean,
+        .stddev = (w->count > 1) ? sqrtf(w->m2 / (float)(w->count - 1)) : 0.0f,
+        .first = w->first,
+        .last = w->last};
+}
+
+bool sample_aggregator_add(const sample_t *sample, sample_window_t *out)
+{
+    if (sample->channel >= SENSOR_ARRAY_MAX_CHANNELS)
+    {
+        return false;
+    }
+    window_state_t *w = &s_windows[sample->channel];
+    int64_t timestamp_ms = sample->timestamp_us / 1000;
+    int64_t start_ms = timestamp_ms - timestamp_ms % AGGREGATE_WINDOW_MS;
+    bool closed = false;
+    if (w->count && start_ms != w->start_ms)
+    {
+        window_close(w, sample->channel, out);
+        closed = true;
+        w->count = 0;
+    }
+
+    float lux;
+    sample_to_lux(sample, &lux, 1);
+    if (w->count == 0)
+    {
+        *w = (window_state_t){.start_ms = start_ms, .min = lux, .max = lux, .first = lux};
+    }
+    // Welford: numerically stable single pass mean and variance
+    w->count++;
+    float delta = lux - w->mean;
+    w->mean += delta / (float)w->count;
+    w->m2 += delta * (lux - w->mean);
+    w->min = fminf(w->min, lux);
+    w->max = fmaxf(w->max, lux);
+    w->last = lux;
+    return closed;
+}
+
+size_t sample_aggregator_close(int64_t now_ms, sample_window_t *out, size_t max)
+{
+    size_t n = 0;
+    for (uint8_t channel = 0; channel < SENSOR_ARRAY_MAX_CHANNELS && n < max; channel++)
+    {
+        window_state_t *w = &s_windows[channel];
+        if (w->count && (now_ms == INT64_MAX || now_ms >= w->start_ms + AGGREGATE_WINDOW_MS))
+        {
+            window_close(w, channel, &out[n++]);
+            w->count = 0;
+        }
+    }
+    return n;
+}
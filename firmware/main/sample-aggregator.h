@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sample-buffer.h"
+
+/*
+ * Windowed aggregation between the sampler and the uploader. Samples of each
+ * channel are folded into tumbling windows of AGGREGATE_WINDOW_MS aligned to
+ * the epoch, so windows of all channels and devices line up. A window closes
+ * with the first sample of a later one, or at the latest with the first
+ * sample_aggregator_close() after its end. Mean and variance are kept with
+ * Welford's streaming update, nothing is buffered per sample. All statistics
+ * are in lux, the range may change inside a window.
+ */
+
+/**
+ * @brief Summary of one channel over one window
+ */
+typedef struct
+{
+    int64_t start_ms;   // Unix epoch ms of the window start
+    uint32_t window_ms; // Window length
+    uint16_t count;     // Samples in the window
+    uint8_t channel;    // Sensor channel id, see sensor-array.h
+    float min;
+    float max;
+    float mean;
+    float stddev;       // Sample standard deviation, 0 for a single sample
+    float first;        // First sample in the window
+    float last;         // Last sample in the window
+} sample_window_t;
+
+/**
+ * @brief Add one sample to the window of its channel.
+ * A sample from a later window closes the running one, which is returned in out.
+ * @param sample The sample to add
+ * @param out The closed window, only valid if true is returned
+ * @return true If a window was closed.
+ */
+bool sample_aggregator_add(const sample_t *sample, sample_window_t *out);
+
+/**
+ * @brief Close the running windows that ended by now_ms, so a channel that stops
+ * delivering samples does not hold its last window back.
+ * @param now_ms Current Unix epoch ms, see sample_now_ms(). INT64_MAX closes every running window.
+ * @param out Destination for the closed windows
+ * @param max Capacity of out, SENSOR_ARRAY_MAX_CHANNELS is always enough
+ * @return Number of windows written to out.
+ */
+size_t sample_aggregator_close(int64_t now_ms, sample_window_t *out, size_t max);
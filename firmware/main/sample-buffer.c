@@ -0,0 +1,84 @@
+#include "sample-buffer.h"
+#include "time-sync.h"
+
+int64_t sample_now_us(void)
+{
+    return time_sync_now_us();
+}
+
+int64_t sample_now_ms(void)
+{
+    return time_sync_now_us() / 1000;
+}
+
+void sample_to_lux(const sample_t *samples, float *lux, size_t n)
+{
+    // The range rarely changes inside a batch, so the scale is only recomputed when it does
+    uint8_t mode = 0, mtreg = 0;
+    float scale = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (samples[i].mode != mode || samples[i].mtreg != mtreg)
+        {
+            mode = samples[i].mode;
+            mtreg = samples[i].mtreg;
+            scale = bh1750_lux_per_count((bh1750_measure_mode_t)mode, mtreg);
+        }
+        lux[i] = samples[i].raw * scale;
+    }
+}
+
+void sample_buffer_init(sample_buffer_t *buf)
+{
+    buf->head = 0;
+    buf->count = 0;
+    buf->dropped = 0;
+}
+
+bool sample_buffer_push(sample_buffer_t *buf, const sample_t *sample)
+{
+    size_t tail = (buf->head + buf->count) % SAMPLE_BUFFER_CAPACITY;
+    buf->samples[tail] = *sample;
+    if (buf->count < SAMPLE_BUFFER_CAPACITY)
+    {
+        buf->count++;
+        return true;
+    }
+    // Buffer full: the slot we just wrote was the oldest sample
+    buf->head = (buf->head + 1) % SAMPLE_BUFFER_CAPACITY;
+    buf->dropped++;
+    return false;
+}
+
+size_t sample_buffer_peek(const sample_buffer_t *buf, sample_t *out, size_t max)
+{
+    size_t n = (buf->count < max) ? buf->count : max;
+    for (size_t i = 0; i < n; i++)
+    {
+        out[i] = buf->samples[(buf->head + i) % SAMPLE_BUFFER_CAPACITY];
+    }
+    return n;
+}
+
+void sample_buffer_consume(sample_buffer_t *buf, size_t n)
+{
+    if (n > buf->count)
+    {
+        n = buf->count;
+    }
+    buf->head = (buf->head + n) % SAMPLE_BUFFER_CAPACITY;
+    buf->count -= n;
+}
+
+bool sample_buffer_should_flush(const sample_buffer_t *buf, int64_t now_us)
+{
+    if (buf->count == 0)
+    {
+        return false;
+    }
+    if (buf->count >= SAMPLE_BATCH_MAX_COUNT)
+    {
+        return true;
+    }
+    return (now_us - buf->samples[buf->head].timestamp_us) >= SAMPLE_BATCH_MAX_AGE_MS * 1000LL;
+}
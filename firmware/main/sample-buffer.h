@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "bh1750.h"
+
+/**
+ * @brief One timestamped light sample.
+ * The raw BH1750 count is stored, lux is only computed when samples are serialized.
+ */
+typedef struct
+{
+    int64_t timestamp_us; // Unix epoch time in microseconds, see time-sync.h
+    uint16_t raw;         // BH1750 data register count
+    uint8_t mode;         // bh1750_measure_mode_t the count was taken with
+    uint8_t mtreg;        // MTreg the count was taken with
+    uint8_t channel;      // Sensor channel id, see sensor-array.h
+} sample_t;
+
+/**
+ * @brief Fixed-capacity ring buffer of samples waiting for upload.
+ * When full, the oldest sample is overwritten so the newest data is always kept.
+ */
+typedef struct
+{
+    sample_t samples[SAMPLE_BUFFER_CAPACITY];
+    size_t head;      // Index of the oldest sample
+    size_t count;     // Number of samples currently stored
+    uint32_t dropped; // Samples overwritten because the buffer was full
+} sample_buffer_t;
+
+/**
+ * @brief Current Unix time in microseconds, the clock used for sample_t.timestamp_us.
+ */
+int64_t sample_now_us(void);
+
+/**
+ * @brief Current Unix time in milliseconds.
+ */
+int64_t sample_now_ms(void);
+
+/**
+ * @brief Convert the raw counts of n samples to lux in one pass.
+ * @param samples The samples to convert
+ * @param lux Destination array of n values
+ * @param n Number of samples
+ */
+void sample_to_lux(const sample_t *samples, float *lux, size_t n);
+
+/**
+ * @brief Reset the buffer to empty.
+ * @param buf The buffer to reset
+ */
+void sample_buffer_init(sample_buffer_t *buf);
+
+/**
+ * @brief Append a sample, overwriting the oldest one when the buffer is full.
+ * @param buf The buffer
+ * @param sample The sample to append
+ * @return true  If the sample was stored without dropping anything.
+ * @return false If the oldest sample had to be overwritten.
+ */
+bool sample_buffer_push(sample_buffer_t *buf, const sample_t *sample);
+
+/**
+ * @brief Copy up to max samples, oldest first, without removing them.
+ * @param buf The buffer
+ * @param out Destination array
+ * @param max Capacity of out
+ * @return Number of samples copied
+ */
+size_t sample_buffer_peek(const sample_buffer_t *buf, sample_t *out, size_t max);
+
+/**
+ * @brief Remove the n oldest samples, call this after a batch was uploaded.
+ * @param buf The buffer
+ * @param n Number of samples to remove
+ */
+void sample_buffer_consume(sample_buffer_t *buf, size_t n);
+
+/**
+ * @brief Check whether the buffered samples should be flushed as one batch.
+ * A flush is due when SAMPLE_BATCH_MAX_COUNT samples are buffered or when
+ * the oldest one is older than SAMPLE_BATCH_MAX_AGE_MS.
+ * @param buf The buffer
+ * @param now_us Current time in the same clock as sample_t.timestamp_us
+ * @return true If a flush is due.
+ */
+bool sample_buffer_should_flush(const sample_buffer_t *buf, int64_t now_us);
@@ -0,0 +1,288 @@
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "sample-spool.h"
+
+#define SPOOL_SECTOR_SIZE 4096
+#define SPOOL_SECTOR_MAGIC 0x4C4F4F50 // "POOL"
+#define SPOOL_HEADER_SIZE 16
+#define SPOOL_RECORD_MARKER 0x5B      // Written with every record, 0xFF means empty slot
+#define SPOOL_RECORD_ACKED 0x00       // Last record of an uploaded batch
+#define SPOOL_RECORDS_PER_SECTOR ((SPOOL_SECTOR_SIZE - SPOOL_HEADER_SIZE) / sizeof(spool_record_t))
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t seq; // Increases by one for every sector opened, stored at seq % sector count
+    uint8_t reserved[SPOOL_HEADER_SIZE - 8];
+} spool_sector_header_t;
+
+typedef struct __attribute__((packed))
+{
+    int64_t timestamp_us;
+    uint16_t raw;
+    uint8_t mode;
+    uint8_t mtreg;
+    uint8_t marker;
+    uint8_t crc;   // CRC8 over the fields above and the channel byte
+    uint8_t acked; // 0xFF until the record ends an acknowledged batch
+    uint8_t channel_inv; // ~channel, so records written before channels existed (0xFF) read as channel 0
+} spool_record_t;
+
+/*
+ * Positions are absolute record numbers that only ever grow: record p lives in
+ * sequence number p / SPOOL_RECORDS_PER_SECTOR, and sequence number seq is
+ * stored in physical sector seq % sector count.
+ */
+static const esp_partition_t *s_partition;
+static uint32_t s_sector_count;
+static uint64_t s_write;       // Position of the next record to write
+static uint64_t s_read;        // Position of the oldest pending record
+static uint32_t s_open_seq;    // Sequence number of the sector currently written
+static uint64_t s_peek_end;    // Position after the last record returned by peek
+static size_t s_peek_count;
+static uint32_t s_dropped;
+
+static size_t sector_offset(uint32_t seq)
+{
+    return (size_t)(seq % s_sector_count) * SPOOL_SECTOR_SIZE;
+}
+
+static size_t record_offset(uint64_t pos)
+{
+    return sector_offset((uint32_t)(pos / SPOOL_RECORDS_PER_SECTOR)) + SPOOL_HEADER_SIZE +
+           (size_t)(pos % SPOOL_RECORDS_PER_SECTOR) * sizeof(spool_record_t);
+}
+
+static uint8_t record_crc(const spool_record_t *rec)
+{
+    uint8_t crc = esp_rom_crc8_le(0, (const uint8_t *)rec, offsetof(spool_record_t, marker));
+    // Channel 0 is left out, which keeps older records valid and still catches a torn channel byte
+    return (rec->channel_inv == 0xFF) ? crc : esp_rom_crc8_le(crc, &rec->channel_inv, 1);
+}
+
+static bool record_valid(const spool_record_t *rec)
+{
+    return rec->marker == SPOOL_RECORD_MARKER && rec->crc == record_crc(rec);
+}
+
+/**
+ * @brief Erase the sector for seq and write its header.
+ * Pending records still stored in that sector are given up.
+ */
+static esp_err_t open_sector(uint32_t seq)
+{
+    uint64_t keep_from = (seq >= s_sector_count) ? (uint64_t)(seq - s_sector_count + 1) * SPOOL_RECORDS_PER_SECTOR : 0;
+    if (s_read < keep_from)
+    {
+        uint32_t lost = (uint32_t)(keep_from - s_read);
+        s_dropped += lost;
+        s_read = keep_from;
+        ESP_LOGW(TAG_s, "Spool full, dropped %lu oldest samples", (unsigned long)lost);
+    }
+
+    esp_err_t err = esp_partition_erase_range(s_partition, sector_offset(seq), SPOOL_SECTOR_SIZE);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    spool_sector_header_t header = {.magic = SPOOL_SECTOR_MAGIC, .seq = seq};
+    memset(header.reserved, 0xFF, sizeof(header.reserved));
+    err = esp_partition_write(s_partition, sector_offset(seq), &header, sizeof(header));
+    if (err == ESP_OK)
+    {
+        s_open_seq = seq;
+    }
+    return err;
+}
+
+/**
+ * @brief Find the position after the last acknowledged record, walking back from the newest sector.
+ */
+static uint64_t recover_read_pos(uint32_t oldest_seq, uint32_t newest_seq)
+{
+    static spool_record_t records[SPOOL_RECORDS_PER_SECTOR];
+    for (uint32_t seq = newest_seq + 1; seq-- > oldest_seq;)
+    {
+        if (esp_partition_read(s_partition, sector_offset(seq) + SPOOL_HEADER_SIZE, records, sizeof(records)) != ESP_OK)
+        {
+            continue;
+        }
+        for (int slot = SPOOL_RECORDS_PER_SECTOR - 1; slot >= 0; slot--)
+        {
+            if (records[slot].marker == SPOOL_RECORD_MARKER && records[slot].acked == SPOOL_RECORD_ACKED)
+            {
+                return (uint64_t)seq * SPOOL_RECORDS_PER_SECTOR + slot + 1;
+            }
+        }
+    }
+    return (uint64_t)oldest_seq * SPOOL_RECORDS_PER_SECTOR;
+}
+
+esp_err_t sample_spool_init(void)
+{
+    s_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SPOOL_PARTITION_LABEL);
+    if (s_partition == NULL)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    s_sector_count = s_partition->size / SPOOL_SECTOR_SIZE;
+
+    // The newest sector has the highest sequence number, the oldest one the lowest
+    uint32_t oldest_seq = UINT32_MAX, newest_seq = 0;
+    bool found = false;
+    for (uint32_t sector = 0; sector < s_sector_count; sector++)
+    {
+        spool_sector_header_t header;
+        esp_err_t err = esp_partition_read(s_partition, (size_t)sector * SPOOL_SECTOR_SIZE, &header, sizeof(header));
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        if (header.magic != SPOOL_SECTOR_MAGIC || header.seq % s_sector_count != sector)
+        {
+            continue;
+        }
+        found = true;
+        newest_seq = (header.seq > newest_seq) ? header.seq : newest_seq;
+        oldest_seq = (header.seq < oldest_seq) ? header.seq : oldest_seq;
+    }
+
+    if (!found)
+    {
+        // Fresh partition
+        s_read = s_write = 0;
+        return open_sector(0);
+    }
+
+    // Continue after the last written slot of the newest sector
+    s_open_seq = newest_seq;
+    s_write = (uint64_t)newest_seq * SPOOL_RECORDS_PER_SECTOR;
+    for (uint32_t slot = 0; slot < SPOOL_RECORDS_PER_SECTOR; slot++, s_write++)
+    {
+        uint8_t marker;
+        esp_partition_read(s_partition, record_offset(s_write) + offsetof(spool_record_t, marker), &marker, 1);
+        if (marker == 0xFF)
+        {
+            break;
+        }
+    }
+
+    s_read = recover_read_pos(oldest_seq, newest_seq);
+    ESP_LOGI(TAG_s, "Spool recovered: %lu sectors, %u samples pending", (unsigned long)s_sector_count, (unsigned)sample_spool_pending());
+    return ESP_OK;
+}
+
+esp_err_t sample_spool_append(const sample_t *samples, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t seq = (uint32_t)(s_write / SPOOL_RECORDS_PER_SECTOR);
+        if (seq != s_open_seq)
+        {
+            esp_err_t err = open_sector(seq);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+        }
+
+        spool_record_t rec = {
+            .timestamp_us = samples[i].timestamp_us,
+            .raw = samples[i].raw,
+            .mode = samples[i].mode,
+            .mtreg = samples[i].mtreg,
+            .marker = SPOOL_RECORD_MARKER,
+            .acked = 0xFF,
+            .channel_inv = (uint8_t)~samples[i].channel};
+        rec.crc = record_crc(&rec);
+        esp_err_t err = esp_partition_write(s_partition, record_offset(s_write), &rec, sizeof(rec));
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        s_write++;
+    }
+    return ESP_OK;
+}
+
+size_t sample_spool_pending(void)
+{
+    return (size_t)(s_write - s_read);
+}
+
+size_t sample_spool_peek(sample_t *out, size_t max)
+{
+    static spool_record_t records[32];
+    uint64_t pos = s_read;
+    size_t n = 0;
+
+    while (n < max && pos < s_write)
+    {
+        // Read as many consecutive records of one sector as possible in one go
+        uint64_t chunk = SPOOL_RECORDS_PER_SECTOR - pos % SPOOL_RECORDS_PER_SECTOR;
+        chunk = (chunk < s_write - pos) ? chunk : s_write - pos;
+        chunk = (chunk < sizeof(records) / sizeof(records[0])) ? chunk : sizeof(records) / sizeof(records[0]);
+        if (esp_partition_read(s_partition, record_offset(pos), records, (size_t)chunk * sizeof(spool_record_t)) != ESP_OK)
+        {
+            break;
+        }
+        for (size_t i = 0; i < chunk && n < max; i++, pos++)
+        {
+            // Corrupted records (e.g. power loss mid-write) are skipped
+            if (record_valid(&records[i]))
+            {
+                out[n++] = (sample_t){
+                    .timestamp_us = records[i].timestamp_us,
+                    .raw = records[i].raw,
+                    .mode = records[i].mode,
+                    .mtreg = records[i].mtreg,
+                    .channel = (uint8_t)~records[i].channel_inv};
+            }
+        }
+    }
+
+    s_peek_end = pos;
+    s_peek_count = n;
+    return n;
+}
+
+esp_err_t sample_spool_consume(size_t n)
+{
+    if (n == 0 || s_read == s_write)
+    {
+        return ESP_OK;
+    }
+
+    uint64_t end = s_peek_end;
+    if (n < s_peek_count)
+    {
+        // Partial acknowledge: walk the records again to find where the n-th valid one ends
+        spool_record_t rec;
+        for (end = s_read; n > 0 && end < s_write; end++)
+        {
+            if (esp_partition_read(s_partition, record_offset(end), &rec, sizeof(rec)) == ESP_OK && record_valid(&rec))
+            {
+                n--;
+            }
+        }
+    }
+    if (end <= s_read)
+    {
+        return ESP_OK;
+    }
+
+    // Mark the last consumed record, everything before it counts as uploaded after a reboot
+    uint8_t acked = SPOOL_RECORD_ACKED;
+    esp_err_t err = esp_partition_write(s_partition, record_offset(end - 1) + offsetof(spool_record_t, acked), &acked, 1);
+    s_read = end;
+    s_peek_count = 0;
+    return err;
+}
+
+uint32_t sample_spool_dropped(void)
+{
+    return s_dropped;
+}
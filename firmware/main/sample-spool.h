@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample-buffer.h"
+
+/*
+ * Append-only sample log on the "spool" flash partition, used while the
+ * server cannot be reached.
+ *
+ * The partition is a ring of 4 KB sectors. Each sector starts with a header
+ * holding a sequence number, followed by fixed-size records written in order.
+ * A sector is only erased when the ring wraps around, so every sector wears at
+ * the same rate. When an uploaded batch is acknowledged, its last record is
+ * marked by clearing one byte in place, so the read position survives a
+ * reboot without a separate index. If the ring fills up, the oldest sector is
+ * dropped to keep the newest data.
+ */
+
+/**
+ * @brief Find the spool partition and recover the read/write positions.
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_NOT_FOUND No "spool" partition in the partition table
+ *     - Others Error from the flash driver
+ */
+esp_err_t sample_spool_init(void);
+
+/**
+ * @brief Append samples to the end of the log.
+ * @param samples The samples to append, oldest first
+ * @param n Number of samples
+ * @return ESP_OK on success, error from the flash driver otherwise.
+ */
+esp_err_t sample_spool_append(const sample_t *samples, size_t n);
+
+/**
+ * @brief Number of samples written but not acknowledged yet.
+ */
+size_t sample_spool_pending(void);
+
+/**
+ * @brief Read up to max of the oldest pending samples without removing them.
+ * @param out Destination array
+ * @param max Capacity of out
+ * @return Number of samples read
+ */
+size_t sample_spool_peek(sample_t *out, size_t max);
+
+/**
+ * @brief Acknowledge the samples returned by the last sample_spool_peek().
+ * @param n Number of samples acknowledged, at most the count returned by the last peek
+ * @return ESP_OK on success, error from the flash driver otherwise.
+ */
+esp_err_t sample_spool_consume(size_t n);
+
+/**
+ * @brief Samples lost because the spool was full.
+ */
+uint32_t sample_spool_dropped(void);
@@ -0,0 +1,136 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "driver/gptimer.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "config.h"
+#include "sample-timer.h"
+
+static gptimer_handle_t s_timer;
+static SemaphoreHandle_t s_tick;
+static uint32_t s_period_us;
+static int64_t s_first_alarm_us; // 0 until the first alarm
+static volatile uint32_t s_alarms;
+static volatile bool s_busy;     // The sampler is processing an alarm
+static sample_timer_stats_t s_stats;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool IRAM_ATTR on_alarm(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *arg)
+{
+    if (s_first_alarm_us == 0)
+    {
+        s_first_alarm_us = esp_timer_get_time();
+    }
+    portENTER_CRITICAL_ISR(&s_stats_lock);
+    s_alarms++;
+    s_stats.ticks++;
+    if (s_busy)
+    {
+        s_stats.missed++;
+    }
+    portEXIT_CRITICAL_ISR(&s_stats_lock);
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(s_tick, &woken);
+    return woken == pdTRUE;
+}
+
+static size_t hist_bin(int64_t abs_us)
+{
+    size_t bin = 0;
+    while (bin + 1 < SAMPLE_TIMER_HIST_BINS && abs_us >= (16LL << bin))
+    {
+        bin++;
+    }
+    return bin;
+}
+
+esp_err_t sample_timer_start(uint32_t period_us)
+{
+#if STATIC_ALLOCATION
+    static StaticSemaphore_t s_tick_buf;
+    s_tick = xSemaphoreCreateBinaryStatic(&s_tick_buf);
+#else
+    s_tick = xSemaphoreCreateBinary();
+#endif
+    if (s_tick == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    s_period_us = period_us;
+    s_stats.period_us = period_us;
+
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = 1000000}; // 1 tick = 1 us
+    esp_err_t err = gptimer_new_timer(&timer_config, &s_timer);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    gptimer_event_callbacks_t callbacks = {.on_alarm = on_alarm};
+    err = gptimer_register_event_callbacks(s_timer, &callbacks, NULL);
+    if (err == ESP_OK)
+    {
+        // Allocates the interrupt on the calling core
+        err = gptimer_enable(s_timer);
+    }
+    if (err == ESP_OK)
+    {
+        gptimer_alarm_config_t alarm_config = {
+            .alarm_count = period_us,
+            .reload_count = 0,
+            .flags.auto_reload_on_alarm = true};
+        err = gptimer_set_alarm_action(s_timer, &alarm_config);
+    }
+    if (err == ESP_OK)
+    {
+        err = gptimer_start(s_timer);
+    }
+    return err;
+}
+
+int64_t sample_timer_wait(void)
+{
+    // Alarms up to this count fired while the sampler was busy, i.e. were missed
+    portENTER_CRITICAL(&s_stats_lock);
+    s_busy = false;
+    uint32_t missed_up_to = s_alarms;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    // A missed alarm left the semaphore given. Taking it would wake the sampler late, off the
+    // grid, so it is dropped and the wait goes on until the next alarm
+    uint32_t alarm;
+    do
+    {
+        xSemaphoreTake(s_tick, portMAX_DELAY);
+        alarm = s_alarms;
+    } while (alarm == missed_up_to);
+    int64_t now_us = esp_timer_get_time();
+    s_busy = true;
+
+    // Ideal time of the latest alarm
+    int64_t ideal_us = s_first_alarm_us + (int64_t)(alarm - 1) * s_period_us;
+    int64_t abs_us = now_us - ideal_us;
+    if (abs_us < 0)
+    {
+        abs_us = -abs_us;
+    }
+    portENTER_CRITICAL(&s_stats_lock);
+    s_stats.wakeups++;
+    s_stats.total_us += abs_us;
+    if (abs_us > s_stats.max_us)
+    {
+        s_stats.max_us = abs_us;
+    }
+    s_stats.hist[hist_bin(abs_us)]++;
+    portEXIT_CRITICAL(&s_stats_lock);
+    return ideal_us;
+}
+
+void sample_timer_get_stats(sample_timer_stats_t *out)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Hardware-timed sampling clock. A GPTimer with 1 MHz resolution reloads
+ * itself every period, so the cadence neither drifts with the processing
+ * time of a sample nor is rounded to the FreeRTOS tick, and periods of a few
+ * milliseconds are possible. The alarm interrupt is allocated on the core of
+ * the task that starts the timer, i.e. the sampler core.
+ *
+ * Every wake-up of the sampler is compared with the ideal grid
+ * first alarm + k * period and the error goes into a log2 histogram. An alarm
+ * that fires while the previous one is still being processed is a missed
+ * deadline. It is dropped, the sampler waits for the next alarm on the grid
+ * instead of waking up late to catch up.
+ */
+
+#define SAMPLE_TIMER_HIST_BINS 12 // Bin 0: |error| < 16 us, bin i: < 16 << i us, last bin: the rest
+
+/**
+ * @brief Timing statistics of the sampling clock
+ */
+typedef struct
+{
+    uint32_t period_us;
+    uint32_t ticks;    // Alarms fired
+    uint32_t wakeups;  // Alarms the sampler woke up for
+    uint32_t missed;   // Alarms that fired while the sampler was still busy with the previous one
+    int64_t total_us;  // Sum of |wake-up - ideal|, total_us / wakeups = mean jitter
+    int64_t max_us;
+    uint32_t hist[SAMPLE_TIMER_HIST_BINS];
+} sample_timer_stats_t;
+
+/**
+ * @brief Create and start the periodic timer, call it from the task that waits on it.
+ * @param period_us Sampling period
+ * @return ESP_OK on success, error from the GPTimer driver otherwise.
+ */
+esp_err_t sample_timer_start(uint32_t period_us);
+
+/**
+ * @brief Block until the next alarm after the call and record the wake-up error.
+ * Alarms that fired since the previous wake-up are missed and not waited for.
+ * @return Time of the alarm on the ideal grid, in esp_timer_get_time() us.
+ */
+int64_t sample_timer_wait(void);
+
+/**
+ * @brief Copy the statistics, safe from any task.
+ * @param out Destination
+ */
+void sample_timer_get_stats(sample_timer_stats_t *out);
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "config.h"
+#include "sampler-task.h"
+#include "sample-timer.h"
+#include "sensor-array.h"
+#include "http-uploader.h"
+#include "sample-aggregator.h"
+#include "report-filter.h"
+#include "time-sync.h"
+#include "memory-report.h"
+
+#if REPORT_BY_EXCEPTION && !SLEEP_MODE_ENABLE && AGGREGATE_ENABLE && !AGGREGATE_RAW_PASSTHROUGH
+#error "REPORT_BY_EXCEPTION filters raw samples, set AGGREGATE_RAW_PASSTHROUGH or clear AGGREGATE_ENABLE"
+#endif
+
+/**
+ * @brief Log the sampling clock statistics and, in benchmark mode, the ring drops.
+ */
+static void log_timing(void)
+{
+    sample_timer_stats_t timing;
+    sample_timer_get_stats(&timing);
+    ESP_LOGI(TAG_b, "Sampling: %lu/%lu periods of %lu us, %lu missed, jitter mean %lld us max %lld us",
+             (unsigned long)timing.wakeups, (unsigned long)timing.ticks, (unsigned long)timing.period_us,
+             (unsigned long)timing.missed, timing.wakeups ? timing.total_us / timing.wakeups : 0, timing.max_us);
+    char hist[SAMPLE_TIMER_HIST_BINS * 11 + 1];
+    size_t pos = 0;
+    for (size_t i = 0; i < SAMPLE_TIMER_HIST_BINS; i++)
+    {
+        pos += snprintf(hist + pos, sizeof(hist) - pos, " %lu", (unsigned long)timing.hist[i]);
+    }
+    ESP_LOGI(TAG_b, "Jitter histogram (<16 us, <32 us, ... doubling):%s", hist);
+    time_sync_stats_t clock;
+    time_sync_get_stats(&clock);
+    ESP_LOGI(TAG_t, "Clock: %lu syncs (%lu steps), last error %lld us, drift %ld ppb",
+             (unsigned long)clock.syncs, (unsigned long)clock.steps, clock.last_error_us, (long)clock.drift_ppb);
+#if SAMPLER_BENCHMARK
+    http_uploader_stats_t upload;
+    http_uploader_get_stats(&upload);
+    ESP_LOGI(TAG_b, "Bench: uploader loaded, %lu samples dropped", (unsigned long)upload.samples_dropped);
+#endif
+}
+
+/**
+ * @brief Hand the samples of one period to the aggregator, the report filter and the uploader.
+ */
+static void publish(const sample_t *samples, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        // Debug level only, compiled out at the default log level to keep the sampling period free of UART writes
+        ESP_LOGD(TAG_b, "Light[%u]: %u counts", samples[i].channel, samples[i].raw);
+#if AGGREGATE_ENABLE
+        // One summary per channel and window goes out instead of every sample
+        sample_window_t window;
+        if (sample_aggregator_add(&samples[i], &window) && !http_uploader_submit_window(&window))
+        {
+            ESP_LOGW(TAG_h, "Upload ring full, window summary dropped");
+        }
+#endif
+#if !AGGREGATE_ENABLE || AGGREGATE_RAW_PASSTHROUGH
+#if REPORT_BY_EXCEPTION
+        if (!report_filter_pass(&samples[i]))
+        {
+            continue; // Within the deadband of the last report
+        }
+#endif
+        // Hand the sample to the uploader task, never wait on the network here
+        if (!http_uploader_submit(&samples[i]))
+        {
+            ESP_LOGW(TAG_h, "Upload ring full, sample dropped");
+        }
+#endif
+    }
+#if AGGREGATE_ENABLE
+    // Windows end on time, also for a channel whose samples stopped
+    sample_window_t windows[SENSOR_ARRAY_MAX_CHANNELS];
+    size_t closed = sample_aggregator_close(sample_now_ms(), windows, SENSOR_ARRAY_MAX_CHANNELS);
+    for (size_t i = 0; i < closed; i++)
+    {
+        if (!http_uploader_submit_window(&windows[i]))
+        {
+            ESP_LOGW(TAG_h, "Upload ring full, window summary dropped");
+        }
+    }
+#endif
+}
+
+static void sampler_task(void *arg)
+{
+    // Started here so the alarm interrupt lands on the sampler core
+    ESP_ERROR_CHECK(sample_timer_start(SAMPLE_PERIOD_MS * 1000));
+    bool first_sample_logged = false;
+    int64_t stats_logged_us = esp_timer_get_time();
+    while (1)
+    {
+        // Hardware-timed, neither rounded to the tick nor stretched by the processing below
+        sample_timer_wait();
+
+        sample_t samples[SENSOR_ARRAY_MAX_CHANNELS];
+        size_t n = sensor_array_read(samples, SENSOR_ARRAY_MAX_CHANNELS);
+        if (n && !first_sample_logged)
+        {
+            ESP_LOGI(TAG_b, "Boot to first sample: %lld ms", esp_timer_get_time() / 1000);
+            first_sample_logged = true;
+        }
+        publish(samples, n);
+
+#if STATS_LOG_INTERVAL_MS
+        if (esp_timer_get_time() - stats_logged_us >= STATS_LOG_INTERVAL_MS * 1000LL)
+        {
+            sensor_array_log_bus_stats();
+            log_timing();
+            memory_report_check_heap();
+            stats_logged_us = esp_timer_get_time();
+        }
+#endif
+    }
+}
+
+esp_err_t sampler_start(void)
+{
+#if STATIC_ALLOCATION
+    static StaticTask_t s_task_buf;
+    static StackType_t s_task_stack[SAMPLER_TASK_STACK_SIZE];
+    TaskHandle_t task = xTaskCreateStaticPinnedToCore(sampler_task, "sampler", SAMPLER_TASK_STACK_SIZE, NULL, SAMPLER_TASK_PRIORITY,
+                                                      s_task_stack, &s_task_buf, SAMPLER_TASK_CORE);
+    memory_report_add_task(task, s_task_stack, sizeof(s_task_stack));
+#else
+    TaskHandle_t task;
+    if (xTaskCreatePinnedToCore(sampler_task, "sampler", SAMPLER_TASK_STACK_SIZE, NULL, SAMPLER_TASK_PRIORITY,
+                                &task, SAMPLER_TASK_CORE) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    memory_report_add_task(task, NULL, SAMPLER_TASK_STACK_SIZE);
+#endif
+    return ESP_OK;
+}
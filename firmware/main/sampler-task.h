@@ -0,0 +1,17 @@
+#pragma once
+
+#include "esp_err.h"
+
+/*
+ * The sampling loop as its own high-priority task pinned to SAMPLER_TASK_CORE,
+ * away from Wi-Fi and the uploader on core 0. Samples leave through the
+ * lock-free rings of the uploader, so nothing on the network side can make
+ * the sampler wait. The cadence comes from the hardware timer in
+ * sample-timer.h, whose statistics are logged every STATS_LOG_INTERVAL_MS.
+ */
+
+/**
+ * @brief Start the sampler task. Call after sensor_array_init() and http_uploader_start().
+ * @return ESP_OK on success, ESP_ERR_NO_MEM if the task could not be created.
+ */
+esp_err_t sampler_start(void);
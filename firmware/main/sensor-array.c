@@ -0,0 +1,242 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "driver/i2c_master.h"
+#include "i2c_bus.h"
+#include "esp_attr.h"
+#include "esp_bit_defs.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "config.h"
+#include "sensor-array.h"
+#include "sensor-scheduler.h"
+#include "time-sync.h"
+
+/**
+ * @brief One sensor of the array
+ */
+typedef struct
+{
+    uint8_t id; // Channel id, see sensor-array.h
+    sensor_channel_t sched;
+    bh1750_raw_data_t data; // Filled by the I2C bus task, outlives a read that timed out
+    int64_t timestamp_us;   // Start of the conversion
+} sensor_array_channel_t;
+
+static const uint8_t s_addresses[] = {BH1750_I2C_ADDRESS_DEFAULT, BH1750_I2C_ADDRESS_HIGH};
+
+static sensor_array_channel_t s_channels[SENSOR_ARRAY_MAX_CHANNELS];
+static size_t s_channel_count;
+static i2c_master_bus_handle_t s_buses[2];
+static size_t s_bus_count;
+static EventGroupHandle_t s_read_done; // Bit i: read of s_channels[i] completed
+// Auto-ranging position + 1 per channel id, survives deep sleep so the duty-cycled mode converges
+static RTC_DATA_ATTR uint8_t s_rtc_range[SENSOR_ARRAY_MAX_CHANNELS];
+
+/**
+ * @brief I2C Master Initialization
+ */
+static esp_err_t i2c_master_init(i2c_port_num_t port, int sda_io, int scl_io, i2c_master_bus_handle_t *bus_handle)
+{
+    i2c_master_bus_config_t bus_config = {
+        .i2c_port = port,
+        .scl_io_num = scl_io,
+        .sda_io_num = sda_io,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .flags.enable_internal_pullup = true};
+    esp_err_t err = i2c_new_master_bus(&bus_config, bus_handle);
+    if (err == ESP_OK)
+    {
+        // Devices are added through the bus manager, which picks the clock they all support
+        err = i2c_bus_set_max_speed(*bus_handle, I2C_MASTER_FREQ_HZ);
+    }
+    if (err == ESP_OK)
+    {
+        s_buses[s_bus_count++] = *bus_handle;
+    }
+    return err;
+}
+
+/**
+ * @brief Probe both sensor addresses on one bus and add the sensors that answer.
+ */
+static esp_err_t add_bus_sensors(i2c_master_bus_handle_t bus_handle, uint8_t bus_index)
+{
+    for (size_t i = 0; i < sizeof(s_addresses); i++)
+    {
+        if (i2c_bus_probe(bus_handle, s_addresses[i], SENSOR_ARRAY_PROBE_TIMEOUT_MS) != ESP_OK)
+        {
+            continue;
+        }
+        bh1750_handle_t sensor;
+        esp_err_t err = bh1750_create(bus_handle, s_addresses[i], &sensor);
+        if (err == ESP_OK)
+        {
+            err = bh1750_power_on(sensor);
+        }
+        sensor_array_channel_t *ch = &s_channels[s_channel_count];
+        if (err == ESP_OK)
+        {
+            err = sensor_scheduler_init(&ch->sched, sensor, BH1750_MEASUREMENT_MODE);
+        }
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        ch->id = (uint8_t)(bus_index * sizeof(s_addresses) + i);
+        if (s_rtc_range[ch->id])
+        {
+            sensor_scheduler_restore_range(&ch->sched, s_rtc_range[ch->id] - 1);
+        }
+        s_channel_count++;
+        ESP_LOGI(TAG_b, "Channel %u: I2C%u address 0x%02x", ch->id, bus_index, s_addresses[i]);
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Completion of an asynchronous read, runs in the I2C bus task.
+ */
+static void read_done_cb(bh1750_handle_t sensor, esp_err_t result, void *arg)
+{
+    xEventGroupSetBits(s_read_done, BIT((uintptr_t)arg));
+}
+
+esp_err_t sensor_array_init(void)
+{
+#if STATIC_ALLOCATION
+    static StaticEventGroup_t s_read_done_buf;
+    s_read_done = xEventGroupCreateStatic(&s_read_done_buf);
+#else
+    s_read_done = xEventGroupCreate();
+#endif
+    if (s_read_done == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    i2c_master_bus_handle_t bus_handle;
+    esp_err_t err = i2c_master_init(I2C_MASTER_NUM, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO, &bus_handle);
+    if (err == ESP_OK)
+    {
+        err = add_bus_sensors(bus_handle, 0);
+    }
+#if I2C1_MASTER_ENABLE
+    if (err == ESP_OK)
+    {
+        err = i2c_master_init(I2C1_MASTER_NUM, I2C1_MASTER_SDA_IO, I2C1_MASTER_SCL_IO, &bus_handle);
+    }
+    if (err == ESP_OK)
+    {
+        err = add_bus_sensors(bus_handle, 1);
+    }
+#endif
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    ESP_LOGI(TAG_i, "I2C initialized succesfully, %u sensors found", (unsigned)s_channel_count);
+    return s_channel_count ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+size_t sensor_array_count(void)
+{
+    return s_channel_count;
+}
+
+void sensor_array_log_bus_stats(void)
+{
+    for (size_t i = 0; i < s_bus_count; i++)
+    {
+        i2c_bus_stats_t stats;
+        if (i2c_bus_get_stats(s_buses[i], &stats) != ESP_OK || stats.transactions == 0)
+        {
+            continue;
+        }
+        ESP_LOGI(TAG_i, "I2C%u: %u devices at %lu Hz, %lu transactions, %lu errors (%lu timeouts), "
+                        "transfer avg %llu us max %lu us, lock wait avg %llu us max %lu us",
+                 (unsigned)i, stats.devices, (unsigned long)stats.scl_speed_hz, (unsigned long)stats.transactions,
+                 (unsigned long)stats.errors, (unsigned long)stats.timeouts,
+                 stats.xfer_us / stats.transactions, (unsigned long)stats.max_xfer_us,
+                 stats.wait_us / stats.transactions, (unsigned long)stats.max_wait_us);
+    }
+}
+
+size_t sensor_array_read(sample_t *out, size_t max)
+{
+    int64_t start_us[SENSOR_ARRAY_MAX_CHANNELS];
+    int64_t ready_us[SENSOR_ARRAY_MAX_CHANNELS];
+    bool started[SENSOR_ARRAY_MAX_CHANNELS];
+
+    // Kick off every conversion first, they run in parallel inside the sensors.
+    // A sensor whose read from last time is still queued on a hung bus sits this one out
+    for (size_t i = 0; i < s_channel_count; i++)
+    {
+        start_us[i] = esp_timer_get_time();
+        started[i] = (bh1750_async_result(s_channels[i].sched.sensor) != ESP_ERR_INVALID_STATE &&
+                      sensor_scheduler_start(&s_channels[i].sched) == ESP_OK);
+        ready_us[i] = esp_timer_get_time() + sensor_scheduler_conversion_us(&s_channels[i].sched);
+    }
+
+    // Then queue their reads in the order they finish, without waiting for the transfers
+    EventBits_t queued = 0;
+    xEventGroupClearBits(s_read_done, BIT(SENSOR_ARRAY_MAX_CHANNELS) - 1);
+    for (size_t done = 0; done < s_channel_count; done++)
+    {
+        size_t next = s_channel_count;
+        for (size_t i = 0; i < s_channel_count; i++)
+        {
+            if (started[i] && (next == s_channel_count || ready_us[i] < ready_us[next]))
+            {
+                next = i;
+            }
+        }
+        if (next == s_channel_count)
+        {
+            break; // Nothing left that started
+        }
+        started[next] = false;
+
+        sensor_array_channel_t *ch = &s_channels[next];
+        int64_t wait_us = ready_us[next] - esp_timer_get_time();
+        if ((wait_us <= 0 || sensor_scheduler_wait_us((uint32_t)wait_us) == ESP_OK) &&
+            sensor_scheduler_collect(&ch->sched, &ch->data, read_done_cb, (void *)(uintptr_t)next) == ESP_OK)
+        {
+            // Stamped from the us clock at the start of the conversion, not when the bus got to it
+            ch->timestamp_us = time_sync_epoch_us(start_us[next]);
+            queued |= BIT(next);
+        }
+        else
+        {
+            ESP_LOGE(TAG_b, "Channel %u read failed", ch->id);
+        }
+    }
+
+    // Each queued transfer is bounded by the I2C timeout, plus a bus recovery
+    EventBits_t completed = queued ? xEventGroupWaitBits(s_read_done, queued, pdFALSE, pdTRUE,
+                                                         pdMS_TO_TICKS(2 * SENSOR_I2C_TIMEOUT_MS * s_channel_count) + 1)
+                                   : 0;
+    size_t n = 0;
+    for (size_t i = 0; i < s_channel_count; i++)
+    {
+        if (!(queued & BIT(i)))
+        {
+            continue;
+        }
+        sensor_array_channel_t *ch = &s_channels[i];
+        if (!(completed & BIT(i)) || bh1750_async_result(ch->sched.sensor) != ESP_OK || n >= max)
+        {
+            ESP_LOGE(TAG_b, "Channel %u read failed", ch->id);
+            continue;
+        }
+        sensor_scheduler_update_range(&ch->sched, &ch->data);
+        s_rtc_range[ch->id] = (uint8_t)(ch->sched.range_index + 1);
+        out[n++] = (sample_t){
+            .timestamp_us = ch->timestamp_us,
+            .raw = ch->data.raw,
+            .mode = (uint8_t)ch->data.mode,
+            .mtreg = ch->data.mtreg,
+            .channel = ch->id};
+    }
+    return n;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "sample-buffer.h"
+
+/*
+ * All BH1750s attached to this device. Up to two sensors per bus (ADDR low:
+ * 0x23, ADDR high: 0x5C) on I2C_NUM_0 and, with I2C1_MASTER_ENABLE, I2C_NUM_1.
+ *
+ * The channel id of a sensor is fixed by where it is wired, not by probe order:
+ * channel = 2 * bus index + (address == 0x5C). It travels with every sample.
+ *
+ * A read starts the conversions of all sensors back-to-back, then reads each
+ * one as soon as its conversion is done, so N sensors cost about one
+ * conversion time instead of N.
+ *
+ * Reads are queued to the I2C bus task and complete through a callback, so
+ * the sampler never blocks on a single transfer and a hung bus costs
+ * SENSOR_I2C_TIMEOUT_MS plus a bus recovery, not a full driver timeout.
+ *
+ * The buses are shared through the i2c_bus manager, so other drivers can add
+ * devices to them without a second registration of the sensors.
+ */
+
+/**
+ * @brief Create the I2C buses, probe every sensor position and bring up the sensors found.
+ * @return
+ *     - ESP_OK At least one sensor found
+ *     - ESP_ERR_NOT_FOUND No sensor answered
+ *     - Others Error from the I2C driver
+ */
+esp_err_t sensor_array_init(void);
+
+/**
+ * @brief Number of sensors found by sensor_array_init().
+ */
+size_t sensor_array_count(void);
+
+/**
+ * @brief Log the clock and transaction counters of every sensor bus (see i2c_bus.h).
+ */
+void sensor_array_log_bus_stats(void);
+
+/**
+ * @brief Take one sample from every sensor, blocking for about the longest conversion time.
+ * @param out One sample per sensor that was read successfully, with its channel id
+ * @param max Capacity of out, SENSOR_ARRAY_MAX_CHANNELS is always enough
+ * @return Number of samples written to out
+ */
+size_t sensor_array_read(sample_t *out, size_t max);
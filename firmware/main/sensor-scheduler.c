@@ -0,0 +1,189 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "config.h"
+#include "sensor-scheduler.h"
+
+// Most sensitive first. lux = count / 1.2 * 69 / MTreg, halved in H-res mode2
+static const sensor_range_t s_ranges[] = {
+    {BH1750_ONETIME_HALFLX_RES, 254}, // 0.11 lx/count, full scale  7.4 klx, 442 ms
+    {BH1750_ONETIME_HALFLX_RES, 138}, // 0.21 lx/count, full scale 13.6 klx, 240 ms
+    {BH1750_ONETIME_HALFLX_RES, 69},  // 0.42 lx/count, full scale 27.3 klx, 120 ms
+    {BH1750_ONETIME_4LX_RES, 31},     // 1.86 lx/count, full scale  121 klx, 7 ms
+};
+#define SENSOR_RANGE_COUNT (sizeof(s_ranges) / sizeof(s_ranges[0]))
+
+static size_t s_range_first; // Most sensitive range whose conversion fits SENSOR_MAX_CONVERSION_MS
+static esp_timer_handle_t s_ready_timer;
+static TaskHandle_t s_waiting_task;
+
+static void ready_timer_cb(void *arg)
+{
+    xTaskNotifyGive(s_waiting_task);
+}
+
+static uint32_t conversion_us(const sensor_range_t *range)
+{
+    return bh1750_conversion_time_us(range->mode, range->mtreg) * (100 + SENSOR_CONVERSION_MARGIN_PCT) / 100;
+}
+
+/**
+ * @brief Pick the range for the next conversion from the last count.
+ * Move to a less sensitive range once the count reaches SENSOR_RANGE_UP_COUNT, straight to
+ * the least sensitive one on saturation. Move to the most sensitive range in which the same
+ * light would still stay below SENSOR_RANGE_DOWN_COUNT. The gap between both thresholds is
+ * the hysteresis that keeps the controller from toggling at a range boundary.
+ */
+static size_t next_range(size_t index, uint16_t raw)
+{
+    if (raw == UINT16_MAX)
+    {
+        return SENSOR_RANGE_COUNT - 1;
+    }
+    float lux = raw * bh1750_lux_per_count(s_ranges[index].mode, s_ranges[index].mtreg);
+    if (raw >= SENSOR_RANGE_UP_COUNT)
+    {
+        while (index + 1 < SENSOR_RANGE_COUNT && lux / bh1750_lux_per_count(s_ranges[index].mode, s_ranges[index].mtreg) >= SENSOR_RANGE_UP_COUNT)
+        {
+            index++;
+        }
+        return index;
+    }
+    while (index > s_range_first && lux / bh1750_lux_per_count(s_ranges[index - 1].mode, s_ranges[index - 1].mtreg) < SENSOR_RANGE_DOWN_COUNT)
+    {
+        index--;
+    }
+    return index;
+}
+
+esp_err_t sensor_scheduler_init(sensor_channel_t *ch, bh1750_handle_t sensor, bh1750_measure_mode_t mode)
+{
+    if (mode != BH1750_ONETIME_1LX_RES && mode != BH1750_ONETIME_HALFLX_RES && mode != BH1750_ONETIME_4LX_RES)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_ready_timer == NULL)
+    {
+        const esp_timer_create_args_t ready_timer_args = {
+            .callback = ready_timer_cb,
+            .name = "bh1750_ready"};
+        esp_err_t err = esp_timer_create(&ready_timer_args, &s_ready_timer);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        // Skip ranges that are too slow for the sample period
+        while (s_range_first + 1 < SENSOR_RANGE_COUNT && conversion_us(&s_ranges[s_range_first]) > SENSOR_MAX_CONVERSION_MS * 1000)
+        {
+            s_range_first++;
+        }
+    }
+
+    // Short transfer timeout, a hung bus is recovered instead of stalling the sampler
+    bh1750_set_timeout(sensor, SENSOR_I2C_TIMEOUT_MS);
+    *ch = (sensor_channel_t){
+        .sensor = sensor,
+        .range = {.mode = mode, .mtreg = BH1750_MTREG_DEFAULT},
+        .mtreg = 0}; // Unknown, the sensor keeps its MTreg across our resets, so the first start writes it
+#if SENSOR_AUTO_RANGE
+    ch->auto_range = true;
+    // Start in the middle of the ladder, the first reading moves it where it belongs
+    ch->range_index = (s_range_first + SENSOR_RANGE_COUNT - 1) / 2;
+    ch->range = s_ranges[ch->range_index];
+#endif
+    ESP_LOGI(TAG_b, "One-shot mode 0x%02x, MTreg %u, conversion %lu us%s", ch->range.mode, ch->range.mtreg,
+             (unsigned long)sensor_scheduler_conversion_us(ch), ch->auto_range ? ", auto-ranging" : "");
+    return ESP_OK;
+}
+
+void sensor_scheduler_restore_range(sensor_channel_t *ch, size_t range_index)
+{
+    if (ch->auto_range && range_index >= s_range_first && range_index < SENSOR_RANGE_COUNT)
+    {
+        ch->range_index = range_index;
+        ch->range = s_ranges[range_index];
+    }
+}
+
+uint32_t sensor_scheduler_conversion_us(const sensor_channel_t *ch)
+{
+    return conversion_us(&ch->range);
+}
+
+esp_err_t sensor_scheduler_start(sensor_channel_t *ch)
+{
+    if (ch->range.mtreg != ch->mtreg)
+    {
+        esp_err_t err = bh1750_set_measure_time(ch->sensor, ch->range.mtreg);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        ch->mtreg = ch->range.mtreg;
+    }
+    return bh1750_set_measure_mode(ch->sensor, ch->range.mode);
+}
+
+void sensor_scheduler_update_range(sensor_channel_t *ch, const bh1750_raw_data_t *data)
+{
+    if (!ch->auto_range)
+    {
+        return;
+    }
+    size_t index = next_range(ch->range_index, data->raw);
+    if (index != ch->range_index)
+    {
+        ESP_LOGI(TAG_b, "Range %u -> %u (count %u)", (unsigned)ch->range_index, (unsigned)index, data->raw);
+        ch->range_index = index;
+        ch->range = s_ranges[index];
+    }
+}
+
+esp_err_t sensor_scheduler_finish(sensor_channel_t *ch, bh1750_raw_data_t *out)
+{
+    // The sensor is back in power-down once the one-time conversion finished
+    esp_err_t err = bh1750_get_raw_data(ch->sensor, out);
+    if (err == ESP_OK)
+    {
+        sensor_scheduler_update_range(ch, out);
+    }
+    return err;
+}
+
+esp_err_t sensor_scheduler_collect(sensor_channel_t *ch, bh1750_raw_data_t *out, bh1750_done_cb_t cb, void *arg)
+{
+    return bh1750_get_raw_data_async(ch->sensor, out, cb, arg);
+}
+
+esp_err_t sensor_scheduler_wait_us(uint32_t us)
+{
+    if (us == 0)
+    {
+        return ESP_OK;
+    }
+    s_waiting_task = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0); // Clear a stale wake-up from an earlier timeout
+    // esp_timer wakes us with us resolution instead of rounding up to the next tick
+    esp_timer_start_once(s_ready_timer, us);
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(us / 1000) + 2) == 0)
+    {
+        esp_timer_stop(s_ready_timer);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t sensor_scheduler_read(sensor_channel_t *ch, bh1750_raw_data_t *out)
+{
+    esp_err_t err = sensor_scheduler_start(ch);
+    if (err == ESP_OK)
+    {
+        err = sensor_scheduler_wait_us(sensor_scheduler_conversion_us(ch));
+    }
+    if (err == ESP_OK)
+    {
+        err = sensor_scheduler_finish(ch, out);
+    }
+    return err;
+}
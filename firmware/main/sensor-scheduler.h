@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "bh1750.h"
+
+/*
+ * One-shot BH1750 sampling. Every read issues a one-time measurement command
+ * and sleeps on an esp_timer until the conversion time computed from the mode
+ * and MTreg has passed, so the result is always fresh and the sensor sits in
+ * power-down between samples.
+ *
+ * With SENSOR_AUTO_RANGE the mode and MTreg are picked per sample from the
+ * previous count: sensitive, slow ranges in the dark, fast L-resolution in
+ * sunlight. Every reading reports the mode and MTreg it was taken with, so
+ * the counts can be normalized to lux later.
+ *
+ * The state lives in a sensor_channel_t per sensor, so several sensors can
+ * convert at the same time (see sensor-array.h).
+ */
+
+/**
+ * @brief Measurement mode and MTreg of one conversion
+ */
+typedef struct
+{
+    bh1750_measure_mode_t mode;
+    uint8_t mtreg;
+} sensor_range_t;
+
+/**
+ * @brief Scheduling and auto-ranging state of one sensor
+ */
+typedef struct
+{
+    bh1750_handle_t sensor;
+    sensor_range_t range; // Range used for the next conversion
+    size_t range_index;   // Position of range in the auto-ranging ladder
+    uint8_t mtreg;        // MTreg currently written to the sensor, 0 if unknown
+    bool auto_range;
+} sensor_channel_t;
+
+/**
+ * @brief Set up the scheduling state of one sensor.
+ * @param ch Channel state to initialize
+ * @param sensor BH1750 handle, powered on
+ * @param mode One-time measurement mode (BH1750_ONETIME_*), used when auto-ranging is off
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG for a continuous mode, error from esp_timer otherwise.
+ */
+esp_err_t sensor_scheduler_init(sensor_channel_t *ch, bh1750_handle_t sensor, bh1750_measure_mode_t mode);
+
+/**
+ * @brief Continue auto-ranging from a ladder position saved earlier, e.g. across deep sleep.
+ * @param ch Channel
+ * @param range_index A range_index value of this channel, ignored if out of range or auto-ranging is off
+ */
+void sensor_scheduler_restore_range(sensor_channel_t *ch, size_t range_index);
+
+/**
+ * @brief Issue the one-time measurement command, writing MTreg first if the range changed.
+ * @param ch Channel
+ * @return ESP_OK on success, error from the I2C driver otherwise.
+ */
+esp_err_t sensor_scheduler_start(sensor_channel_t *ch);
+
+/**
+ * @brief Read the result of a conversion started with sensor_scheduler_start() and pick the next range.
+ * @param ch Channel
+ * @param out Raw count with the mode and MTreg it was taken with
+ * @return ESP_OK on success, error from the I2C driver otherwise.
+ */
+esp_err_t sensor_scheduler_finish(sensor_channel_t *ch, bh1750_raw_data_t *out);
+
+/**
+ * @brief Queue the read of a conversion started with sensor_scheduler_start() and return right away.
+ * Call sensor_scheduler_update_range() with the result once cb reported success.
+ * @param ch Channel
+ * @param out Raw count with the mode and MTreg it was taken with, must stay valid until cb ran
+ * @param cb Completion callback, called from the I2C bus task
+ * @param arg Passed to cb
+ * @return ESP_OK if submitted, error from the driver otherwise.
+ */
+esp_err_t sensor_scheduler_collect(sensor_channel_t *ch, bh1750_raw_data_t *out, bh1750_done_cb_t cb, void *arg);
+
+/**
+ * @brief Pick the range of the next conversion from a successful reading.
+ * @param ch Channel
+ * @param data Reading of the last conversion
+ */
+void sensor_scheduler_update_range(sensor_channel_t *ch, const bh1750_raw_data_t *data);
+
+/**
+ * @brief Start one conversion, block the calling task until it is done and read the result.
+ * @param ch Channel
+ * @param out Raw count with the mode and MTreg it was taken with
+ * @return ESP_OK on success, ESP_ERR_TIMEOUT if the timer did not fire, error from the I2C driver otherwise.
+ */
+esp_err_t sensor_scheduler_read(sensor_channel_t *ch, bh1750_raw_data_t *out);
+
+/**
+ * @brief Block the calling task for us microseconds on an esp_timer, not rounded to the tick.
+ * @param us Time to wait
+ * @return ESP_OK, or ESP_ERR_TIMEOUT if the timer did not fire.
+ */
+esp_err_t sensor_scheduler_wait_us(uint32_t us);
+
+/**
+ * @brief Time the next conversion of ch takes, including SENSOR_CONVERSION_MARGIN_PCT.
+ * @param ch Channel
+ * @return Wait time in us
+ */
+uint32_t sensor_scheduler_conversion_us(const sensor_channel_t *ch);
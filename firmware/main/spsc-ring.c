@@ -0,0 +1,53 @@
+#include <string.h>
+#include "spsc-ring.h"
+
+bool spsc_ring_init(spsc_ring_t *ring, void *storage, size_t elem_size, size_t capacity)
+{
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    {
+        return false;
+    }
+    ring->storage = storage;
+    ring->elem_size = elem_size;
+    ring->mask = capacity - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    return true;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, const void *elem)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    // Acquire pairs with the consumer's release, the slot is really free once tail moved past it
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask)
+    {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    memcpy(ring->storage + (head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+    // Release publishes the record before the consumer can see the new head
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *ring, void *elem)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail)
+    {
+        return false;
+    }
+    memcpy(elem, ring->storage + (tail & ring->mask) * ring->elem_size, ring->elem_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+size_t spsc_ring_count(spsc_ring_t *ring)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return head - tail;
+}
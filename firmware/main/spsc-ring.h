@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Lock-free single-producer / single-consumer ring of fixed-size records.
+ * Exactly one task may push and exactly one other task may pop, they may run
+ * on different cores. Neither side ever blocks or takes a lock, so a stalled
+ * consumer can only make the producer drop records, never delay it.
+ *
+ * head is written by the producer only and tail by the consumer only, both
+ * run freely and are masked on access, so capacity must be a power of two.
+ */
+
+typedef struct
+{
+    uint8_t *storage;       // capacity * elem_size bytes
+    size_t elem_size;
+    size_t mask;            // capacity - 1
+    atomic_size_t head;     // Next slot to write, producer side
+    atomic_size_t tail;     // Next slot to read, consumer side
+    atomic_uint_least32_t dropped; // Pushes rejected because the ring was full
+} spsc_ring_t;
+
+/**
+ * @brief Set up an empty ring over caller-provided storage.
+ * @param ring The ring
+ * @param storage capacity * elem_size bytes, must outlive the ring
+ * @param elem_size Size of one record
+ * @param capacity Number of records, a power of two
+ * @return true on success, false if capacity is not a power of two.
+ */
+bool spsc_ring_init(spsc_ring_t *ring, void *storage, size_t elem_size, size_t capacity);
+
+/**
+ * @brief Copy one record in, producer side.
+ * @param ring The ring
+ * @param elem The record
+ * @return true  If the record was stored.
+ * @return false If the ring is full, the record is dropped and counted.
+ */
+bool spsc_ring_push(spsc_ring_t *ring, const void *elem);
+
+/**
+ * @brief Copy the oldest record out, consumer side.
+ * @param ring The ring
+ * @param elem Destination
+ * @return true If a record was returned, false if the ring is empty.
+ */
+bool spsc_ring_pop(spsc_ring_t *ring, void *elem);
+
+/**
+ * @brief Number of records currently stored, exact on either side, a snapshot elsewhere.
+ */
+size_t spsc_ring_count(spsc_ring_t *ring);
@@ -0,0 +1,250 @@
+#include "telemetry-frame.h"
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put_u64(uint8_t *p, uint64_t v)
+{
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+/**
+ * @brief Append v as an LEB128 varint at buf[*pos].
+ * @return false if it does not fit.
+ */
+static bool put_varint(uint8_t *buf, size_t len, size_t *pos, uint32_t v)
+{
+    do
+    {
+        if (*pos >= len)
+        {
+            return false;
+        }
+        uint8_t byte = v & 0x7F;
+        v >>= 7;
+        buf[(*pos)++] = v ? (byte | 0x80) : byte;
+    } while (v);
+    return true;
+}
+
+static bool same_range(const sample_t *a, const sample_t *b)
+{
+    return a->mode == b->mode && a->mtreg == b->mtreg;
+}
+
+/**
+ * @brief Mean spacing of the count samples of a run from samples[first] to samples[last], rounded to us.
+ */
+static uint32_t run_period(const sample_t *samples, size_t first, size_t last, size_t count)
+{
+    int64_t span_us = samples[last].timestamp_us - samples[first].timestamp_us;
+    if (count < 2 || span_us <= 0)
+    {
+        return 0;
+    }
+    return (uint32_t)((span_us + (int64_t)(count - 1) / 2) / (int64_t)(count - 1));
+}
+
+/**
+ * @brief Check that a version 2 frame places every sample of a run close enough.
+ * Sample k of the run is rebuilt at base + k * period, it is in place when that
+ * is within TELEMETRY_FRAME_JITTER_PCT of the period from its timestamp. The
+ * distance is checked per sample, not per gap, so a slow drift of the spacing
+ * is caught as well.
+ */
+static bool run_in_place(const sample_t *samples, size_t first, size_t last, uint32_t period_us)
+{
+    int64_t base_us = samples[first].timestamp_us;
+    size_t k = 0;
+    for (size_t i = first + 1; i <= last; i++)
+    {
+        if (samples[i].channel != samples[first].channel)
+        {
+            continue;
+        }
+        k++;
+        int64_t error_us = samples[i].timestamp_us - (base_us + (int64_t)k * period_us);
+        if ((error_us < 0 ? -error_us : error_us) * 100 > (int64_t)period_us * TELEMETRY_FRAME_JITTER_PCT)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Encode the run of samples that starts at samples[first] into one frame.
+ * The run holds the following samples of the same channel up to the first one taken
+ * with another range, samples of other channels in between are skipped.
+ * A gap too long for a 32-bit time delta ends the run.
+ * It goes into a version 2 frame if every sample lies within TELEMETRY_FRAME_JITTER_PCT
+ * of the period from where the frame places it (see run_in_place()). Otherwise its
+ * in-place start, if it has at least TELEMETRY_FRAME_MIN_REGULAR samples, goes
+ * into a version 2 frame and the next run starts after it. Shorter starts, e.g.
+ * from report-by-exception, put the whole run into a version 3 frame with
+ * per-sample time deltas.
+ * @param next Index of the sample that starts the next run of this channel, n if none
+ */
+static esp_err_t encode_run(uint32_t device_id, const sample_t *samples, size_t n, size_t first,
+                            uint8_t *buf, size_t len, size_t *pos, size_t *next)
+{
+    const sample_t *head = &samples[first];
+    size_t count = 1, last = first;
+    *next = n;
+    for (size_t i = first + 1; i < n; i++)
+    {
+        if (samples[i].channel != head->channel)
+        {
+            continue;
+        }
+        if (!same_range(&samples[i], head) || samples[i].timestamp_us - samples[last].timestamp_us > UINT32_MAX)
+        {
+            *next = i;
+            break;
+        }
+        count++;
+        last = i;
+    }
+
+    uint32_t period_us = run_period(samples, first, last, count);
+    bool regular = run_in_place(samples, first, last, period_us);
+    if (!regular)
+    {
+        // Longest start of the run that is in place for its own mean period
+        size_t in_place = 1, in_place_last = first;
+        for (size_t i = first + 1; i <= last; i++)
+        {
+            if (samples[i].channel != head->channel)
+            {
+                continue;
+            }
+            uint32_t start_period_us = run_period(samples, first, i, in_place + 1);
+            if (!run_in_place(samples, first, i, start_period_us))
+            {
+                break;
+            }
+            in_place++;
+            in_place_last = i;
+            period_us = start_period_us;
+        }
+        if (in_place >= TELEMETRY_FRAME_MIN_REGULAR)
+        {
+            // The next run starts at the first sample out of place
+            regular = true;
+            count = in_place;
+            last = in_place_last;
+            *next = last + 1;
+            while (samples[*next].channel != head->channel)
+            {
+                (*next)++;
+            }
+        }
+    }
+    int64_t base_us = head->timestamp_us;
+    int64_t prev_us;
+
+    if (len - *pos < TELEMETRY_FRAME_HEADER_LEN)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    uint8_t *frame = buf + *pos;
+    frame[0] = TELEMETRY_FRAME_MAGIC;
+    frame[1] = regular ? TELEMETRY_FRAME_VERSION : TELEMETRY_FRAME_VERSION_TIMED;
+    put_u16(frame + 2, (uint16_t)count);
+    put_u32(frame + 4, device_id);
+    put_u64(frame + 8, (uint64_t)base_us);
+    put_u32(frame + 16, regular ? period_us : 0);
+    frame[20] = head->mode;
+    frame[21] = head->mtreg;
+    frame[22] = head->channel;
+    frame[23] = TELEMETRY_FRAME_FLAG_US;
+    put_u16(frame + 24, head->raw);
+
+    size_t p = *pos + TELEMETRY_FRAME_HEADER_LEN;
+    uint16_t prev = head->raw;
+    prev_us = base_us;
+    for (size_t i = first + 1; i <= last; i++)
+    {
+        if (samples[i].channel != head->channel)
+        {
+            continue;
+        }
+        int32_t delta = (int32_t)samples[i].raw - (int32_t)prev;
+        prev = samples[i].raw;
+        // Zigzag maps small negative and positive deltas to small unsigned values
+        uint32_t zz = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        if (!put_varint(buf, len, &p, zz))
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (!regular)
+        {
+            int64_t dt_us = samples[i].timestamp_us - prev_us;
+            prev_us = samples[i].timestamp_us;
+            if (!put_varint(buf, len, &p, dt_us > 0 ? (uint32_t)dt_us : 0))
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+        }
+    }
+    *pos = p;
+    return ESP_OK;
+}
+
+/**
+ * @brief Encode all n samples, one frame per channel and range run, channels in order of first appearance.
+ */
+static esp_err_t encode_all(uint32_t device_id, const sample_t *samples, size_t n, uint8_t *buf, size_t len, size_t *out_len)
+{
+    uint32_t seen[256 / 32] = {0};
+    size_t pos = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        uint8_t channel = samples[i].channel;
+        if (seen[channel / 32] & (1u << (channel % 32)))
+        {
+            continue;
+        }
+        seen[channel / 32] |= 1u << (channel % 32);
+        for (size_t first = i; first < n;)
+        {
+            esp_err_t err = encode_run(device_id, samples, n, first, buf, len, &pos, &first);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+        }
+    }
+    *out_len = pos;
+    return ESP_OK;
+}
+
+esp_err_t telemetry_frame_encode(uint32_t device_id, const sample_t *samples, size_t n,
+                                 uint8_t *buf, size_t len, size_t *out_len, size_t *out_count)
+{
+    if (n == 0 || n > UINT16_MAX)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Halve the batch until it fits, the remainder goes out with the next request
+    for (size_t m = n; m > 0; m /= 2)
+    {
+        esp_err_t err = encode_all(device_id, samples, m, buf, len, out_len);
+        if (err != ESP_ERR_INVALID_SIZE)
+        {
+            *out_count = m;
+            return err;
+        }
+    }
+    return ESP_ERR_INVALID_SIZE;
+}
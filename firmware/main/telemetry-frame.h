@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample-buffer.h"
+
+/*
+ * Binary telemetry frame, all fields little-endian:
+ *
+ *  offset size field
+ *  0      1    magic, TELEMETRY_FRAME_MAGIC
+ *  1      1    version, TELEMETRY_FRAME_VERSION
+ *  2      2    sample count n (>= 1)
+ *  4      4    device id, low 4 bytes of the Wi-Fi MAC, stored with every sample
+ *  8      8    base timestamp, Unix epoch time of the first sample
+ *  16     4    sample period, sample i was taken at base + i * period
+ *  20     1    BH1750 measurement mode (bh1750_measure_mode_t)
+ *  21     1    BH1750 MTreg
+ *  22     1    sensor channel id (version 2 only, see sensor-array.h)
+ *  23     1    flags (version 2 only), older firmware writes 0
+ *              bit 0 TELEMETRY_FRAME_FLAG_US: all times are in us, otherwise in ms
+ *  24     2    raw count of the first sample (offset 22 in version 1)
+ *  26     ...  n - 1 deltas between consecutive raw counts, zigzag + LEB128 varint
+ *
+ * Version 3 (TELEMETRY_FRAME_VERSION_TIMED) has the version 2 header with
+ * period 0, and every count delta is followed by the time since the previous
+ * sample as an LEB128 varint. It is used for runs whose samples are not
+ * evenly spaced, e.g. with report-by-exception.
+ *
+ * A request body holds one or more frames back to back, one per run of
+ * samples from the same channel taken with the same range.
+ *
+ * Example, device 0x11223344, base 1727000000000000 us, period 500000 us, mode 0x10,
+ * MTreg 69, channel 1, counts 100, 101, 99:
+ *  B1 02 03 00 44 33 22 11 00 F0 86 85 B2 22 06 00 20 A1 07 00 10 45 01 01 64 00 02 03
+ */
+
+#define TELEMETRY_FRAME_MAGIC 0xB1
+#define TELEMETRY_FRAME_VERSION 2
+#define TELEMETRY_FRAME_VERSION_TIMED 3
+#define TELEMETRY_FRAME_FLAG_US 0x01
+#define TELEMETRY_FRAME_JITTER_PCT 25 // Timestamp error, in % of the period, up to which a sample counts as evenly spaced
+#define TELEMETRY_FRAME_MIN_REGULAR 8 // Evenly spaced samples worth a frame of their own when the rest of a run is not
+#define TELEMETRY_FRAME_HEADER_LEN 26
+#define TELEMETRY_FRAME_CONTENT_TYPE "application/vnd.lightsense.frame"
+
+/**
+ * @brief Worst-case size of a single frame for n samples (every count delta takes 3 varint bytes,
+ * every time delta of a version 3 frame 5).
+ */
+#define TELEMETRY_FRAME_MAX_LEN(n) (TELEMETRY_FRAME_HEADER_LEN + 8 * ((n) - 1))
+
+/**
+ * @brief Encode a batch of samples into frames, one per channel and range run.
+ * The period of each frame is the mean spacing of its samples and every sample is
+ * rebuilt within TELEMETRY_FRAME_JITTER_PCT of it on the receiving side, a run
+ * whose spacing drifts further is split. Unevenly spaced runs carry their time
+ * deltas instead (version 3). If the whole batch
+ * does not fit into buf, a leading part of it is encoded.
+ * @param device_id Id of this device
+ * @param samples The samples to encode, oldest first, channels may be interleaved
+ * @param n Number of samples, 1..65535
+ * @param buf Destination buffer
+ * @param len Size of buf
+ * @param out_len Number of bytes written
+ * @param out_count Number of leading samples encoded, the rest goes into the next request
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_ARG n is 0 or too large
+ *     - ESP_ERR_INVALID_SIZE buf is too small for even one sample
+ */
+esp_err_t telemetry_frame_encode(uint32_t device_id, const sample_t *samples, size_t n,
+                                 uint8_t *buf, size_t len, size_t *out_len, size_t *out_count);
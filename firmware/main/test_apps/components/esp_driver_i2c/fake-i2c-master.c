@@ -0,0 +1,198 @@
+/**
+ * @file
+ * @brief I2C master driver for the linux target, see fake-i2c.h
+ */
+
+#include "freertos/FreeRTOS.h"
+#include "driver/i2c_master.h"
+#include "fake-i2c.h"
+
+#define FAKE_I2C_MTREG_DEFAULT 69
+
+typedef struct {
+    i2c_port_num_t port;
+    uint16_t addr;
+    bool attached;  /*!< Answers on the bus*/
+    float lux;
+    uint8_t mode;   /*!< Last measurement mode command, 0 before the first*/
+    uint8_t mtreg;
+    uint8_t mtreg_hi; /*!< Upper 3 bits from the 0x40 command, applied with the 0x60 one*/
+    uint32_t reads;
+} fake_bh1750_t;
+
+struct i2c_master_bus_t {
+    i2c_port_num_t port;
+    bool used;
+};
+
+struct i2c_master_dev_t {
+    struct i2c_master_bus_t *bus;
+    uint16_t addr;
+    bool used;
+};
+
+static struct i2c_master_bus_t s_buses[I2C_NUM_MAX];
+static struct i2c_master_dev_t s_devs[FAKE_I2C_MAX_DEVICES];
+static fake_bh1750_t s_sensors[FAKE_I2C_MAX_DEVICES];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief Find the sensor at an address, optionally taking a free slot for it. Call with s_lock held.
+ */
+static fake_bh1750_t *find_sensor(i2c_port_num_t port, uint16_t addr, bool create)
+{
+    fake_bh1750_t *free_slot = NULL;
+    for (size_t i = 0; i < FAKE_I2C_MAX_DEVICES; i++) {
+        if (s_sensors[i].attached && s_sensors[i].port == port && s_sensors[i].addr == addr) {
+            return &s_sensors[i];
+        }
+        if (!s_sensors[i].attached && !free_slot) {
+            free_slot = &s_sensors[i];
+        }
+    }
+    if (!create || !free_slot) {
+        return NULL;
+    }
+    *free_slot = (fake_bh1750_t) {
+        .port = port,
+        .addr = addr,
+        .attached = true,
+        .mtreg = FAKE_I2C_MTREG_DEFAULT,
+    };
+    return free_slot;
+}
+
+/**
+ * @brief Count a sensor reports for its illuminance, lux = count / 1.2 * 69 / MTreg, halved in H-res mode2
+ */
+static uint16_t sensor_count(const fake_bh1750_t *sens)
+{
+    float count = sens->lux * 1.2f * sens->mtreg / FAKE_I2C_MTREG_DEFAULT;
+    if (sens->mode == 0x11 || sens->mode == 0x21) {
+        count *= 2;
+    }
+    if (count <= 0) {
+        return 0;
+    }
+    return (count >= UINT16_MAX) ? UINT16_MAX : (uint16_t) count;
+}
+
+void fake_i2c_bh1750_set_lux(i2c_port_num_t port, uint16_t address, float lux)
+{
+    portENTER_CRITICAL(&s_lock);
+    fake_bh1750_t *sens = find_sensor(port, address, true);
+    if (sens) {
+        sens->lux = lux;
+    }
+    portEXIT_CRITICAL(&s_lock);
+}
+
+uint32_t fake_i2c_bh1750_reads(i2c_port_num_t port, uint16_t address)
+{
+    portENTER_CRITICAL(&s_lock);
+    fake_bh1750_t *sens = find_sensor(port, address, false);
+    uint32_t reads = sens ? sens->reads : 0;
+    portEXIT_CRITICAL(&s_lock);
+    return reads;
+}
+
+esp_err_t i2c_new_master_bus(const i2c_master_bus_config_t *bus_config, i2c_master_bus_handle_t *ret_bus_handle)
+{
+    if (bus_config->i2c_port < 0 || bus_config->i2c_port >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct i2c_master_bus_t *bus = &s_buses[bus_config->i2c_port];
+    if (bus->used) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    bus->port = bus_config->i2c_port;
+    bus->used = true;
+    *ret_bus_handle = bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_del_master_bus(i2c_master_bus_handle_t bus_handle)
+{
+    bus_handle->used = false;
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_bus_add_device(i2c_master_bus_handle_t bus_handle, const i2c_device_config_t *dev_config, i2c_master_dev_handle_t *ret_handle)
+{
+    esp_err_t ret = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_lock);
+    for (size_t i = 0; i < FAKE_I2C_MAX_DEVICES; i++) {
+        if (!s_devs[i].used) {
+            s_devs[i] = (struct i2c_master_dev_t) {
+                .bus = bus_handle,
+                .addr = dev_config->device_address,
+                .used = true,
+            };
+            *ret_handle = &s_devs[i];
+            ret = ESP_OK;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+esp_err_t i2c_master_bus_rm_device(i2c_master_dev_handle_t handle)
+{
+    portENTER_CRITICAL(&s_lock);
+    handle->used = false;
+    portEXIT_CRITICAL(&s_lock);
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_transmit(i2c_master_dev_handle_t i2c_dev, const uint8_t *write_buffer, size_t write_size, int xfer_timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_lock);
+    fake_bh1750_t *sens = find_sensor(i2c_dev->bus->port, i2c_dev->addr, false);
+    if (!sens) {
+        ret = ESP_ERR_INVALID_STATE; // NACK
+    }
+    for (size_t i = 0; sens && i < write_size; i++) {
+        uint8_t cmd = write_buffer[i];
+        if ((cmd & 0xF8) == 0x40) {
+            sens->mtreg_hi = cmd & 0x07;
+        } else if ((cmd & 0xE0) == 0x60) {
+            sens->mtreg = (uint8_t)(sens->mtreg_hi << 5 | (cmd & 0x1F));
+        } else if (cmd >= 0x10) {
+            sens->mode = cmd;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+esp_err_t i2c_master_receive(i2c_master_dev_handle_t i2c_dev, uint8_t *read_buffer, size_t read_size, int xfer_timeout_ms)
+{
+    esp_err_t ret = ESP_OK;
+    portENTER_CRITICAL(&s_lock);
+    fake_bh1750_t *sens = find_sensor(i2c_dev->bus->port, i2c_dev->addr, false);
+    if (!sens || read_size != 2) {
+        ret = sens ? ESP_ERR_INVALID_SIZE : ESP_ERR_INVALID_STATE;
+    } else {
+        uint16_t count = sensor_count(sens);
+        read_buffer[0] = (uint8_t)(count >> 8);
+        read_buffer[1] = (uint8_t) count;
+        sens->reads++;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ret;
+}
+
+esp_err_t i2c_master_probe(i2c_master_bus_handle_t bus_handle, uint16_t address, int xfer_timeout_ms)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool found = find_sensor(bus_handle->port, address, false) != NULL;
+    portEXIT_CRITICAL(&s_lock);
+    return found ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t i2c_master_bus_reset(i2c_master_bus_handle_t bus_handle)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,28 @@
+/**
+ * @file
+ * @brief Types of the I2C master driver, the subset the firmware uses, for the linux target
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef int i2c_port_num_t;
+
+typedef enum {
+    I2C_NUM_0,
+    I2C_NUM_1,
+    I2C_NUM_MAX,
+} i2c_port_t;
+
+typedef enum {
+    I2C_CLK_SRC_DEFAULT,
+} i2c_clock_source_t;
+
+typedef enum {
+    I2C_ADDR_BIT_LEN_7,
+    I2C_ADDR_BIT_LEN_10,
+} i2c_addr_bit_len_t;
+
+typedef struct i2c_master_bus_t *i2c_master_bus_handle_t;
+typedef struct i2c_master_dev_t *i2c_master_dev_handle_t;
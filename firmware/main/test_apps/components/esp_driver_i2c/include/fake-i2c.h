@@ -0,0 +1,29 @@
+/**
+ * @file
+ * @brief Simulated BH1750s behind the linux I2C master driver
+ *
+ * A sensor answers probes at its address once attached and speaks the BH1750
+ * command set: power on/down, reset, the six measurement modes and the two
+ * MTreg bytes. A read returns the count the set illuminance gives in the
+ * current mode and MTreg, saturated at 0xFFFF. Conversion time is not
+ * simulated, a read right after the mode command already returns the count.
+ */
+#pragma once
+
+#include <stdint.h>
+#include "driver/i2c_types.h"
+
+#define FAKE_I2C_MAX_DEVICES 8
+
+/**
+ * @brief Attach a sensor, or update the illuminance of an attached one
+ * @param port I2C port of the bus the sensor is wired to
+ * @param address 7-bit address, 0x23 or 0x5C
+ * @param lux Illuminance the sensor sees
+ */
+void fake_i2c_bh1750_set_lux(i2c_port_num_t port, uint16_t address, float lux);
+
+/**
+ * @brief Number of 2-byte reads the sensor answered
+ */
+uint32_t fake_i2c_bh1750_reads(i2c_port_num_t port, uint16_t address);
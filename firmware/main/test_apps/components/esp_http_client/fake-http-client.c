@@ -0,0 +1,157 @@
+/**
+ * @file
+ * @brief HTTP client for the linux target, see fake-http-client.h
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_http_client.h"
+#include "fake-http-client.h"
+
+struct esp_http_client {
+    esp_http_client_config_t config;
+    char content_type[48];
+    const char *post_data;
+    int post_len;
+    int status;
+};
+
+static fake_http_request_t s_requests[FAKE_HTTP_MAX_REQUESTS];
+static size_t s_request_count;
+static int s_status = 200;
+static char s_retry_after[16];
+static bool s_once;         /*!< s_status only answers the next request*/
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void fake_http_set_response(int status, const char *retry_after)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_status = status;
+    snprintf(s_retry_after, sizeof(s_retry_after), "%s", retry_after ? retry_after : "");
+    s_once = false;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+void fake_http_set_next_response(int status)
+{
+    portENTER_CRITICAL(&s_lock);
+    s_status = status;
+    s_retry_after[0] = '\0';
+    s_once = true;
+    portEXIT_CRITICAL(&s_lock);
+}
+
+size_t fake_http_request_count(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    size_t count = s_request_count;
+    portEXIT_CRITICAL(&s_lock);
+    return count;
+}
+
+const fake_http_request_t *fake_http_request(size_t index)
+{
+    return (index < fake_http_request_count()) ? &s_requests[index] : NULL;
+}
+
+void fake_http_reset(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    size_t count = s_request_count;
+    s_request_count = 0;
+    s_status = 200;
+    s_retry_after[0] = '\0';
+    s_once = false;
+    portEXIT_CRITICAL(&s_lock);
+    for (size_t i = 0; i < count; i++) {
+        free(s_requests[i].body);
+    }
+}
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    esp_http_client_handle_t client = calloc(1, sizeof(*client));
+    if (client) {
+        client->config = *config;
+    }
+    return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    if (strcasecmp(key, "Content-Type") == 0) {
+        snprintf(client->content_type, sizeof(client->content_type), "%s", value);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len)
+{
+    client->post_data = data;
+    client->post_len = len;
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    fake_http_request_t request = {.len = (size_t) client->post_len};
+    snprintf(request.content_type, sizeof(request.content_type), "%s", client->content_type);
+    request.body = malloc(request.len ? request.len : 1);
+    if (!request.body) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(request.body, client->post_data, request.len);
+
+    char retry_after[sizeof(s_retry_after)];
+    portENTER_CRITICAL(&s_lock);
+    request.status = s_status;
+    snprintf(retry_after, sizeof(retry_after), "%s", s_retry_after);
+    bool recorded = s_request_count < FAKE_HTTP_MAX_REQUESTS;
+    if (recorded) {
+        s_requests[s_request_count++] = request;
+    }
+    if (s_once) {
+        s_status = 200;
+        s_once = false;
+    }
+    portEXIT_CRITICAL(&s_lock);
+    if (!recorded) {
+        free(request.body);
+    }
+
+    client->status = request.status;
+    if (request.status == 0) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    if (retry_after[0] && client->config.event_handler) {
+        char key[] = "Retry-After";
+        esp_http_client_event_t evt = {
+            .event_id = HTTP_EVENT_ON_HEADER,
+            .client = client,
+            .user_data = client->config.user_data,
+            .header_key = key,
+            .header_value = retry_after,
+        };
+        client->config.event_handler(&evt);
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+esp_err_t esp_http_client_close(esp_http_client_handle_t client)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    free(client);
+    return ESP_OK;
+}
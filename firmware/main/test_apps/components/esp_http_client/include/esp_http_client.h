@@ -0,0 +1,59 @@
+/**
+ * @file
+ * @brief HTTP client API for the linux target, the subset the firmware uses.
+ * Requests never leave the process, they are answered by the local server of fake-http-client.h.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define ESP_ERR_HTTP_BASE       (0x7000)
+#define ESP_ERR_HTTP_CONNECT    (ESP_ERR_HTTP_BASE + 3)
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+} esp_http_client_method_t;
+
+typedef enum {
+    HTTP_EVENT_ERROR = 0,
+    HTTP_EVENT_ON_CONNECTED,
+    HTTP_EVENT_HEADERS_SENT,
+    HTTP_EVENT_ON_HEADER,
+    HTTP_EVENT_ON_DATA,
+    HTTP_EVENT_ON_FINISH,
+    HTTP_EVENT_DISCONNECTED,
+} esp_http_client_event_id_t;
+
+typedef struct esp_http_client_event {
+    esp_http_client_event_id_t event_id;
+    esp_http_client_handle_t client;
+    void *data;
+    int data_len;
+    void *user_data;
+    char *header_key;
+    char *header_value;
+} esp_http_client_event_t;
+
+typedef esp_err_t (*http_event_handle_cb)(esp_http_client_event_t *evt);
+
+typedef struct {
+    const char *url;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    bool keep_alive_enable;
+    http_event_handle_cb event_handler;
+    void *user_data;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len);
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+esp_err_t esp_http_client_close(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
@@ -0,0 +1,53 @@
+/**
+ * @file
+ * @brief Local stand-in for the upload server behind the linux HTTP client
+ *
+ * Every esp_http_client_perform() is recorded with its Content-Type and body
+ * and answered with the scripted response, 200 until told otherwise.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FAKE_HTTP_MAX_REQUESTS 256
+
+/**
+ * @brief One recorded request
+ */
+typedef struct {
+    char content_type[48];
+    uint8_t *body;
+    size_t len;
+    int status;     /*!< Status it was answered with, 0 for a transport error*/
+} fake_http_request_t;
+
+/**
+ * @brief Script the answer to the following requests
+ * @param status HTTP status, 0 to fail them with ESP_ERR_HTTP_CONNECT
+ * @param retry_after Retry-After header value, NULL for none
+ */
+void fake_http_set_response(int status, const char *retry_after);
+
+/**
+ * @brief Answer only the next request with status, the ones after it with 200 again
+ * @param status HTTP status, 0 to fail it with ESP_ERR_HTTP_CONNECT
+ */
+void fake_http_set_next_response(int status);
+
+/**
+ * @brief Number of requests recorded since the last fake_http_reset()
+ */
+size_t fake_http_request_count(void);
+
+/**
+ * @brief A recorded request, valid until the next fake_http_reset()
+ * @param index 0 for the oldest
+ * @return NULL if there is no such request
+ */
+const fake_http_request_t *fake_http_request(size_t index);
+
+/**
+ * @brief Forget the recorded requests and answer 200 again
+ */
+void fake_http_reset(void);
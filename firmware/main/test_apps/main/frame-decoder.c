@@ -0,0 +1,120 @@
+#include <string.h>
+#include "telemetry-frame.h"
+#include "frame-decoder.h"
+
+#define FRAME_VERSION_V1 1
+#define FRAME_HEADER_V1_LEN 24 // No channel and flags, the first count at offset 22
+
+static uint32_t get_le(const uint8_t *p, size_t n)
+{
+    uint32_t value = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        value |= (uint32_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * @brief Read an LEB128 varint of at most 32 bits.
+ * @return false if it runs past end
+ */
+static bool get_varint(const uint8_t **p, const uint8_t *end, uint32_t *value)
+{
+    *value = 0;
+    for (unsigned shift = 0; shift < 35; shift += 7)
+    {
+        if (*p >= end)
+        {
+            return false;
+        }
+        uint8_t byte = *(*p)++;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t frame_decoder_decode(const uint8_t *body, size_t len, uint32_t *device_id, sample_t *out, size_t max, size_t *count)
+{
+    const uint8_t *p = body;
+    const uint8_t *end = body + len;
+    *count = 0;
+    if (len == 0)
+    {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    while (p < end)
+    {
+        if (end - p < 2 || p[0] != TELEMETRY_FRAME_MAGIC ||
+            (p[1] != FRAME_VERSION_V1 && p[1] != TELEMETRY_FRAME_VERSION && p[1] != TELEMETRY_FRAME_VERSION_TIMED))
+        {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        bool v1 = (p[1] == FRAME_VERSION_V1);
+        size_t header_len = v1 ? FRAME_HEADER_V1_LEN : TELEMETRY_FRAME_HEADER_LEN;
+        if ((size_t)(end - p) < header_len)
+        {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        bool timed = (p[1] == TELEMETRY_FRAME_VERSION_TIMED);
+        uint16_t n = (uint16_t)get_le(p + 2, 2);
+        uint32_t frame_device = get_le(p + 4, 4);
+        int64_t ts = (int64_t)((uint64_t)get_le(p + 12, 4) << 32 | get_le(p + 8, 4));
+        uint32_t period = get_le(p + 16, 4);
+        uint8_t mode = p[20], mtreg = p[21];
+        uint8_t channel = v1 ? 0 : p[22], flags = v1 ? 0 : p[23];
+        int32_t raw = (int32_t)get_le(p + header_len - 2, 2);
+        int64_t unit_us = (flags & TELEMETRY_FRAME_FLAG_US) ? 1 : 1000;
+        if (n == 0 || mtreg == 0 || (p != body && frame_device != *device_id))
+        {
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        *device_id = frame_device;
+        p += header_len;
+
+        int64_t base = ts;
+        for (uint16_t i = 0; i < n; i++)
+        {
+            if (i > 0)
+            {
+                uint32_t zz, dt;
+                if (!get_varint(&p, end, &zz))
+                {
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                raw += (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+                if (raw < 0 || raw > UINT16_MAX)
+                {
+                    return ESP_ERR_INVALID_RESPONSE;
+                }
+                if (timed)
+                {
+                    if (!get_varint(&p, end, &dt))
+                    {
+                        return ESP_ERR_INVALID_RESPONSE;
+                    }
+                    ts += dt;
+                }
+                else
+                {
+                    ts = base + (int64_t)i * period;
+                }
+            }
+            if (*count == max)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            out[(*count)++] = (sample_t){
+                .timestamp_us = ts * unit_us,
+                .raw = (uint16_t)raw,
+                .mode = mode,
+                .mtreg = mtreg,
+                .channel = channel};
+        }
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "sample-buffer.h"
+
+/**
+ * @brief Decode a request body of back-to-back telemetry frames, the receiving side of telemetry_frame_encode().
+ * Mirrors decode_frames() in server/telemetry_frame.py, versions 1 to 3.
+ * @param body The request body
+ * @param len Length of body
+ * @param device_id Device id of the frames, they all carry the same one
+ * @param out Decoded samples in frame order
+ * @param max Capacity of out
+ * @param count Number of samples written to out
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_ERR_INVALID_RESPONSE The body is malformed
+ *     - ESP_ERR_INVALID_SIZE It holds more than max samples
+ */
+esp_err_t frame_decoder_decode(const uint8_t *body, size_t len, uint32_t *device_id, sample_t *out, size_t max, size_t *count);
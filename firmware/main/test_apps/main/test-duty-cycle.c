@@ -0,0 +1,107 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "unity.h"
+#include "config.h"
+#include "duty-cycle-trace.h"
+
+#define READ_US 5000         // Fake time of one wake-up's sensor reads
+#define UPLOAD_US 2000000    // Fake time with the radio on per upload
+
+/**
+ * @brief Fake device: the esp_timer clock that restarts at every wake-up, the wall clock and the RTC state.
+ */
+typedef struct {
+    int64_t timer_us;
+    int64_t wall_us;
+    size_t held;
+    int64_t oldest_us;
+    duty_cycle_trace_t trace;
+} fake_device_t;
+
+/**
+ * @brief Model energy in uJ from the SLEEP_* figures, worked out in floating point.
+ */
+static double model_uj(double active_us, double wifi_us, double sleep_us)
+{
+    // mV * mA = uW, uW * s = uJ
+    return SLEEP_SUPPLY_MV * (SLEEP_ACTIVE_CURRENT_MA * active_us +
+                              SLEEP_WIFI_CURRENT_MA * wifi_us +
+                              SLEEP_DEEP_SLEEP_CURRENT_UA / 1000.0 * sleep_us) / 1e6;
+}
+
+/**
+ * @brief One wake/sample/sleep cycle in the order of duty_cycle_run().
+ */
+static duty_cycle_phases_t run_cycle(fake_device_t *dev, int64_t read_us, int64_t upload_us)
+{
+    int64_t wake_us = dev->wall_us;
+    dev->timer_us = 0;
+
+    dev->timer_us += read_us;
+    if (dev->held++ == 0) {
+        dev->oldest_us = wake_us;
+    }
+
+    int64_t wifi_us = 0;
+    if (duty_cycle_upload_due(dev->held, (wake_us + dev->timer_us - dev->oldest_us) / 1000)) {
+        dev->timer_us += upload_us;
+        wifi_us = upload_us;
+        dev->held = 0;
+    }
+
+    duty_cycle_phases_t cycle = duty_cycle_trace_end(&dev->trace, dev->timer_us, wifi_us, 1);
+    dev->wall_us += cycle.awake_us + cycle.sleep_us;
+    return cycle;
+}
+
+TEST_CASE("Cycles keep the wake-up period and the model energy per phase", "[sleep]")
+{
+    fake_device_t dev = {0};
+    const int64_t period_us = (int64_t) SLEEP_SAMPLE_PERIOD_MS * 1000;
+    const int64_t boot_us = SLEEP_BOOT_OVERHEAD_MS * 1000;
+    int uploads = 0;
+
+    for (int i = 0; i < 2 * SLEEP_UPLOAD_BATCH; i++) {
+        int64_t wake_us = dev.wall_us;
+        duty_cycle_phases_t cycle = run_cycle(&dev, READ_US, UPLOAD_US);
+        bool upload = (i + 1) % SLEEP_UPLOAD_BATCH == 0;
+        uploads += upload;
+
+        TEST_ASSERT_EQUAL_INT64(upload ? UPLOAD_US : 0, cycle.wifi_us);
+        TEST_ASSERT_EQUAL_INT64(boot_us + READ_US + cycle.wifi_us, cycle.awake_us);
+        TEST_ASSERT_EQUAL_INT64(period_us - cycle.awake_us, cycle.sleep_us);
+        TEST_ASSERT_EQUAL_INT64(wake_us + period_us, dev.wall_us);
+        TEST_ASSERT_FLOAT_WITHIN(1.0, model_uj(cycle.awake_us - cycle.wifi_us, cycle.wifi_us, cycle.sleep_us),
+                                 (double) cycle.energy_uj);
+    }
+    TEST_ASSERT_EQUAL(2, uploads);
+
+    const int cycles = 2 * SLEEP_UPLOAD_BATCH;
+    TEST_ASSERT_EQUAL_UINT32(cycles, dev.trace.samples);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t) cycles * (boot_us + READ_US), dev.trace.active_us);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t) uploads * UPLOAD_US, dev.trace.wifi_us);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t) cycles * period_us, dev.trace.active_us + dev.trace.wifi_us + dev.trace.sleep_us);
+    double per_sample = model_uj(dev.trace.active_us, dev.trace.wifi_us, dev.trace.sleep_us) / cycles;
+    TEST_ASSERT_FLOAT_WITHIN(1.0, per_sample, (double) duty_cycle_trace_uj_per_sample(&dev.trace));
+}
+
+TEST_CASE("A cycle longer than the period sleeps 1 ms", "[sleep]")
+{
+    fake_device_t dev = {0};
+    const int64_t upload_us = (int64_t) SLEEP_SAMPLE_PERIOD_MS * 1000;
+    dev.held = SLEEP_UPLOAD_BATCH - 1;
+
+    duty_cycle_phases_t cycle = run_cycle(&dev, READ_US, upload_us);
+    TEST_ASSERT_EQUAL_INT64(upload_us, cycle.wifi_us);
+    TEST_ASSERT_EQUAL_INT64(1000, cycle.sleep_us);
+    TEST_ASSERT_EQUAL_INT64(cycle.awake_us + 1000, dev.wall_us);
+    TEST_ASSERT_EQUAL_UINT64(cycle.energy_uj, duty_cycle_energy_uj(dev.trace.active_us, dev.trace.wifi_us, dev.trace.sleep_us));
+}
+
+TEST_CASE("Held samples go out at the batch size or the deadline", "[sleep]")
+{
+    TEST_ASSERT_FALSE(duty_cycle_upload_due(0, 0));
+    TEST_ASSERT_FALSE(duty_cycle_upload_due(SLEEP_UPLOAD_BATCH - 1, SLEEP_UPLOAD_DEADLINE_MS - 1));
+    TEST_ASSERT_TRUE(duty_cycle_upload_due(SLEEP_UPLOAD_BATCH, 0));
+    TEST_ASSERT_TRUE(duty_cycle_upload_due(1, SLEEP_UPLOAD_DEADLINE_MS));
+}
@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "unity.h"
+#include "cJSON.h"
+#include "esp_timer.h"
+#include "config.h"
+#include "json-encoder.h"
+
+/*
+ * json-encoder.c against cJSON, which the firmware used before: the output
+ * must parse to the same values, and the [bench] case prints the time and the
+ * heap traffic of both for one upload batch.
+ */
+
+#define BENCH_ROUNDS 1000
+
+static size_t s_allocs;
+static size_t s_alloc_bytes;
+
+static void *counting_malloc(size_t size)
+{
+    s_allocs++;
+    s_alloc_bytes += size;
+    return malloc(size);
+}
+
+static void fill_batch(sample_t *batch, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        batch[i] = (sample_t) {
+            .timestamp_us = 1727000000000000LL + (int64_t) i * SAMPLE_PERIOD_MS * 1000,
+            .raw = (uint16_t)(100 + 37 * i),
+            .mode = BH1750_ONETIME_HALFLX_RES,
+            .mtreg = 138,
+            .channel = (uint8_t)(i % 2),
+        };
+    }
+}
+
+/**
+ * @brief The same batch built as a cJSON tree, the way the firmware serialized samples with cJSON.
+ */
+static char *cjson_encode_batch(const sample_t *batch, size_t n)
+{
+    float lux[SAMPLE_BATCH_MAX_COUNT];
+    sample_to_lux(batch, lux, n);
+    cJSON *array = cJSON_CreateArray();
+    for (size_t i = 0; i < n; i++) {
+        cJSON *obj = cJSON_CreateObject();
+        cJSON_AddNumberToObject(obj, "lux", lux[i]);
+        cJSON_AddNumberToObject(obj, "raw", batch[i].raw);
+        cJSON_AddNumberToObject(obj, "mode", batch[i].mode);
+        cJSON_AddNumberToObject(obj, "mtreg", batch[i].mtreg);
+        cJSON_AddNumberToObject(obj, "ch", batch[i].channel);
+        cJSON_AddNumberToObject(obj, "ts_us", (double) batch[i].timestamp_us);
+        cJSON_AddItemToArray(array, obj);
+    }
+    char *out = cJSON_PrintUnformatted(array);
+    cJSON_Delete(array);
+    return out;
+}
+
+TEST_CASE("Encoded batch parses with cJSON to the sample values", "[json]")
+{
+    sample_t batch[SAMPLE_BATCH_MAX_COUNT];
+    float lux[SAMPLE_BATCH_MAX_COUNT];
+    char buf[SAMPLE_BATCH_MAX_COUNT * JSON_SAMPLE_MAX_LEN + 2];
+    fill_batch(batch, SAMPLE_BATCH_MAX_COUNT);
+    sample_to_lux(batch, lux, SAMPLE_BATCH_MAX_COUNT);
+    TEST_ASSERT_EQUAL(ESP_OK, json_encode_batch(batch, SAMPLE_BATCH_MAX_COUNT, buf, sizeof(buf), NULL));
+
+    cJSON *array = cJSON_Parse(buf);
+    TEST_ASSERT_NOT_NULL(array);
+    TEST_ASSERT_EQUAL(SAMPLE_BATCH_MAX_COUNT, cJSON_GetArraySize(array));
+    for (size_t i = 0; i < SAMPLE_BATCH_MAX_COUNT; i++) {
+        cJSON *obj = cJSON_GetArrayItem(array, (int) i);
+        TEST_ASSERT_FLOAT_WITHIN(0.005, lux[i], cJSON_GetObjectItem(obj, "lux")->valuedouble);
+        TEST_ASSERT_EQUAL(batch[i].raw, cJSON_GetObjectItem(obj, "raw")->valueint);
+        TEST_ASSERT_EQUAL(batch[i].mode, cJSON_GetObjectItem(obj, "mode")->valueint);
+        TEST_ASSERT_EQUAL(batch[i].mtreg, cJSON_GetObjectItem(obj, "mtreg")->valueint);
+        TEST_ASSERT_EQUAL(batch[i].channel, cJSON_GetObjectItem(obj, "ch")->valueint);
+        // Exact in a double below 2^53
+        TEST_ASSERT_EQUAL_INT64(batch[i].timestamp_us, (int64_t) cJSON_GetObjectItem(obj, "ts_us")->valuedouble);
+    }
+    cJSON_Delete(array);
+}
+
+TEST_CASE("Encoder against cJSON: time and heap per batch", "[json][bench]")
+{
+    sample_t batch[SAMPLE_BATCH_MAX_COUNT];
+    static char buf[SAMPLE_BATCH_MAX_COUNT * JSON_SAMPLE_MAX_LEN + 2];
+    fill_batch(batch, SAMPLE_BATCH_MAX_COUNT);
+
+    cJSON_Hooks hooks = {.malloc_fn = counting_malloc, .free_fn = free};
+    cJSON_InitHooks(&hooks);
+    s_allocs = 0;
+    s_alloc_bytes = 0;
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        char *out = cjson_encode_batch(batch, SAMPLE_BATCH_MAX_COUNT);
+        TEST_ASSERT_NOT_NULL(out);
+        free(out);
+    }
+    int64_t cjson_us = esp_timer_get_time() - start_us;
+    cJSON_InitHooks(NULL);
+
+    start_us = esp_timer_get_time();
+    for (int i = 0; i < BENCH_ROUNDS; i++) {
+        TEST_ASSERT_EQUAL(ESP_OK, json_encode_batch(batch, SAMPLE_BATCH_MAX_COUNT, buf, sizeof(buf), NULL));
+    }
+    int64_t encoder_us = esp_timer_get_time() - start_us;
+
+    // json-encoder.c calls no allocator, its heap traffic is 0 by construction
+    printf("Batch of %d samples: cJSON %.2f us, %.1f allocations, %.0f bytes; json-encoder %.2f us, 0 allocations\n",
+           SAMPLE_BATCH_MAX_COUNT, (double) cjson_us / BENCH_ROUNDS, (double) s_allocs / BENCH_ROUNDS,
+           (double) s_alloc_bytes / BENCH_ROUNDS, (double) encoder_us / BENCH_ROUNDS);
+}
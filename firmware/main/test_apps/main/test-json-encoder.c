@@ -0,0 +1,114 @@
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "unity.h"
+#include "config.h"
+#include "json-encoder.h"
+
+#define CANARY 0xA5
+
+/**
+ * @brief Encode into a buffer of exactly len bytes followed by canaries, which must survive.
+ */
+static esp_err_t encode_sample_bounded(const sample_t *sample, char *buf, size_t len, size_t *out_len)
+{
+    memset(buf, CANARY, len + 8);
+    esp_err_t err = json_encode_sample(sample, buf, len, out_len);
+    for (size_t i = len; i < len + 8; i++) {
+        TEST_ASSERT_EQUAL_HEX8(CANARY, (uint8_t) buf[i]);
+    }
+    return err;
+}
+
+TEST_CASE("Sample is written with lux to 2 decimals and its range", "[json]")
+{
+    const sample_t sample = {.timestamp_us = 1727000000000000LL, .raw = 148, .mode = BH1750_ONETIME_1LX_RES, .mtreg = 69, .channel = 1};
+    char buf[JSON_SAMPLE_MAX_LEN];
+    size_t len;
+    TEST_ASSERT_EQUAL(ESP_OK, json_encode_sample(&sample, buf, sizeof(buf), &len));
+    TEST_ASSERT_EQUAL_STRING("{\"lux\":123.33,\"raw\":148,\"mode\":32,\"mtreg\":69,\"ch\":1,\"ts_us\":1727000000000000}", buf);
+    TEST_ASSERT_EQUAL(strlen(buf), len);
+
+    const sample_t dark = {.timestamp_us = -1, .raw = 0, .mode = BH1750_ONETIME_HALFLX_RES, .mtreg = 254};
+    TEST_ASSERT_EQUAL(ESP_OK, json_encode_sample(&dark, buf, sizeof(buf), NULL));
+    TEST_ASSERT_EQUAL_STRING("{\"lux\":0.00,\"raw\":0,\"mode\":33,\"mtreg\":254,\"ch\":0,\"ts_us\":-1}", buf);
+}
+
+TEST_CASE("Widest sample fits JSON_SAMPLE_MAX_LEN with its separator", "[json]")
+{
+    // Largest lux: full count at MTreg 1, 65535 * 57.5 lx rounded to a float scale; longest time: INT64_MIN
+    const sample_t widest = {.timestamp_us = INT64_MIN, .raw = UINT16_MAX, .mode = BH1750_ONETIME_4LX_RES, .mtreg = 1, .channel = UINT8_MAX};
+    char buf[JSON_SAMPLE_MAX_LEN + 8];
+    size_t len;
+    TEST_ASSERT_EQUAL(ESP_OK, encode_sample_bounded(&widest, buf, JSON_SAMPLE_MAX_LEN, &len));
+    TEST_ASSERT_EQUAL_STRING("{\"lux\":3768262.25,\"raw\":65535,\"mode\":35,\"mtreg\":1,\"ch\":255,\"ts_us\":-9223372036854775808}", buf);
+    TEST_ASSERT_LESS_OR_EQUAL(JSON_SAMPLE_MAX_LEN, len + 1);
+
+    // One byte short of the string and its NUL is refused without writing past the buffer
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, encode_sample_bounded(&widest, buf, len, NULL));
+    TEST_ASSERT_EQUAL(ESP_OK, encode_sample_bounded(&widest, buf, len + 1, NULL));
+}
+
+TEST_CASE("Batch sized like the uploader fits POST_DATA_MAX_LEN", "[json]")
+{
+    static sample_t batch[(POST_DATA_MAX_LEN - 2) / JSON_SAMPLE_MAX_LEN];
+    static char buf[POST_DATA_MAX_LEN];
+    const size_t n = sizeof(batch) / sizeof(batch[0]);
+    for (size_t i = 0; i < n; i++) {
+        batch[i] = (sample_t) {.timestamp_us = INT64_MIN, .raw = UINT16_MAX, .mode = BH1750_ONETIME_4LX_RES, .mtreg = 1, .channel = UINT8_MAX};
+    }
+    size_t len;
+    TEST_ASSERT_EQUAL(ESP_OK, json_encode_batch(batch, n, buf, sizeof(buf), &len));
+    TEST_ASSERT_EQUAL('[', buf[0]);
+    TEST_ASSERT_EQUAL(']', buf[len - 1]);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, json_encode_batch(batch, n, buf, len, NULL));
+}
+
+TEST_CASE("Window values are clamped, NaN and infinity written as null", "[json]")
+{
+    const sample_window_t window = {
+        .start_ms = INT64_MIN,
+        .window_ms = UINT32_MAX,
+        .count = UINT16_MAX,
+        .channel = UINT8_MAX,
+        .min = -FLT_MAX,
+        .max = 1e30f,
+        .mean = -0.004f,
+        .stddev = NAN,
+        .first = -INFINITY,
+        .last = -1234.5f,
+    };
+    char buf[JSON_WINDOW_MAX_LEN + 2];
+    size_t len;
+    TEST_ASSERT_EQUAL(ESP_OK, json_encode_windows(&window, 1, buf, sizeof(buf), &len));
+    TEST_ASSERT_EQUAL_STRING("[{\"ch\":255,\"ts\":-9223372036854775808,\"win\":4294967295,\"n\":65535,"
+                             "\"min\":-999999999.99,\"max\":999999999.99,\"mean\":0.00,\"sd\":null,"
+                             "\"first\":null,\"last\":-1234.50}]", buf);
+
+    // The widest window: every value at the clamp and negative
+    const sample_window_t widest = {
+        .start_ms = INT64_MIN, .window_ms = UINT32_MAX, .count = UINT16_MAX, .channel = UINT8_MAX,
+        .min = -1e9f, .max = -1e9f, .mean = -1e9f, .stddev = -1e9f, .first = -1e9f, .last = -1e9f,
+    };
+    TEST_ASSERT_EQUAL(ESP_OK, json_encode_windows(&widest, 1, buf, sizeof(buf), &len));
+    // Without the brackets, plus its separator
+    TEST_ASSERT_LESS_OR_EQUAL(JSON_WINDOW_MAX_LEN, len - 2 + 1);
+}
+
+TEST_CASE("Output holds no strings that would need escaping", "[json]")
+{
+    // Keys are literals and every value is a number or null, so nothing read
+    // from the device ends up between quotes
+    const sample_t samples[] = {
+        {.timestamp_us = INT64_MAX, .raw = 1, .mode = 0x10, .mtreg = 31, .channel = 3},
+        {.timestamp_us = INT64_MIN, .raw = UINT16_MAX, .mode = 0xFF, .mtreg = 0xFF, .channel = 0xFF},
+    };
+    char buf[2 * JSON_SAMPLE_MAX_LEN + 2];
+    TEST_ASSERT_EQUAL(ESP_OK, json_encode_batch(samples, 2, buf, sizeof(buf), NULL));
+    size_t quotes = 0;
+    for (const char *p = buf; *p; p++) {
+        TEST_ASSERT_NOT_NULL(strchr("{}[]\":,.-0123456789abcdefghijklmnopqrstuvwxyz_", *p));
+        quotes += (*p == '"');
+    }
+    TEST_ASSERT_EQUAL(2 * 2 * 6, quotes); // Only the 6 keys of each sample
+}
@@ -0,0 +1,360 @@
+#include <math.h>
+#include <string.h>
+#include "unity.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "bh1750.h"
+#include "fake-i2c.h"
+#include "fake-http-client.h"
+#include "config.h"
+#include "sensor-array.h"
+#include "http-uploader.h"
+#include "sample-spool.h"
+#include "telemetry-frame.h"
+#include "frame-decoder.h"
+#include "test-support.h"
+
+/*
+ * Sampler -> uploader: sensor_array_read() over the simulated sensors, samples
+ * handed to http_uploader_submit() as the sampler task does, the request bodies
+ * the uploader task sends are decoded and compared with what was read.
+ */
+
+#define PIPELINE_LUX_CH0 120.0f   // I2C0 0x23, auto-ranging settles in the most sensitive range that is used
+#define PIPELINE_LUX_CH3 30000.0f // I2C1 0x5C, saturates there, auto-ranging steps down
+#define PIPELINE_MAX_SAMPLES 128
+#define PIPELINE_UPLOAD_TIMEOUT_MS (SAMPLE_BATCH_MAX_AGE_MS + 5000)
+#define PIPELINE_OUTAGE_SAMPLES 2000 // 5 s of draining at SPOOL_DRAIN_MAX_SAMPLES_PER_S
+
+static sample_t s_taken[PIPELINE_MAX_SAMPLES];
+static sample_t s_received[PIPELINE_MAX_SAMPLES];
+
+/**
+ * @brief Bring up the sensors and the uploader task once, they stay up for all tests.
+ */
+static void pipeline_start(void)
+{
+    static bool s_started;
+    if (s_started) {
+        return;
+    }
+    fake_i2c_bh1750_set_lux(I2C_NUM_0, BH1750_I2C_ADDRESS_DEFAULT, PIPELINE_LUX_CH0);
+    fake_i2c_bh1750_set_lux(I2C_NUM_1, BH1750_I2C_ADDRESS_HIGH, PIPELINE_LUX_CH3);
+    TEST_ASSERT_EQUAL(ESP_OK, sensor_array_init());
+    TEST_ASSERT_EQUAL(2, sensor_array_count());
+    TEST_ASSERT_EQUAL(ESP_OK, http_uploader_start());
+    http_uploader_set_online(true);
+    s_started = true;
+}
+
+/**
+ * @brief Read every sensor rounds times and submit the samples, as the sampler task does.
+ * @return Number of samples taken, copied to s_taken
+ */
+static size_t pipeline_sample(size_t rounds)
+{
+    size_t n = 0;
+    for (size_t r = 0; r < rounds; r++) {
+        sample_t round[SENSOR_ARRAY_MAX_CHANNELS];
+        size_t got = sensor_array_read(round, SENSOR_ARRAY_MAX_CHANNELS);
+        TEST_ASSERT_EQUAL(sensor_array_count(), got);
+        for (size_t i = 0; i < got; i++) {
+            TEST_ASSERT_TRUE(http_uploader_submit(&round[i]));
+            TEST_ASSERT_LESS_THAN(PIPELINE_MAX_SAMPLES, n);
+            s_taken[n++] = round[i];
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Wait until the uploader reports at least n samples accepted in total.
+ */
+static void pipeline_wait_sent(uint64_t n)
+{
+    http_uploader_stats_t stats;
+    int64_t deadline_us = esp_timer_get_time() + PIPELINE_UPLOAD_TIMEOUT_MS * 1000LL;
+    do {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        http_uploader_get_stats(&stats);
+    } while (stats.samples_sent < n && esp_timer_get_time() < deadline_us);
+    TEST_ASSERT_EQUAL_UINT64(n, stats.samples_sent);
+}
+
+/**
+ * @brief Decode the bodies of all recorded requests the server answered with 200.
+ * @return Number of samples, copied to s_received
+ */
+static size_t pipeline_received(void)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < fake_http_request_count(); i++) {
+        const fake_http_request_t *req = fake_http_request(i);
+        if (req->status != 200) {
+            continue;
+        }
+        TEST_ASSERT_EQUAL_STRING(TELEMETRY_FRAME_CONTENT_TYPE, req->content_type);
+        uint32_t device_id;
+        size_t n;
+        TEST_ASSERT_EQUAL(ESP_OK, frame_decoder_decode(req->body, req->len, &device_id, s_received + total,
+                                                       PIPELINE_MAX_SAMPLES - total, &n));
+        TEST_ASSERT_EQUAL_HEX32((uint32_t)test_mac[2] << 24 | test_mac[3] << 16 | test_mac[4] << 8 | test_mac[5], device_id);
+        total += n;
+    }
+    return total;
+}
+
+/**
+ * @brief Every taken sample arrived exactly once and in order per channel: count, range and
+ * channel unchanged, the time within the frame jitter bound.
+ */
+static void pipeline_check(size_t taken, size_t received)
+{
+    TEST_ASSERT_EQUAL(taken, received);
+    for (uint8_t ch = 0; ch < SENSOR_ARRAY_MAX_CHANNELS; ch++) {
+        size_t r = 0;
+        int64_t prev_us = 0;
+        for (size_t t = 0; t < taken; t++) {
+            if (s_taken[t].channel != ch) {
+                continue;
+            }
+            while (r < received && s_received[r].channel != ch) {
+                r++;
+            }
+            TEST_ASSERT_LESS_THAN(received, r);
+            const sample_t *sent = &s_taken[t];
+            const sample_t *got = &s_received[r++];
+            TEST_ASSERT_EQUAL_UINT16(sent->raw, got->raw);
+            TEST_ASSERT_EQUAL_UINT8(sent->mode, got->mode);
+            TEST_ASSERT_EQUAL_UINT8(sent->mtreg, got->mtreg);
+            // A frame rebuilds the times from its mean period, each within JITTER_PCT of it
+            int64_t spacing_us = prev_us ? sent->timestamp_us - prev_us : 0;
+            TEST_ASSERT_INT64_WITHIN(spacing_us * TELEMETRY_FRAME_JITTER_PCT / 100 + 1, sent->timestamp_us, got->timestamp_us);
+            prev_us = sent->timestamp_us;
+        }
+    }
+}
+
+TEST_CASE("Samples reach the server in order with their range", "[pipeline]")
+{
+    pipeline_start();
+    fake_http_reset();
+    http_uploader_stats_t before;
+    http_uploader_get_stats(&before);
+
+    size_t taken = pipeline_sample(SAMPLE_BATCH_MAX_COUNT);
+    pipeline_wait_sent(before.samples_sent + taken);
+    pipeline_check(taken, pipeline_received());
+
+    for (size_t t = 0; t < taken; t++) {
+        const sample_t *s = &s_taken[t];
+        float lux = s->raw * bh1750_lux_per_count(s->mode, s->mtreg);
+        if (s->channel == 0) {
+            TEST_ASSERT_FLOAT_WITHIN(bh1750_lux_per_count(s->mode, s->mtreg), PIPELINE_LUX_CH0, lux);
+        } else if (s->raw < UINT16_MAX) {
+            TEST_ASSERT_FLOAT_WITHIN(bh1750_lux_per_count(s->mode, s->mtreg), PIPELINE_LUX_CH3, lux);
+        }
+    }
+    // Channel 3 saturated its first range and was read in a less sensitive one after
+    TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, s_taken[1].raw);
+    TEST_ASSERT_EQUAL_UINT8(3, s_taken[1].channel);
+    TEST_ASSERT_EQUAL_UINT8(BH1750_ONETIME_4LX_RES, s_taken[3].mode);
+
+    http_uploader_stats_t after;
+    http_uploader_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(before.failures, after.failures);
+    TEST_ASSERT_EQUAL_UINT32(before.samples_dropped, after.samples_dropped);
+    TEST_ASSERT_GREATER_THAN(0, fake_i2c_bh1750_reads(I2C_NUM_1, BH1750_I2C_ADDRESS_HIGH));
+}
+
+TEST_CASE("Samples wait in RAM while the server asks to back off", "[pipeline]")
+{
+    pipeline_start();
+    fake_http_reset();
+    fake_http_set_response(503, "1");
+    http_uploader_stats_t before;
+    http_uploader_get_stats(&before);
+
+    size_t taken = pipeline_sample(SAMPLE_BATCH_MAX_COUNT / sensor_array_count());
+    int64_t deadline_us = esp_timer_get_time() + PIPELINE_UPLOAD_TIMEOUT_MS * 1000LL;
+    while (fake_http_request_count() == 0 && esp_timer_get_time() < deadline_us) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    TEST_ASSERT_EQUAL(1, fake_http_request_count());
+
+    // Nothing goes out before Retry-After has passed, not even a retry of the same batch
+    fake_http_set_response(200, NULL);
+    vTaskDelay(pdMS_TO_TICKS(500));
+    TEST_ASSERT_EQUAL(1, fake_http_request_count());
+
+    pipeline_wait_sent(before.samples_sent + taken);
+    TEST_ASSERT_EQUAL(503, fake_http_request(0)->status);
+    pipeline_check(taken, pipeline_received());
+
+    http_uploader_stats_t after;
+    http_uploader_get_stats(&after);
+    TEST_ASSERT_EQUAL_UINT32(before.failures + 1, after.failures);
+    TEST_ASSERT_EQUAL_UINT32(before.samples_dropped, after.samples_dropped);
+}
+
+TEST_CASE("Backlog of an outage drains in order at the rate cap", "[pipeline][spool]")
+{
+    static sample_t s_drained[PIPELINE_OUTAGE_SAMPLES];
+    pipeline_start();
+    fake_http_reset();
+    http_uploader_set_online(false);
+    http_uploader_stats_t before;
+    http_uploader_get_stats(&before);
+    TEST_ASSERT_EQUAL(0, sample_spool_pending());
+
+    // Offline every sample goes to the spool, one flash append each
+    int64_t start_us = esp_timer_get_time();
+    for (size_t i = 0; i < PIPELINE_OUTAGE_SAMPLES; i++) {
+        const sample_t sample = {
+            .timestamp_us = TEST_EPOCH_US + (int64_t) i * SAMPLE_PERIOD_MS * 1000,
+            .raw = (uint16_t) i,
+            .mode = BH1750_ONETIME_1LX_RES,
+            .mtreg = 69,
+        };
+        while (!http_uploader_submit(&sample)) {
+            vTaskDelay(1);
+        }
+    }
+    while (sample_spool_pending() < PIPELINE_OUTAGE_SAMPLES && esp_timer_get_time() - start_us < PIPELINE_UPLOAD_TIMEOUT_MS * 1000LL) {
+        vTaskDelay(1);
+    }
+    int64_t spool_us = esp_timer_get_time() - start_us;
+    TEST_ASSERT_EQUAL(PIPELINE_OUTAGE_SAMPLES, sample_spool_pending());
+    TEST_ASSERT_EQUAL(0, fake_http_request_count());
+
+    start_us = esp_timer_get_time();
+    http_uploader_set_online(true);
+    int64_t deadline_us = start_us + 2000LL * PIPELINE_OUTAGE_SAMPLES * 1000 / SPOOL_DRAIN_MAX_SAMPLES_PER_S + PIPELINE_UPLOAD_TIMEOUT_MS * 1000LL;
+    http_uploader_stats_t after;
+    do {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        http_uploader_get_stats(&after);
+    } while (after.samples_sent < before.samples_sent + PIPELINE_OUTAGE_SAMPLES && esp_timer_get_time() < deadline_us);
+    int64_t drain_us = esp_timer_get_time() - start_us;
+    TEST_ASSERT_EQUAL_UINT64(before.samples_sent + PIPELINE_OUTAGE_SAMPLES, after.samples_sent);
+    TEST_ASSERT_EQUAL(0, sample_spool_pending());
+    printf("Outage of %d samples: spooled in %lld ms, drained in %lld ms (%lld samples/s) in %u requests\n",
+           PIPELINE_OUTAGE_SAMPLES, spool_us / 1000, drain_us / 1000, (long long) PIPELINE_OUTAGE_SAMPLES * 1000000 / drain_us,
+           (unsigned) fake_http_request_count());
+
+    // The first batch goes out at once, every further one waits for its share of the rate cap,
+    // less up to a tick of rounding per batch
+    int64_t paced_us = (int64_t)(PIPELINE_OUTAGE_SAMPLES - SPOOL_DRAIN_BATCH) * 1000000 / SPOOL_DRAIN_MAX_SAMPLES_PER_S;
+    TEST_ASSERT_GREATER_OR_EQUAL(paced_us - PIPELINE_OUTAGE_SAMPLES / SPOOL_DRAIN_BATCH * portTICK_PERIOD_MS * 1000, drain_us);
+
+    size_t total = 0;
+    for (size_t i = 0; i < fake_http_request_count(); i++) {
+        const fake_http_request_t *req = fake_http_request(i);
+        TEST_ASSERT_EQUAL(200, req->status);
+        uint32_t device_id;
+        size_t n;
+        TEST_ASSERT_EQUAL(ESP_OK, frame_decoder_decode(req->body, req->len, &device_id, s_drained + total,
+                                                       PIPELINE_OUTAGE_SAMPLES - total, &n));
+        TEST_ASSERT_LESS_OR_EQUAL(SPOOL_DRAIN_BATCH, n);
+        total += n;
+    }
+    TEST_ASSERT_EQUAL(PIPELINE_OUTAGE_SAMPLES, total);
+    for (size_t i = 0; i < total; i++) {
+        TEST_ASSERT_EQUAL_UINT16(i, s_drained[i].raw);
+    }
+}
+
+TEST_CASE("A batch the server refuses is dropped, not spooled or retried", "[pipeline]")
+{
+    pipeline_start();
+    fake_http_reset();
+    fake_http_set_next_response(400);
+    http_uploader_stats_t before;
+    http_uploader_get_stats(&before);
+
+    size_t taken = pipeline_sample(SAMPLE_BATCH_MAX_COUNT / sensor_array_count());
+    http_uploader_stats_t after;
+    int64_t deadline_us = esp_timer_get_time() + PIPELINE_UPLOAD_TIMEOUT_MS * 1000LL;
+    do {
+        vTaskDelay(pdMS_TO_TICKS(50));
+        http_uploader_get_stats(&after);
+    } while (after.samples_sent + after.samples_refused < before.samples_sent + before.samples_refused + taken &&
+             esp_timer_get_time() < deadline_us);
+    size_t refused = after.samples_refused - before.samples_refused;
+    TEST_ASSERT_GREATER_THAN(0, refused);
+    TEST_ASSERT_EQUAL_UINT64(before.samples_sent + taken - refused, after.samples_sent);
+    TEST_ASSERT_EQUAL(400, fake_http_request(0)->status);
+    TEST_ASSERT_EQUAL(0, sample_spool_pending());
+
+    // The refused request held the oldest samples, everything after it arrived once
+    vTaskDelay(pdMS_TO_TICKS(500));
+    memmove(s_taken, s_taken + refused, (taken - refused) * sizeof(sample_t));
+    pipeline_check(taken - refused, pipeline_received());
+
+    // Later samples are not held up behind the refused batch
+    fake_http_reset();
+    taken = pipeline_sample(SAMPLE_BATCH_MAX_COUNT / sensor_array_count());
+    pipeline_wait_sent(after.samples_sent + taken);
+    pipeline_check(taken, pipeline_received());
+}
+
+TEST_CASE("A refused spool batch is dropped and the backlog drains past it", "[pipeline][spool]")
+{
+    static sample_t s_drained[3 * SPOOL_DRAIN_BATCH];
+    const size_t outage = 3 * SPOOL_DRAIN_BATCH;
+    pipeline_start();
+    fake_http_reset();
+    http_uploader_set_online(false);
+    http_uploader_stats_t before;
+    http_uploader_get_stats(&before);
+    TEST_ASSERT_EQUAL(0, sample_spool_pending());
+
+    for (size_t i = 0; i < outage; i++) {
+        const sample_t sample = {
+            .timestamp_us = TEST_EPOCH_US + (int64_t) i * SAMPLE_PERIOD_MS * 1000,
+            .raw = (uint16_t) i,
+            .mode = BH1750_ONETIME_1LX_RES,
+            .mtreg = 69,
+        };
+        while (!http_uploader_submit(&sample)) {
+            vTaskDelay(1);
+        }
+    }
+    int64_t deadline_us = esp_timer_get_time() + PIPELINE_UPLOAD_TIMEOUT_MS * 1000LL;
+    while (sample_spool_pending() < outage && esp_timer_get_time() < deadline_us) {
+        vTaskDelay(1);
+    }
+    TEST_ASSERT_EQUAL(outage, sample_spool_pending());
+
+    // The spool head is refused once, then the server takes everything
+    fake_http_set_next_response(400);
+    http_uploader_set_online(true);
+    deadline_us = esp_timer_get_time() + 2000LL * outage * 1000 / SPOOL_DRAIN_MAX_SAMPLES_PER_S + PIPELINE_UPLOAD_TIMEOUT_MS * 1000LL;
+    http_uploader_stats_t after;
+    do {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        http_uploader_get_stats(&after);
+    } while (sample_spool_pending() > 0 && esp_timer_get_time() < deadline_us);
+    TEST_ASSERT_EQUAL(0, sample_spool_pending());
+    TEST_ASSERT_EQUAL(400, fake_http_request(0)->status);
+
+    size_t refused = after.samples_refused - before.samples_refused;
+    TEST_ASSERT_EQUAL(SPOOL_DRAIN_BATCH, refused);
+    TEST_ASSERT_EQUAL_UINT64(before.samples_sent + outage - refused, after.samples_sent);
+
+    size_t total = 0;
+    for (size_t i = 1; i < fake_http_request_count(); i++) {
+        const fake_http_request_t *req = fake_http_request(i);
+        TEST_ASSERT_EQUAL(200, req->status);
+        uint32_t device_id;
+        size_t n;
+        TEST_ASSERT_EQUAL(ESP_OK, frame_decoder_decode(req->body, req->len, &device_id, s_drained + total,
+                                                       outage - total, &n));
+        total += n;
+    }
+    TEST_ASSERT_EQUAL(outage - refused, total);
+    for (size_t i = 0; i < total; i++) {
+        TEST_ASSERT_EQUAL_UINT16(refused + i, s_drained[i].raw);
+    }
+}
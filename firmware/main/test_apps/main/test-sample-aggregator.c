@@ -0,0 +1,92 @@
+#include <stdint.h>
+#include "unity.h"
+#include "config.h"
+#include "sample-aggregator.h"
+#include "test-support.h"
+
+#define WINDOW_START_MS (TEST_EPOCH_US / 1000 - (TEST_EPOCH_US / 1000) % AGGREGATE_WINDOW_MS)
+
+static sample_t sample_at(int64_t ms, uint8_t channel, uint16_t raw)
+{
+    return (sample_t){.timestamp_us = ms * 1000, .raw = raw, .mode = BH1750_ONETIME_1LX_RES,
+                      .mtreg = BH1750_MTREG_DEFAULT, .channel = channel};
+}
+
+static float lux_of(uint16_t raw)
+{
+    sample_t sample = sample_at(0, 0, raw);
+    float lux;
+    sample_to_lux(&sample, &lux, 1);
+    return lux;
+}
+
+/**
+ * @brief Drop whatever an earlier test left running.
+ */
+static void aggregator_reset(void)
+{
+    sample_window_t windows[SENSOR_ARRAY_MAX_CHANNELS];
+    sample_aggregator_close(INT64_MAX, windows, SENSOR_ARRAY_MAX_CHANNELS);
+}
+
+TEST_CASE("A sample of the next window closes the running one", "[aggregate]")
+{
+    aggregator_reset();
+    sample_window_t window;
+    sample_t first = sample_at(WINDOW_START_MS, 0, 100);
+    sample_t second = sample_at(WINDOW_START_MS + AGGREGATE_WINDOW_MS - 1, 0, 300);
+    sample_t next = sample_at(WINDOW_START_MS + AGGREGATE_WINDOW_MS, 0, 200);
+    TEST_ASSERT_FALSE(sample_aggregator_add(&first, &window));
+    TEST_ASSERT_FALSE(sample_aggregator_add(&second, &window));
+    TEST_ASSERT_TRUE(sample_aggregator_add(&next, &window));
+
+    TEST_ASSERT_EQUAL_INT64(WINDOW_START_MS, window.start_ms);
+    TEST_ASSERT_EQUAL_UINT32(AGGREGATE_WINDOW_MS, window.window_ms);
+    TEST_ASSERT_EQUAL_UINT16(2, window.count);
+    TEST_ASSERT_EQUAL_FLOAT(lux_of(100), window.first);
+    TEST_ASSERT_EQUAL_FLOAT(lux_of(300), window.last);
+    TEST_ASSERT_EQUAL_FLOAT(lux_of(100), window.min);
+    TEST_ASSERT_EQUAL_FLOAT(lux_of(300), window.max);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, lux_of(200), window.mean);
+}
+
+TEST_CASE("Windows close on their deadline when samples stop", "[aggregate]")
+{
+    aggregator_reset();
+    sample_window_t window;
+    sample_t ch0 = sample_at(WINDOW_START_MS + 10, 0, 120);
+    sample_t ch2 = sample_at(WINDOW_START_MS + 20, 2, 240);
+    TEST_ASSERT_FALSE(sample_aggregator_add(&ch0, &window));
+    TEST_ASSERT_FALSE(sample_aggregator_add(&ch2, &window));
+
+    sample_window_t windows[SENSOR_ARRAY_MAX_CHANNELS];
+    TEST_ASSERT_EQUAL(0, sample_aggregator_close(WINDOW_START_MS + AGGREGATE_WINDOW_MS - 1, windows, SENSOR_ARRAY_MAX_CHANNELS));
+    TEST_ASSERT_EQUAL(2, sample_aggregator_close(WINDOW_START_MS + AGGREGATE_WINDOW_MS, windows, SENSOR_ARRAY_MAX_CHANNELS));
+    TEST_ASSERT_EQUAL_UINT8(0, windows[0].channel);
+    TEST_ASSERT_EQUAL_UINT8(2, windows[1].channel);
+    TEST_ASSERT_EQUAL_INT64(WINDOW_START_MS, windows[1].start_ms);
+    TEST_ASSERT_EQUAL_UINT16(1, windows[1].count);
+    TEST_ASSERT_EQUAL_FLOAT(lux_of(240), windows[1].mean);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, windows[1].stddev);
+
+    // Closed once, the next sample starts a new window instead of closing it again
+    TEST_ASSERT_EQUAL(0, sample_aggregator_close(INT64_MAX, windows, SENSOR_ARRAY_MAX_CHANNELS));
+    sample_t late = sample_at(WINDOW_START_MS + AGGREGATE_WINDOW_MS + 5, 0, 120);
+    TEST_ASSERT_FALSE(sample_aggregator_add(&late, &window));
+}
+
+TEST_CASE("Closing stops at the capacity and leaves the rest running", "[aggregate]")
+{
+    aggregator_reset();
+    sample_window_t window;
+    for (uint8_t channel = 0; channel < SENSOR_ARRAY_MAX_CHANNELS; channel++) {
+        sample_t sample = sample_at(WINDOW_START_MS, channel, 50);
+        TEST_ASSERT_FALSE(sample_aggregator_add(&sample, &window));
+    }
+
+    sample_window_t windows[SENSOR_ARRAY_MAX_CHANNELS];
+    TEST_ASSERT_EQUAL(1, sample_aggregator_close(INT64_MAX, windows, 1));
+    TEST_ASSERT_EQUAL_UINT8(0, windows[0].channel);
+    TEST_ASSERT_EQUAL(SENSOR_ARRAY_MAX_CHANNELS - 1, sample_aggregator_close(INT64_MAX, windows, SENSOR_ARRAY_MAX_CHANNELS));
+    TEST_ASSERT_EQUAL_UINT8(1, windows[0].channel);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+#define TEST_EPOCH_US 1727000000000000LL // Wall clock at esp_timer 0, see time_sync_epoch_us() in test_apps.c
+
+/**
+ * @brief Station MAC esp_read_mac() reports, its last 4 bytes are the device id
+ */
+extern const uint8_t test_mac[6];
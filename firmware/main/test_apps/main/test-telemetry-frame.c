@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include "unity.h"
+#include "telemetry-frame.h"
+#include "frame-decoder.h"
+
+/*
+ * The golden vectors of test/telemetry-frame-vectors.txt, embedded by
+ * CMakeLists.txt. The server and the gateway check the same file, so the
+ * encoder and all three decoders agree on every byte.
+ */
+
+#define VECTOR_MAX_SAMPLES 32
+#define VECTOR_MAX_BODY 512
+
+extern const char s_vectors_start[] asm("_binary_telemetry_frame_vectors_txt_start");
+
+typedef struct {
+    char name[64];
+    uint32_t device_id;
+    sample_t in[VECTOR_MAX_SAMPLES];
+    size_t in_count;
+    uint8_t body[VECTOR_MAX_BODY];
+    size_t body_len;
+    sample_t out[VECTOR_MAX_SAMPLES];
+    size_t out_count;
+    bool invalid;
+} frame_vector_t;
+
+/**
+ * @brief Parse "<ts_us> <raw> <mode> <mtreg> <ch>".
+ */
+static void parse_sample(const char *text, sample_t *sample, const char *name)
+{
+    char *end;
+    sample->timestamp_us = strtoll(text, &end, 0);
+    sample->raw = (uint16_t) strtoul(end, &end, 0);
+    sample->mode = (uint8_t) strtoul(end, &end, 0);
+    sample->mtreg = (uint8_t) strtoul(end, &end, 0);
+    sample->channel = (uint8_t) strtoul(end, &end, 0);
+    TEST_ASSERT_TRUE_MESSAGE(*end == '\0', name);
+}
+
+/**
+ * @brief Append the bytes of a hex string to the body.
+ */
+static void parse_frame(const char *hex, frame_vector_t *v)
+{
+    size_t digits = strlen(hex);
+    TEST_ASSERT_EQUAL_MESSAGE(0, digits % 2, v->name);
+    TEST_ASSERT_LESS_THAN_MESSAGE(VECTOR_MAX_BODY - v->body_len + 1, digits / 2, v->name);
+    for (size_t i = 0; i < digits; i += 2) {
+        char byte[3] = {hex[i], hex[i + 1], '\0'};
+        v->body[v->body_len++] = (uint8_t) strtoul(byte, NULL, 16);
+    }
+}
+
+static void check_samples(const frame_vector_t *v, const sample_t *expected, const sample_t *actual, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        TEST_ASSERT_EQUAL_INT64_MESSAGE(expected[i].timestamp_us, actual[i].timestamp_us, v->name);
+        TEST_ASSERT_EQUAL_UINT16_MESSAGE(expected[i].raw, actual[i].raw, v->name);
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(expected[i].mode, actual[i].mode, v->name);
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(expected[i].mtreg, actual[i].mtreg, v->name);
+        TEST_ASSERT_EQUAL_UINT8_MESSAGE(expected[i].channel, actual[i].channel, v->name);
+    }
+}
+
+/**
+ * @brief The encoder writes exactly the frames of a vector from its samples, the decoder returns its out samples.
+ */
+static void check_vector(const frame_vector_t *v)
+{
+    if (v->in_count) {
+        uint8_t buf[VECTOR_MAX_BODY];
+        size_t len, count;
+        TEST_ASSERT_EQUAL_MESSAGE(ESP_OK, telemetry_frame_encode(v->device_id, v->in, v->in_count, buf, sizeof(buf), &len, &count), v->name);
+        TEST_ASSERT_EQUAL_MESSAGE(v->in_count, count, v->name);
+        TEST_ASSERT_EQUAL_MESSAGE(v->body_len, len, v->name);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY_MESSAGE(v->body, buf, len, v->name);
+    }
+
+    sample_t decoded[VECTOR_MAX_SAMPLES];
+    uint32_t device_id;
+    size_t count;
+    esp_err_t err = frame_decoder_decode(v->body, v->body_len, &device_id, decoded, VECTOR_MAX_SAMPLES, &count);
+    if (v->invalid) {
+        TEST_ASSERT_EQUAL_MESSAGE(ESP_ERR_INVALID_RESPONSE, err, v->name);
+        return;
+    }
+    TEST_ASSERT_EQUAL_MESSAGE(ESP_OK, err, v->name);
+    TEST_ASSERT_EQUAL_HEX32_MESSAGE(v->device_id, device_id, v->name);
+    TEST_ASSERT_EQUAL_MESSAGE(v->out_count, count, v->name);
+    check_samples(v, v->out, decoded, count);
+}
+
+TEST_CASE("Frames match the golden vectors", "[frame]")
+{
+    static frame_vector_t v;
+    size_t checked = 0;
+    bool open = false;
+    const char *line = s_vectors_start;
+    while (*line) {
+        const char *eol = strchr(line, '\n');
+        size_t len = eol ? (size_t)(eol - line) : strlen(line);
+        char text[VECTOR_MAX_BODY * 2 + 16];
+        TEST_ASSERT_LESS_THAN(sizeof(text), len);
+        memcpy(text, line, len);
+        text[len] = '\0';
+        line += eol ? len + 1 : len;
+
+        if (!strncmp(text, "vector ", 7)) {
+            memset(&v, 0, sizeof(v));
+            snprintf(v.name, sizeof(v.name), "%s", text + 7);
+            open = true;
+        } else if (len == 0 || text[0] == '#') {
+            if (len == 0 && open) {
+                check_vector(&v);
+                checked++;
+                open = false;
+            }
+        } else if (!strncmp(text, "device ", 7)) {
+            v.device_id = (uint32_t) strtoul(text + 7, NULL, 0);
+        } else if (!strncmp(text, "in ", 3)) {
+            TEST_ASSERT_LESS_THAN_MESSAGE(VECTOR_MAX_SAMPLES, v.in_count, v.name);
+            parse_sample(text + 3, &v.in[v.in_count++], v.name);
+        } else if (!strncmp(text, "out ", 4)) {
+            TEST_ASSERT_LESS_THAN_MESSAGE(VECTOR_MAX_SAMPLES, v.out_count, v.name);
+            parse_sample(text + 4, &v.out[v.out_count++], v.name);
+        } else if (!strncmp(text, "frame ", 6)) {
+            parse_frame(text + 6, &v);
+        } else if (!strcmp(text, "invalid")) {
+            v.invalid = true;
+        } else {
+            TEST_FAIL_MESSAGE(text);
+        }
+    }
+    if (open) {
+        check_vector(&v);
+        checked++;
+    }
+    TEST_ASSERT_GREATER_THAN(0, checked);
+}
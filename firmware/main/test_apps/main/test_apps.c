@@ -0,0 +1,54 @@
+#include <string.h>
+#include "unity.h"
+#include "unity_test_runner.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "memory-report.h"
+#include "time-sync.h"
+#include "test-support.h"
+
+/*
+ * Host-target tests of the firmware modules, run on the linux target against
+ * the simulated sensors of fake-i2c.h and the local server of fake-http-client.h.
+ * Time sync, the memory report and the MAC come from the stand-ins below,
+ * the modules under test are built from ../../ unchanged.
+ */
+
+const uint8_t test_mac[6] = {0x24, 0x0A, 0x11, 0x22, 0x33, 0x44};
+
+int64_t time_sync_epoch_us(int64_t timer_us)
+{
+    return TEST_EPOCH_US + timer_us;
+}
+
+int64_t time_sync_now_us(void)
+{
+    return TEST_EPOCH_US + esp_timer_get_time();
+}
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    memcpy(mac, test_mac, sizeof(test_mac));
+    return ESP_OK;
+}
+
+void memory_report_add(const char *name, const void *addr, size_t size)
+{
+}
+
+void memory_report_add_task(TaskHandle_t task, const void *stack, size_t size)
+{
+}
+
+void setUp(void)
+{
+}
+
+void tearDown(void)
+{
+}
+
+void app_main(void)
+{
+    unity_run_menu();
+}
@@ -0,0 +1,145 @@
+#include <sys/time.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_netif_sntp.h"
+#include "esp_timer.h"
+#include "config.h"
+#include "time-sync.h"
+
+/**
+ * @brief Offset model, see time-sync.h
+ */
+typedef struct
+{
+    int64_t anchor_timer_us;
+    int64_t anchor_epoch_us;
+    int64_t slew_us;   // Correction spread over TIME_SYNC_SLEW_MS after the anchor
+    int32_t drift_ppb;
+    bool synced;
+} clock_model_t;
+
+static clock_model_t s_model;
+static time_sync_stats_t s_stats;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_started;
+
+static int64_t system_now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/**
+ * @brief Drift correction over dt, dt * drift_ppb / 10^9 without overflowing int64.
+ * dt * drift_ppb alone overflows after about 200 days at the largest drift, so the multiples
+ * of 10^9 us in dt and the rest are scaled apart.
+ */
+static int64_t drift_us(int64_t dt, int32_t drift_ppb)
+{
+    return dt / 1000000000 * drift_ppb + dt % 1000000000 * drift_ppb / 1000000000;
+}
+
+static int64_t model_epoch_us(const clock_model_t *m, int64_t timer_us)
+{
+    const int64_t slew_span_us = (int64_t)TIME_SYNC_SLEW_MS * 1000;
+    int64_t dt = timer_us - m->anchor_timer_us;
+    int64_t slewed = (dt <= 0) ? 0 : (dt < slew_span_us ? dt : slew_span_us);
+    return m->anchor_epoch_us + dt + drift_us(dt, m->drift_ppb) + m->slew_us * slewed / slew_span_us;
+}
+
+/**
+ * @brief SNTP update, runs in the lwIP task after the system clock was set to tv.
+ */
+static void on_sync(struct timeval *tv)
+{
+    const int32_t max_drift_ppb = TIME_SYNC_MAX_DRIFT_PPM * 1000;
+    int64_t timer_us = esp_timer_get_time();
+    int64_t epoch_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+
+    portENTER_CRITICAL(&s_lock);
+    int64_t error_us = s_model.synced ? epoch_us - model_epoch_us(&s_model, timer_us) : 0;
+    bool step = !s_model.synced || error_us > TIME_SYNC_STEP_MS * 1000LL || error_us < -TIME_SYNC_STEP_MS * 1000LL;
+    if (step)
+    {
+        s_model = (clock_model_t){.anchor_timer_us = timer_us, .anchor_epoch_us = epoch_us,
+                                  .drift_ppb = s_model.drift_ppb, .synced = true};
+        s_stats.steps++;
+    }
+    else
+    {
+        // Continue from the prediction and slew the error in
+        s_model.anchor_epoch_us = epoch_us - error_us;
+        s_model.anchor_timer_us = timer_us;
+        s_model.slew_us = error_us;
+        // The error built up since the previous sync is the drift left over, correct half of it
+        int64_t interval_us = timer_us - s_stats.last_sync_us;
+        if (interval_us > 0)
+        {
+            int64_t drift_ppb = s_model.drift_ppb + error_us * 1000000000 / interval_us / 2;
+            s_model.drift_ppb = (int32_t)(drift_ppb > max_drift_ppb ? max_drift_ppb : (drift_ppb < -max_drift_ppb ? -max_drift_ppb : drift_ppb));
+        }
+    }
+    s_stats.syncs++;
+    s_stats.last_error_us = error_us;
+    s_stats.drift_ppb = s_model.drift_ppb;
+    s_stats.last_sync_us = timer_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG_t, "SNTP sync %lu: error %lld us (%s), drift %ld ppb", (unsigned long)s_stats.syncs, error_us,
+             step ? "stepped" : "slewed", (long)s_stats.drift_ppb);
+}
+
+esp_err_t time_sync_start(void)
+{
+    if (s_started)
+    {
+        return ESP_OK;
+    }
+    esp_sntp_config_t config = ESP_NETIF_SNTP_DEFAULT_CONFIG(TIME_SYNC_SERVER);
+    config.sync_cb = on_sync;
+    esp_sntp_set_sync_interval(TIME_SYNC_INTERVAL_MS);
+    esp_err_t err = esp_netif_sntp_init(&config);
+    s_started = (err == ESP_OK);
+    return err;
+}
+
+bool time_sync_wait(uint32_t timeout_ms)
+{
+    return time_sync_is_synced() || (s_started && esp_netif_sntp_sync_wait(pdMS_TO_TICKS(timeout_ms)) == ESP_OK);
+}
+
+bool time_sync_is_synced(void)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool synced = s_model.synced;
+    portEXIT_CRITICAL(&s_lock);
+    return synced;
+}
+
+bool time_sync_is_valid(void)
+{
+    return time_sync_now_us() >= TIME_SYNC_VALID_AFTER_S * 1000000LL;
+}
+
+int64_t time_sync_epoch_us(int64_t timer_us)
+{
+    portENTER_CRITICAL(&s_lock);
+    bool synced = s_model.synced;
+    int64_t epoch_us = synced ? model_epoch_us(&s_model, timer_us) : 0;
+    portEXIT_CRITICAL(&s_lock);
+    // Not synced yet: shift the system clock back by the age of the instant
+    return synced ? epoch_us : system_now_us() - (esp_timer_get_time() - timer_us);
+}
+
+int64_t time_sync_now_us(void)
+{
+    return time_sync_epoch_us(esp_timer_get_time());
+}
+
+void time_sync_get_stats(time_sync_stats_t *out)
+{
+    portENTER_CRITICAL(&s_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Wall clock for sample timestamps. esp_timer is the monotonic time base,
+ * SNTP only feeds an offset model on top of it:
+ *
+ *   epoch(t) = anchor_epoch + dt + dt * drift + slew * min(dt, TIME_SYNC_SLEW_MS) / TIME_SYNC_SLEW_MS
+ *   dt = t - anchor_timer
+ *
+ * Every sync re-anchors the model at its prediction for the sync instant, so
+ * the clock never jumps. The error of that prediction is slewed in over
+ * TIME_SYNC_SLEW_MS and the part of it that built up since the previous sync
+ * corrects the drift estimate of the local oscillator. Only the first sync and
+ * errors above TIME_SYNC_STEP_MS step the clock.
+ *
+ * Until the first sync of this boot, times come from the system clock, which
+ * keeps running through deep sleep and may still be unset (1970) after a cold boot.
+ */
+
+/**
+ * @brief State of the offset model
+ */
+typedef struct
+{
+    uint32_t syncs;        // SNTP updates received
+    uint32_t steps;        // Of those, the ones that stepped the clock
+    int64_t last_error_us; // Received - predicted time at the last sync
+    int32_t drift_ppb;     // Rate of the wall clock relative to esp_timer, minus one
+    int64_t last_sync_us;  // esp_timer time of the last sync, 0 if none
+} time_sync_stats_t;
+
+/**
+ * @brief Start periodic SNTP sync with TIME_SYNC_SERVER every TIME_SYNC_INTERVAL_MS.
+ * Call it once esp_netif is initialized, requests are retried until the network is up.
+ * Later calls do nothing.
+ * @return ESP_OK on success, error from esp_netif_sntp_init() otherwise.
+ */
+esp_err_t time_sync_start(void);
+
+/**
+ * @brief Wait for the first sync of this boot.
+ * @param timeout_ms Maximum time to wait
+ * @return true If the clock is synced.
+ */
+bool time_sync_wait(uint32_t timeout_ms);
+
+/**
+ * @brief Whether SNTP updated the model since boot.
+ */
+bool time_sync_is_synced(void);
+
+/**
+ * @brief Whether the clock holds a plausible date, synced in this boot or kept by the RTC.
+ */
+bool time_sync_is_valid(void);
+
+/**
+ * @brief Unix time in microseconds of an esp_timer instant, safe from any task.
+ * @param timer_us Time in us since boot, as returned by esp_timer_get_time()
+ */
+int64_t time_sync_epoch_us(int64_t timer_us);
+
+/**
+ * @brief Current Unix time in microseconds.
+ */
+int64_t time_sync_now_us(void);
+
+/**
+ * @brief Copy the model state, safe from any task.
+ * @param out Destination
+ */
+void time_sync_get_stats(time_sync_stats_t *out);
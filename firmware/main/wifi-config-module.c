@@ -1,116 +1,442 @@
 // Modular Programing
 #include <stdio.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "freertos/event_groups.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
-#include "nvs_flash.h"
 #include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "nvs.h"
+#include "config.h"
+#include "time-sync.h"
+#include "wifi-config-module.h"
 
-#define ESP_WIFI_SSID "B9 106"
-#define ESP_WIFI_PSW "B91062005@"
-#define ESP_WIFI_MAX_RETRY 3
-#define ESP_WIFI_FAIL_BIT BIT0
-#define ESP_WIFI_CONNECTED_BIT BIT1
+#define WIFI_NVS_NAMESPACE "wifi_cache"
+#define WIFI_NVS_KEY_AP "ap"
 
-static const char *TAG_w = "wifi";
-static int s_retry_num = 0;
+/**
+ * @brief Last access point and DHCP lease, kept in NVS for fast boots and reconnects
+ */
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t channel;
+    esp_netif_ip_info_t ip_info; // Zero until the first DHCP lease
+    int64_t leased_at_s;         // Unix time DHCP handed out ip_info, 0 while it is not known
+    uint32_t leased_at_start;    // starts when DHCP handed out ip_info
+    uint32_t starts;             // wifi_manager_start() calls, a clock that survives power-off
+} wifi_ap_cache_t;
+
+static EventGroupHandle_t s_wifi_event_group;
+static esp_netif_t *s_netif;
+static esp_timer_handle_t s_retry_timer;
+static wifi_state_cb_t s_on_state_change;
+static wifi_ap_cache_t s_ap_cache;
+static bool s_ap_cache_valid;
+static bool s_static_ip;        // DHCP client stopped, the cached lease is in use
+static int64_t s_leased_at_us;  // esp_timer time DHCP handed out the cached lease, 0 if it came from an earlier start
+static volatile bool s_stopping;
+static int64_t s_disconnected_at_us;
+static wifi_manager_stats_t s_stats;
+// Retries run in the esp_timer task, events in the event loop task
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// ============================== AP Cache ==============================
+static void ap_cache_load(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK)
+    {
+        return;
+    }
+    size_t len = sizeof(s_ap_cache);
+    s_ap_cache_valid = (nvs_get_blob(nvs, WIFI_NVS_KEY_AP, &s_ap_cache, &len) == ESP_OK && len == sizeof(s_ap_cache));
+    nvs_close(nvs);
+}
+
+static void ap_cache_save(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+    {
+        nvs_set_blob(nvs, WIFI_NVS_KEY_AP, &s_ap_cache, sizeof(s_ap_cache));
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
+
+static void ap_cache_store(const uint8_t *bssid, uint8_t channel, const esp_netif_ip_info_t *ip_info)
+{
+    wifi_ap_cache_t cache = s_ap_cache;
+    if (bssid)
+    {
+        memcpy(cache.bssid, bssid, 6);
+        cache.channel = channel;
+    }
+    if (ip_info)
+    {
+        cache.ip_info = *ip_info;
+        cache.leased_at_s = 0;
+        cache.leased_at_start = cache.starts;
+        s_leased_at_us = esp_timer_get_time();
+    }
+    if (cache.leased_at_s == 0 && s_leased_at_us != 0 && time_sync_is_valid())
+    {
+        // DHCP usually answers before SNTP, date the lease back once the clock is set
+        cache.leased_at_s = (time_sync_now_us() - (esp_timer_get_time() - s_leased_at_us)) / 1000000;
+    }
+    if (s_ap_cache_valid && memcmp(&cache, &s_ap_cache, sizeof(cache)) == 0)
+    {
+        return; // Unchanged, save a flash write
+    }
+    if (bssid == NULL && !s_ap_cache_valid)
+    {
+        return; // A lease without an AP is of no use
+    }
+    s_ap_cache = cache;
+    s_ap_cache_valid = true;
+    ap_cache_save();
+}
+
+/**
+ * @brief Whether the cached lease may still be used.
+ * The static IP bypasses DHCP, so the server never sees it renewed. The lease is used up to
+ * WIFI_LEASE_MAX_AGE_S after DHCP gave it, timed with esp_timer within the same start and with
+ * the wall clock across starts. Before SNTP has set the clock after a power-on, the age is
+ * unknown and the lease is used for WIFI_LEASE_MAX_STARTS starts instead.
+ */
+static bool lease_valid(void)
+{
+    if (!s_ap_cache_valid || s_ap_cache.ip_info.ip.addr == 0)
+    {
+        return false;
+    }
+    int64_t age_s;
+    if (s_leased_at_us != 0)
+    {
+        age_s = (esp_timer_get_time() - s_leased_at_us) / 1000000;
+    }
+    else if (s_ap_cache.leased_at_s != 0 && time_sync_is_valid())
+    {
+        age_s = time_sync_now_us() / 1000000 - s_ap_cache.leased_at_s;
+    }
+    else
+    {
+        return s_ap_cache.starts - s_ap_cache.leased_at_start <= WIFI_LEASE_MAX_STARTS;
+    }
+    return age_s >= 0 && age_s < WIFI_LEASE_MAX_AGE_S;
+}
+
+/**
+ * @brief Use the cached lease instead of asking the DHCP server, saves a few hundred ms per association.
+ * Called once the link is up, esp_netif then posts IP_EVENT_STA_GOT_IP right away.
+ */
+static void static_ip_apply(void)
+{
+    if (s_static_ip)
+    {
+        return; // Still configured from the previous association
+    }
+    if (esp_netif_dhcpc_stop(s_netif) != ESP_OK)
+    {
+        return;
+    }
+    if (esp_netif_set_ip_info(s_netif, &s_ap_cache.ip_info) != ESP_OK)
+    {
+        esp_netif_dhcpc_start(s_netif);
+        return;
+    }
+    s_static_ip = true;
+}
+
+/**
+ * @brief Go back to DHCP, the cached lease may be stale if the AP could not be reached directly.
+ */
+static void static_ip_release(void)
+{
+    if (s_static_ip)
+    {
+        esp_netif_dhcpc_start(s_netif);
+        s_static_ip = false;
+    }
+}
+
+// ============================== Connection ==============================
+/**
+ * @brief Start one association attempt.
+ * The first WIFI_FAST_RECONNECT_ATTEMPTS attempts go straight to the cached BSSID and
+ * channel, later ones fall back to a full scan in case the AP moved.
+ */
+static void wifi_connect_attempt(void)
+{
+    wifi_config_t wifi_network_cfg = {
+        .sta = {
+            .ssid = ESP_WIFI_STA_SSID,
+            .password = ESP_WIFI_STA_PSW}};
+    portENTER_CRITICAL(&s_stats_lock);
+    uint32_t attempt = ++s_stats.attempts;
+    portEXIT_CRITICAL(&s_stats_lock);
+
+    bool fast = s_ap_cache_valid && attempt <= WIFI_FAST_RECONNECT_ATTEMPTS;
+    if (fast)
+    {
+        wifi_network_cfg.sta.bssid_set = true;
+        memcpy(wifi_network_cfg.sta.bssid, s_ap_cache.bssid, 6);
+        wifi_network_cfg.sta.channel = s_ap_cache.channel;
+    }
+    else
+    {
+        static_ip_release();
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &wifi_network_cfg);
+
+    ESP_LOGI(TAG_w, "Connecting (attempt %lu, %s)", (unsigned long)attempt, fast ? "cached AP" : "full scan");
+    esp_wifi_connect();
+}
+
+static void retry_timer_cb(void *arg)
+{
+    wifi_connect_attempt();
+}
 
-EventGroupHandle_t s_wifi_event_group;
+/**
+ * @brief Schedule the next attempt after a jittered exponential backoff.
+ * The delay doubles with every failed attempt up to WIFI_BACKOFF_MAX_MS, and half of it
+ * is randomized so a fleet of nodes does not hammer the AP in lockstep.
+ */
+static void schedule_retry(void)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    uint32_t attempts = s_stats.attempts;
+    portEXIT_CRITICAL(&s_stats_lock);
 
+    uint32_t shift = (attempts > 16) ? 16 : attempts;
+    uint64_t delay_ms = (uint64_t)WIFI_BACKOFF_BASE_MS << shift;
+    if (delay_ms > WIFI_BACKOFF_MAX_MS)
+    {
+        delay_ms = WIFI_BACKOFF_MAX_MS;
+    }
+    delay_ms = delay_ms / 2 + esp_random() % (delay_ms / 2 + 1);
+
+    ESP_LOGI(TAG_w, "Retry in %llu ms", delay_ms);
+    esp_timer_stop(s_retry_timer);
+    esp_timer_start_once(s_retry_timer, delay_ms * 1000);
+}
+
+/**
+ * @brief WiFi Event Handler Functions
+ */
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START)
     {
         ESP_LOGI(TAG_w, "WiFi started, connecting ...");
-        esp_wifi_connect();
+        wifi_connect_attempt();
+    }
+    else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED)
+    {
+        wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
+        ap_cache_store(event->bssid, event->channel, NULL);
+#if WIFI_FAST_BOOT_STATIC_IP
+        portENTER_CRITICAL(&s_stats_lock);
+        uint32_t attempts = s_stats.attempts;
+        portEXIT_CRITICAL(&s_stats_lock);
+        if (attempts <= WIFI_FAST_RECONNECT_ATTEMPTS && lease_valid())
+        {
+            static_ip_apply();
+        }
+        else
+        {
+            static_ip_release();
+        }
+#endif
     }
     else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED)
     {
-        if (s_retry_num < ESP_WIFI_MAX_RETRY)
+        EventBits_t bits = xEventGroupClearBits(s_wifi_event_group, ESP_WIFI_CONNECTED_BIT);
+        if (s_stopping)
         {
-            esp_wifi_connect();
-            ESP_LOGI(TAG_w, "Retry to connect (%d/%d)", s_retry_num, ESP_WIFI_MAX_RETRY);
-            s_retry_num++;
+            return;
+        }
+        if (bits & ESP_WIFI_CONNECTED_BIT)
+        {
+            // Connection lost, this starts a new reconnect cycle
+            wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
+            ESP_LOGW(TAG_w, "Disconnected, reason %d", event->reason);
+            portENTER_CRITICAL(&s_stats_lock);
+            s_stats.disconnects++;
+            s_stats.attempts = 0;
+            portEXIT_CRITICAL(&s_stats_lock);
+            s_disconnected_at_us = esp_timer_get_time();
+            if (s_on_state_change)
+            {
+                s_on_state_change(false);
+            }
+            // The first attempt goes out right away over the cached AP
+            wifi_connect_attempt();
         }
         else
         {
-            ESP_LOGI(TAG_w, "Failed to connect after %d attempts", ESP_WIFI_MAX_RETRY);
-            xEventGroupSetBits(s_wifi_event_group, ESP_WIFI_FAIL_BIT);
+            schedule_retry();
         }
     }
     else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP)
     {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
-        ESP_LOGI(TAG_w, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
-        s_retry_num = 0;
+        // s_disconnected_at_us is 0 until the first loss, so the first value is boot to IP
+        int64_t reconnect_ms = (esp_timer_get_time() - s_disconnected_at_us) / 1000;
+
+        portENTER_CRITICAL(&s_stats_lock);
+        uint32_t attempts = s_stats.attempts;
+        s_stats.last_reconnect_ms = reconnect_ms;
+        s_stats.total_reconnect_ms += reconnect_ms;
+        s_stats.reconnects++;
+        if (reconnect_ms > s_stats.max_reconnect_ms)
+        {
+            s_stats.max_reconnect_ms = reconnect_ms;
+        }
+        s_stats.attempts = 0;
+        portEXIT_CRITICAL(&s_stats_lock);
+
+        ESP_LOGI(TAG_w, "Got IP: " IPSTR " after %lld ms (%lu attempts, %s)", IP2STR(&event->ip_info.ip), reconnect_ms,
+                 (unsigned long)attempts, s_static_ip ? "cached lease" : "DHCP");
+        if (!s_static_ip)
+        {
+            ap_cache_store(NULL, 0, &event->ip_info);
+        }
+
         xEventGroupSetBits(s_wifi_event_group, ESP_WIFI_CONNECTED_BIT);
+        if (s_on_state_change)
+        {
+            s_on_state_change(true);
+        }
     }
 }
 
-static esp_err_t wifi_init()
+/**
+ * @brief Bring up netif, the event loop and the Wi-Fi driver in station mode.
+ * @return ESP_OK, or the error of the first step that failed.
+ */
+static esp_err_t wifi_driver_start(void)
 {
-    s_wifi_event_group = xEventGroupCreate();
-
-    ESP_ERROR_CHECK(esp_netif_init());
+    const esp_timer_create_args_t retry_timer_args = {
+        .callback = retry_timer_cb,
+        .name = "wifi_retry"};
+    esp_err_t err = esp_timer_create(&retry_timer_args, &s_retry_timer);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
 
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    err = esp_netif_init();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    // Someone else may have created the default loop already
+    err = esp_event_loop_create_default();
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+    {
+        return err;
+    }
+    s_netif = esp_netif_create_default_wifi_sta();
+    if (s_netif == NULL)
+    {
+        return ESP_FAIL;
+    }
 
     wifi_init_config_t wifi_driver_cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&wifi_driver_cfg));
+    err = esp_wifi_init(&wifi_driver_cfg);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
 
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, &instance_got_ip));
-
-    wifi_config_t wifi_network_cfg = {
-        .sta = {
-            .ssid = ESP_WIFI_SSID,
-            .password = ESP_WIFI_PSW}};
-
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_network_cfg));
-    ESP_ERROR_CHECK(esp_wifi_start());
-
-    ESP_LOGI(TAG_w, "wifi_init finished.");
-
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, ESP_WIFI_CONNECTED_BIT | ESP_WIFI_FAIL_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-    if (bits & ESP_WIFI_CONNECTED_BIT)
+    err = esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, &instance_any_id);
+    if (err != ESP_OK)
     {
-        ESP_LOGI(TAG_w, "Connected to SSID: %s", ESP_WIFI_SSID);
-        return ESP_OK;
+        return err;
     }
-    else if (bits & ESP_WIFI_FAIL_BIT)
+    err = esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL, &instance_got_ip);
+    if (err != ESP_OK)
     {
-        ESP_LOGI(TAG_w, "Failed to connect to SSID: %s", ESP_WIFI_SSID);
-        return ESP_FAIL;
+        return err;
     }
-    else
+
+    err = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (err != ESP_OK)
     {
-        ESP_LOGI(TAG_w, "Unexpected event");
-        return ESP_FAIL;
+        return err;
     }
+    return esp_wifi_start();
 }
 
-void app_main()
+esp_err_t wifi_manager_start(wifi_state_cb_t on_state_change)
 {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    s_on_state_change = on_state_change;
+#if STATIC_ALLOCATION
+    static StaticEventGroup_t s_wifi_event_group_buf;
+    s_wifi_event_group = xEventGroupCreateStatic(&s_wifi_event_group_buf);
+#else
+    s_wifi_event_group = xEventGroupCreate();
+    if (s_wifi_event_group == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    ap_cache_load();
+    if (s_ap_cache_valid)
     {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+        s_ap_cache.starts++;
+        ap_cache_save();
     }
-    ESP_ERROR_CHECK(ret);
 
-    ret = wifi_init();
-    if (ret == ESP_OK)
+    esp_err_t err = wifi_driver_start();
+    if (err != ESP_OK)
     {
-        ESP_LOGI(TAG_w, "WiFi initialization succesful");
+        ESP_LOGE(TAG_w, "wifi_manager_start failed: %s", esp_err_to_name(err));
+        return err;
     }
-    else
+    ESP_LOGI(TAG_w, "wifi_manager_start finished.");
+    return ESP_OK;
+}
+
+bool wifi_manager_is_connected(void)
+{
+    if (s_wifi_event_group == NULL)
+    {
+        return false; // Not started or the start failed
+    }
+    EventBits_t bits = xEventGroupGetBits(s_wifi_event_group);
+    return (bits & ESP_WIFI_CONNECTED_BIT);
+}
+
+bool wifi_manager_wait_connected(uint32_t timeout_ms)
+{
+    if (s_wifi_event_group == NULL)
     {
-        ESP_LOGE(TAG_w, "WiFi initialization failed");
+        return false;
     }
-}
\ No newline at end of file
+    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, ESP_WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & ESP_WIFI_CONNECTED_BIT);
+}
+
+void wifi_manager_stop(void)
+{
+    s_stopping = true;
+    esp_timer_stop(s_retry_timer);
+    esp_wifi_stop();
+    ap_cache_store(NULL, 0, NULL); // Dates the lease if SNTP set the clock since DHCP gave it
+}
+
+void wifi_manager_get_stats(wifi_manager_stats_t *out)
+{
+    portENTER_CRITICAL(&s_stats_lock);
+    *out = s_stats;
+    portEXIT_CRITICAL(&s_stats_lock);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/**
+ * @brief Called from the Wi-Fi event task whenever the station gets or loses its IP.
+ */
+typedef void (*wifi_state_cb_t)(bool connected);
+
+/**
+ * @brief Reconnect statistics
+ */
+typedef struct
+{
+    uint32_t disconnects;       // Connection losses since boot
+    uint32_t attempts;          // esp_wifi_connect() calls since the last loss
+    int64_t last_reconnect_ms;  // Time from the last loss to getting an IP again
+    int64_t max_reconnect_ms;
+    int64_t total_reconnect_ms; // Sum over all reconnects, total / reconnects = mean
+    uint32_t reconnects;
+} wifi_manager_stats_t;
+
+/**
+ * @brief Start the station and the event-driven connection manager, returns without waiting for a connection.
+ * Lost connections are retried forever with jittered exponential backoff. The first
+ * attempts reuse the BSSID and channel cached in NVS, which skips the full channel scan,
+ * and with WIFI_FAST_BOOT_STATIC_IP also the last DHCP lease, which skips DHCP. The lease
+ * is reused for WIFI_LEASE_MAX_AGE_S after DHCP handed it out, or for WIFI_LEASE_MAX_STARTS
+ * starts while the clock is unset after a power-on, then DHCP runs again. Every start
+ * counts itself in NVS.
+ * NVS must be initialized before.
+ * @param on_state_change Called on every connect/disconnect, may be NULL
+ * @return ESP_OK on success, otherwise the error of the first netif, event loop or driver call that failed.
+ * The station is not running then and wifi_manager_is_connected() stays false.
+ */
+esp_err_t wifi_manager_start(wifi_state_cb_t on_state_change);
+
+/**
+ * @brief Check current Wi-Fi connection status.
+ * @return true  If the station is connected and has an IP.
+ * @return false If Wi-Fi is disconnected.
+ */
+bool wifi_manager_is_connected(void);
+
+/**
+ * @brief Block until the station has an IP, for callers that have nothing else to do meanwhile.
+ * @param timeout_ms Maximum time to wait
+ * @return true if connected, false on timeout.
+ */
+bool wifi_manager_wait_connected(uint32_t timeout_ms);
+
+/**
+ * @brief Stop the station and all pending retries, e.g. before deep sleep.
+ */
+void wifi_manager_stop(void);
+
+/**
+ * @brief Copy the reconnect statistics.
+ * @param out Destination
+ */
+void wifi_manager_get_stats(wifi_manager_stats_t *out);
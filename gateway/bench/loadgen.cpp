@@ -0,0 +1,397 @@
+/*
+ * Load generator for POST /api/data, against the gateway or the Flask server.
+ *
+ * Every thread runs an epoll loop over its share of --connections keep-alive
+ * connections. Each connection acts as a device that uploads a batch of
+ * --batch samples and sends the next one as soon as the answer arrives
+ * (closed loop), so the result is the throughput the server sustains with
+ * that many devices in flight and the latency it takes for it.
+ *
+ *   ingest-loadgen --port 5001 --connections 256 --batch 50 --duration 10
+ *
+ * Samples are written on channel --channel (default 255, like the Python
+ * benchmarks), remove them afterwards with DELETE FROM data WHERE channel = 255.
+ */
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define LOADGEN_MAX_EVENTS 256
+#define LOADGEN_SAMPLE_PERIOD_US 500000 // Spacing of the samples in a batch, 2 Hz like the firmware default
+
+struct options
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 5001;
+    unsigned connections = 64;
+    unsigned threads = 1;
+    unsigned batch = 50;
+    double duration_s = 10;
+    unsigned channel = 255;
+    bool frames = false; // Binary telemetry frames instead of JSON
+};
+
+struct result
+{
+    std::vector<uint32_t> latencies_us;
+    uint64_t ok = 0;
+    uint64_t busy = 0;  // 503, the server pushed back
+    uint64_t other = 0; // Any other status
+    uint64_t errors = 0; // Connection failures and resets
+};
+
+struct client
+{
+    int fd = -1;
+    std::string out;
+    size_t out_sent = 0;
+    std::string in;
+    int64_t sent_at_us = 0;
+};
+
+static int64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static int64_t epoch_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+static void put_varint(std::string &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out += (char)(value | 0x80);
+        value >>= 7;
+    }
+    out += (char)value;
+}
+
+template <typename T>
+static void put_le(std::string &out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); i++)
+    {
+        out += (char)((uint64_t)value >> (8 * i));
+    }
+}
+
+/**
+ * @brief Build one upload request, samples end at the current time like a real batch.
+ */
+static void build_request(const options &opt, uint32_t device_id, std::string &out)
+{
+    int64_t base_us = epoch_us() - (int64_t)(opt.batch - 1) * LOADGEN_SAMPLE_PERIOD_US;
+    std::string body;
+    if (opt.frames)
+    {
+        // Version 2 frame with us times, see firmware/main/telemetry-frame.h
+        put_le<uint8_t>(body, 0xB1);
+        put_le<uint8_t>(body, 2);
+        put_le<uint16_t>(body, (uint16_t)opt.batch);
+        put_le<uint32_t>(body, device_id);
+        put_le<int64_t>(body, base_us);
+        put_le<uint32_t>(body, LOADGEN_SAMPLE_PERIOD_US);
+        put_le<uint8_t>(body, 0x10);
+        put_le<uint8_t>(body, 69);
+        put_le<uint8_t>(body, (uint8_t)opt.channel);
+        put_le<uint8_t>(body, 0x01);
+        put_le<uint16_t>(body, 100);
+        for (unsigned i = 1; i < opt.batch; i++)
+        {
+            put_varint(body, (i & 1) ? 2 : 1); // Zigzag +1, -1: counts alternate 100, 101
+        }
+    }
+    else
+    {
+        char sample[160];
+        body += '[';
+        for (unsigned i = 0; i < opt.batch; i++)
+        {
+            int len = snprintf(sample, sizeof(sample),
+                               "%s{\"lux\":%.2f,\"raw\":%u,\"mode\":16,\"mtreg\":69,\"ch\":%u,\"ts_us\":%lld}",
+                               i ? "," : "", (100 + (i & 1)) / 1.2, 100 + (i & 1), opt.channel,
+                               (long long)(base_us + (int64_t)i * LOADGEN_SAMPLE_PERIOD_US));
+            body.append(sample, (size_t)len);
+        }
+        body += ']';
+    }
+    out = "POST /api/data HTTP/1.1\r\nHost: " + opt.host + "\r\nContent-Type: " +
+          (opt.frames ? "application/vnd.lightsense.frame" : "application/json") +
+          "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+static bool connect_client(const options &opt, int epoll_fd, client &c)
+{
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(opt.port);
+    inet_pton(AF_INET, opt.host.c_str(), &addr.sin_addr);
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(c.fd, (sockaddr *)&addr, sizeof(addr)) && errno != EINPROGRESS)
+    {
+        close(c.fd);
+        c.fd = -1;
+        return false;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = &c;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c.fd, &ev);
+    c.in.clear();
+    return true;
+}
+
+static void reconnect(const options &opt, int epoll_fd, client &c, result &res)
+{
+    close(c.fd);
+    c.out_sent = 0;
+    if (!connect_client(opt, epoll_fd, c))
+    {
+        res.errors++;
+    }
+}
+
+/**
+ * @brief Parse a complete response at the start of in.
+ * @return Bytes it takes, 0 if it has not fully arrived
+ */
+static size_t parse_response(const std::string &in, int &status, bool &close_after)
+{
+    size_t head_end = in.find("\r\n\r\n");
+    if (head_end == std::string::npos || in.size() < 12)
+    {
+        return 0;
+    }
+    status = atoi(in.c_str() + 9);
+    size_t length = 0;
+    close_after = false;
+    size_t pos = in.find("\r\n") + 2;
+    while (pos < head_end)
+    {
+        size_t eol = in.find("\r\n", pos);
+        std::string line = in.substr(pos, eol - pos);
+        std::transform(line.begin(), line.end(), line.begin(), ::tolower);
+        if (line.compare(0, 15, "content-length:") == 0)
+        {
+            length = strtoul(line.c_str() + 15, nullptr, 10);
+        }
+        else if (line.compare(0, 11, "connection:") == 0 && line.find("close") != std::string::npos)
+        {
+            close_after = true;
+        }
+        pos = eol + 2;
+    }
+    if (in.size() < head_end + 4 + length)
+    {
+        return 0;
+    }
+    return head_end + 4 + length;
+}
+
+static void run_thread(const options &opt, unsigned first_device, unsigned count, int64_t end_us, result &res)
+{
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<client> clients(count);
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!connect_client(opt, epoll_fd, clients[i]))
+        {
+            res.errors++;
+            continue;
+        }
+        build_request(opt, first_device + i, clients[i].out);
+        clients[i].sent_at_us = now_us();
+    }
+
+    epoll_event events[LOADGEN_MAX_EVENTS];
+    while (now_us() < end_us)
+    {
+        int n = epoll_wait(epoll_fd, events, LOADGEN_MAX_EVENTS, 100);
+        for (int i = 0; i < n; i++)
+        {
+            client &c = *(client *)events[i].data.ptr;
+            unsigned device = first_device + (unsigned)(&c - clients.data());
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                res.errors++;
+                reconnect(opt, epoll_fd, c, res);
+                build_request(opt, device, c.out);
+                c.sent_at_us = now_us();
+                continue;
+            }
+            if ((events[i].events & EPOLLOUT) && c.out_sent < c.out.size())
+            {
+                ssize_t sent = send(c.fd, c.out.data() + c.out_sent, c.out.size() - c.out_sent, MSG_NOSIGNAL);
+                if (sent > 0)
+                {
+                    c.out_sent += (size_t)sent;
+                }
+            }
+            if (events[i].events & EPOLLIN)
+            {
+                char buf[16384];
+                ssize_t got = recv(c.fd, buf, sizeof(buf), 0);
+                if (got <= 0)
+                {
+                    if (got == 0 || (errno != EAGAIN && errno != EINTR))
+                    {
+                        res.errors++;
+                        reconnect(opt, epoll_fd, c, res);
+                        build_request(opt, device, c.out);
+                        c.sent_at_us = now_us();
+                    }
+                    continue;
+                }
+                c.in.append(buf, (size_t)got);
+                int status;
+                bool close_after;
+                size_t used = parse_response(c.in, status, close_after);
+                if (used == 0)
+                {
+                    continue;
+                }
+                c.in.erase(0, used);
+                res.latencies_us.push_back((uint32_t)std::min<int64_t>(now_us() - c.sent_at_us, UINT32_MAX));
+                (status == 200 ? res.ok : status == 503 ? res.busy : res.other)++;
+                if (close_after)
+                {
+                    reconnect(opt, epoll_fd, c, res);
+                }
+                build_request(opt, device, c.out);
+                c.out_sent = 0;
+                c.sent_at_us = now_us();
+            }
+            // Only wait for EPOLLOUT while a request is partly sent
+            epoll_event ev = {};
+            ev.events = EPOLLIN | (c.out_sent < c.out.size() ? (uint32_t)EPOLLOUT : 0u);
+            ev.data.ptr = &c;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.fd, &ev);
+        }
+    }
+    for (client &c : clients)
+    {
+        if (c.fd >= 0)
+        {
+            close(c.fd);
+        }
+    }
+    close(epoll_fd);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [--host IP] [--port N] [--connections N] [--threads N] [--batch N]\n"
+            "          [--duration S] [--channel N] [--frames]\n",
+            name);
+}
+
+int main(int argc, char **argv)
+{
+    options opt;
+    static const option long_options[] = {
+        {"host", required_argument, nullptr, 'h'},    {"port", required_argument, nullptr, 'p'},
+        {"connections", required_argument, nullptr, 'c'}, {"threads", required_argument, nullptr, 't'},
+        {"batch", required_argument, nullptr, 'b'},   {"duration", required_argument, nullptr, 'd'},
+        {"channel", required_argument, nullptr, 'C'}, {"frames", no_argument, nullptr, 'f'},
+        {nullptr, 0, nullptr, 0},
+    };
+    int ch;
+    while ((ch = getopt_long(argc, argv, "", long_options, nullptr)) != -1)
+    {
+        switch (ch)
+        {
+        case 'h':
+            opt.host = optarg;
+            break;
+        case 'p':
+            opt.port = (uint16_t)atoi(optarg);
+            break;
+        case 'c':
+            opt.connections = (unsigned)atoi(optarg);
+            break;
+        case 't':
+            opt.threads = (unsigned)atoi(optarg);
+            break;
+        case 'b':
+            opt.batch = (unsigned)atoi(optarg);
+            break;
+        case 'd':
+            opt.duration_s = atof(optarg);
+            break;
+        case 'C':
+            opt.channel = (unsigned)atoi(optarg);
+            break;
+        case 'f':
+            opt.frames = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (opt.connections == 0 || opt.threads == 0 || opt.batch == 0 || opt.batch > 65535 || opt.channel > 255)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    opt.threads = std::min(opt.threads, opt.connections);
+
+    std::vector<result> results(opt.threads);
+    std::vector<std::thread> threads;
+    int64_t start_us = now_us();
+    int64_t end_us = start_us + (int64_t)(opt.duration_s * 1e6);
+    for (unsigned t = 0; t < opt.threads; t++)
+    {
+        unsigned first = opt.connections * t / opt.threads;
+        unsigned last = opt.connections * (t + 1) / opt.threads;
+        threads.emplace_back(run_thread, std::cref(opt), first, last - first, end_us, std::ref(results[t]));
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    double elapsed_s = (now_us() - start_us) / 1e6;
+
+    result total;
+    for (result &r : results)
+    {
+        total.latencies_us.insert(total.latencies_us.end(), r.latencies_us.begin(), r.latencies_us.end());
+        total.ok += r.ok;
+        total.busy += r.busy;
+        total.other += r.other;
+        total.errors += r.errors;
+    }
+    std::vector<uint32_t> &lat = total.latencies_us;
+    std::sort(lat.begin(), lat.end());
+    auto percentile = [&lat](double p) { return lat.empty() ? 0.0 : lat[(size_t)(p * (lat.size() - 1))] / 1000.0; };
+
+    printf("%6s %6s %6s %10s %10s %8s %8s %8s %8s %8s %8s\n", "conns", "batch", "format", "uploads/s", "samples/s",
+           "503", "other", "errors", "p50 ms", "p99 ms", "max ms");
+    printf("%6u %6u %6s %10.0f %10.0f %8llu %8llu %8llu %8.2f %8.2f %8.2f\n", opt.connections, opt.batch,
+           opt.frames ? "frame" : "json", total.ok / elapsed_s, total.ok * opt.batch / elapsed_s,
+           (unsigned long long)total.busy, (unsigned long long)total.other, (unsigned long long)total.errors,
+           percentile(0.50), percentile(0.99), percentile(1.0));
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <cerrno>
+#include <cstdlib>
+#include <fstream>
+#include "config.h"
+
+static std::string trim(const std::string &s)
+{
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+    {
+        return "";
+    }
+    size_t end = s.find_last_not_of(" \t\r");
+    return s.substr(begin, end - begin + 1);
+}
+
+/**
+ * @brief Export the KEY = value lines of a .env file that are not set yet.
+ * Follows the python-dotenv basics: # starts a comment outside quotes, values may be quoted.
+ */
+static void load_dotenv(const char *path)
+{
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        if (line.compare(0, 7, "export ") == 0)
+        {
+            line = trim(line.substr(7));
+        }
+        size_t eq = line.find('=');
+        if (eq == std::string::npos)
+        {
+            continue;
+        }
+        std::string key = trim(line.substr(0, eq));
+        std::string value = trim(line.substr(eq + 1));
+        if (!value.empty() && (value[0] == '"' || value[0] == '\''))
+        {
+            size_t close = value.find(value[0], 1);
+            value = value.substr(1, close == std::string::npos ? std::string::npos : close - 1);
+        }
+        else
+        {
+            size_t comment = value.find(" #");
+            value = trim(value.substr(0, comment));
+        }
+        setenv(key.c_str(), value.c_str(), 0);
+    }
+}
+
+static bool read_string(const char *name, std::string &out)
+{
+    const char *value = getenv(name);
+    if (value)
+    {
+        out = value;
+    }
+    return true;
+}
+
+template <typename T>
+static bool read_number(const char *name, T &out, double min, double max, std::string &error)
+{
+    const char *value = getenv(name);
+    if (!value || !*value)
+    {
+        return true;
+    }
+    char *end;
+    errno = 0;
+    double parsed = strtod(value, &end);
+    if (errno || *end || parsed < min || parsed > max)
+    {
+        error = std::string(name) + " must be a number from " + std::to_string(min) + " to " + std::to_string(max);
+        return false;
+    }
+    out = (T)parsed;
+    return true;
+}
+
+bool gateway_config_load(gateway_config &config, std::string &error)
+{
+    load_dotenv(".env");
+
+    std::string durability = "queued";
+    read_string("INGEST_DURABILITY", durability);
+    if (durability != "queued" && durability != "committed")
+    {
+        error = "INGEST_DURABILITY must be queued or committed";
+        return false;
+    }
+    config.durability_committed = durability == "committed";
+    const char *dry_run = getenv("GATEWAY_DRY_RUN");
+    config.dry_run = dry_run && dry_run[0] && dry_run[0] != '0';
+
+    return read_string("DB_HOST", config.db_host) && read_string("DB_USER", config.db_user) &&
+           read_string("DB_PASSWORD", config.db_password) && read_string("DB_NAME", config.db_name) &&
+           read_number("DB_PORT", config.db_port, 1, 65535, error) &&
+           read_number("INGEST_QUEUE_MAX_ROWS", config.queue_max_rows, 1, 1e9, error) &&
+           read_number("INGEST_FLUSH_ROWS", config.flush_rows, 1, 1e6, error) &&
+           read_number("INGEST_FLUSH_MS", config.flush_ms, 0, 60000, error) &&
+           read_number("INGEST_COMMIT_TIMEOUT_S", config.commit_timeout_s, 0, 3600, error) &&
+           read_number("INGEST_RETRY_AFTER_S", config.retry_after_s, 0, 86400, error) &&
+           read_number("INGEST_EXIT_DRAIN_S", config.exit_drain_s, 0, 3600, error) &&
+           read_number("GATEWAY_PORT", config.port, 1, 65535, error) &&
+           read_number("GATEWAY_THREADS", config.threads, 0, 1024, error) &&
+           read_number("GATEWAY_MAX_BODY", config.max_body, 1024, 1 << 30, error) &&
+           read_number("GATEWAY_IDLE_TIMEOUT_S", config.idle_timeout_s, 1, 86400, error);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Gateway settings. They are read from the environment and from a .env file
+ * in the working directory, with the names and defaults the Flask server uses,
+ * so both can share one .env. Variables already set in the environment win.
+ */
+
+struct gateway_config
+{
+    // Database, same variables as server/db_pool.py
+    std::string db_host = "localhost";
+    unsigned db_port = 3306;
+    std::string db_user;
+    std::string db_password;
+    std::string db_name;
+
+    // Ingestion, same variables and meaning as server/ingest_queue.py
+    bool durability_committed = false; // INGEST_DURABILITY=committed
+    size_t queue_max_rows = 50000;
+    size_t flush_rows = 1000;
+    unsigned flush_ms = 200;
+    double commit_timeout_s = 10;
+    unsigned retry_after_s = 5;
+    double exit_drain_s = 5;
+
+    // Gateway only
+    uint16_t port = 5001;         // GATEWAY_PORT, Flask keeps 5000 for the dashboards
+    unsigned threads = 0;         // GATEWAY_THREADS, event loops, 0: one per CPU
+    size_t max_body = 1 << 20;    // GATEWAY_MAX_BODY, larger uploads get 413
+    unsigned idle_timeout_s = 60; // GATEWAY_IDLE_TIMEOUT_S, idle keep-alive connections are closed
+    bool dry_run = false;         // GATEWAY_DRY_RUN=1, parse and queue but drop the rows instead of storing them
+};
+
+/**
+ * @brief Load the settings from .env and the environment.
+ * @param config Filled in, fields without a variable keep their default
+ * @param error Set to a description of the first invalid value
+ * @return false if a value is invalid
+ */
+bool gateway_config_load(gateway_config &config, std::string &error);
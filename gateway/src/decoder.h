@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string_view>
+#include "records.h"
+
+/*
+ * Request bodies of POST /api/data, the same contract as the Flask route:
+ * a JSON array of samples and window summaries (or a single object), or one
+ * or more binary telemetry frames. Both leave device times in the rows,
+ * place_upload() turns them into stored times.
+ */
+
+#define TELEMETRY_FRAME_CONTENT_TYPE "application/vnd.lightsense.frame"
+
+/**
+ * @brief Decode a JSON upload.
+ * Samples carry "raw", "mode" and "mtreg", or only "lux", plus "ch" and "ts_us"
+ * (older firmware: "ts" in ms). Objects with "win" are window summaries.
+ * @return false if the body is malformed or a value is out of range for its column
+ */
+bool decode_json_upload(std::string_view body, upload &out);
+
+/**
+ * @brief Decode a body of binary telemetry frames, layout in firmware/main/telemetry-frame.h.
+ * The device id of the frames is stored in out.device.
+ * @return false if a frame is malformed or the frames come from different devices
+ */
+bool decode_frame_upload(std::string_view body, upload &out);
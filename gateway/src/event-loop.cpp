@@ -0,0 +1,424 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "decoder.h"
+#include "event-loop.h"
+#include "log.h"
+
+#define EVENT_LOOP_MAX_EVENTS 256
+#define EVENT_LOOP_READ_CHUNK 16384
+#define EVENT_LOOP_SWEEP_MS 1000 // Interval of the idle and commit timeout checks
+
+// Same bodies as the Flask route
+#define BODY_OK "{\"status\": \"record succes\"}"
+#define BODY_FAILED "{\"status\": \"record failed\"}"
+#define BODY_BUSY "{\"status\": \"busy\"}"
+#define BODY_NOT_COMMITTED "{\"status\": \"not committed\"}"
+
+static int64_t steady_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static int64_t epoch_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+/**
+ * @brief Same test as Flask's request.is_json.
+ */
+static bool is_json_mime_type(std::string_view mime_type)
+{
+    if (http_iequals(mime_type, "application/json"))
+    {
+        return true;
+    }
+    return mime_type.size() > 17 && http_iequals(mime_type.substr(0, 12), "application/") &&
+           http_iequals(mime_type.substr(mime_type.size() - 5), "+json");
+}
+
+event_loop::~event_loop()
+{
+    for (auto &entry : connections_)
+    {
+        close(entry.first);
+    }
+    for (int fd : {listen_fd_, epoll_fd_, commit_fd_})
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+bool event_loop::open(std::string &error)
+{
+    int one = 1;
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(config_.port);
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0 || setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) ||
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) ||
+        bind(listen_fd_, (sockaddr *)&addr, sizeof(addr)) || listen(listen_fd_, SOMAXCONN))
+    {
+        error = std::string("listen on port ") + std::to_string(config_.port) + ": " + strerror(errno);
+        return false;
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    commit_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || commit_fd_ < 0)
+    {
+        error = std::string("epoll/eventfd: ") + strerror(errno);
+        return false;
+    }
+    for (int fd : {listen_fd_, commit_fd_})
+    {
+        epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev))
+        {
+            error = std::string("epoll_ctl: ") + strerror(errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+void event_loop::accept_all()
+{
+    for (;;)
+    {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_W(TAG_HTTP, "accept: %s", strerror(errno));
+            }
+            return;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        auto c = std::make_unique<connection>();
+        c->fd = fd;
+        c->id = next_id_++;
+        c->events = EPOLLIN;
+        c->last_active_ms = steady_ms();
+        epoll_event ev = {};
+        ev.events = c->events;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev))
+        {
+            LOG_W(TAG_HTTP, "epoll_ctl: %s", strerror(errno));
+            close(fd);
+            continue;
+        }
+        connections_[fd] = std::move(c);
+    }
+}
+
+void event_loop::close_connection(connection &c)
+{
+    int fd = c.fd;
+    close(fd); // Also removes it from the epoll set
+    connections_.erase(fd);
+}
+
+void event_loop::update_interest(connection &c)
+{
+    uint32_t events = 0;
+    // Stop reading while a request waits for its commit, pipelined requests stay in the socket
+    if (!c.waiting_seq && !c.close_after_write)
+    {
+        events |= EPOLLIN;
+    }
+    if (c.out_sent < c.out.size())
+    {
+        events |= EPOLLOUT;
+    }
+    if (events != c.events)
+    {
+        epoll_event ev = {};
+        ev.events = events;
+        ev.data.fd = c.fd;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev);
+        c.events = events;
+    }
+}
+
+void event_loop::respond(connection &c, int status, std::string_view body, bool keep_alive, unsigned retry_after_s)
+{
+    http_append_response(c.out, status, body, keep_alive, retry_after_s);
+    if (!keep_alive)
+    {
+        c.close_after_write = true;
+    }
+}
+
+void event_loop::handle_request(connection &c, const http_request &req, std::string_view body)
+{
+    if (req.path != "/api/data")
+    {
+        respond(c, 404, "{\"status\": \"not found\"}", req.keep_alive);
+        return;
+    }
+    if (req.method != "POST")
+    {
+        respond(c, 405, "{\"status\": \"method not allowed\"}", req.keep_alive);
+        return;
+    }
+
+    upload up;
+    bool ok;
+    if (http_iequals(req.mime_type, TELEMETRY_FRAME_CONTENT_TYPE))
+    {
+        ok = decode_frame_upload(body, up);
+    }
+    else
+    {
+        // Like Flask's get_json(silent=True), other content types are not parsed
+        ok = is_json_mime_type(req.mime_type) && decode_json_upload(body, up);
+    }
+    if (!ok || !place_upload(up, epoch_us()))
+    {
+        respond(c, 400, BODY_FAILED, req.keep_alive);
+        return;
+    }
+
+    uint64_t seq = writer_.submit(std::move(up));
+    if (seq == 0)
+    {
+        respond(c, 503, BODY_BUSY, req.keep_alive, config_.retry_after_s);
+    }
+    else if (!config_.durability_committed)
+    {
+        respond(c, 200, BODY_OK, req.keep_alive);
+    }
+    else
+    {
+        // Answered from on_commit() or, after the commit timeout, from sweep()
+        c.waiting_seq = seq;
+        c.waiting_since_ms = steady_ms();
+        c.keep_alive = req.keep_alive;
+        waiting_.push_back(waiter{seq, c.fd, c.id});
+    }
+}
+
+void event_loop::process_input(connection &c)
+{
+    size_t consumed = 0;
+    while (!c.waiting_seq && !c.close_after_write && consumed < c.in.size())
+    {
+        std::string_view buf(c.in.data() + consumed, c.in.size() - consumed);
+        http_request req;
+        http_parse_result result = http_parse_head(buf, req);
+        if (result == http_parse_result::incomplete)
+        {
+            if (buf.size() > HTTP_MAX_HEAD)
+            {
+                respond(c, 431, "{\"status\": \"header too large\"}", false);
+            }
+            break;
+        }
+        if (result == http_parse_result::bad_request)
+        {
+            respond(c, 400, "{\"status\": \"bad request\"}", false);
+            break;
+        }
+        if (req.head_size > HTTP_MAX_HEAD)
+        {
+            respond(c, 431, "{\"status\": \"header too large\"}", false);
+            break;
+        }
+        if (req.chunked)
+        {
+            respond(c, 411, "{\"status\": \"length required\"}", false);
+            break;
+        }
+        if (req.content_length > config_.max_body)
+        {
+            respond(c, 413, "{\"status\": \"too large\"}", false);
+            break;
+        }
+        if (buf.size() - req.head_size < req.content_length)
+        {
+            if (req.expect_continue && !c.continue_sent)
+            {
+                c.out += "HTTP/1.1 100 Continue\r\n\r\n";
+                c.continue_sent = true;
+            }
+            break;
+        }
+        // The body is parsed in place, the rows are copied out before the buffer is compacted
+        handle_request(c, req, buf.substr(req.head_size, req.content_length));
+        consumed += req.head_size + req.content_length;
+        c.continue_sent = false;
+    }
+    c.in.erase(0, consumed);
+}
+
+void event_loop::flush_output(connection &c)
+{
+    while (c.out_sent < c.out.size())
+    {
+        ssize_t n = send(c.fd, c.out.data() + c.out_sent, c.out.size() - c.out_sent, MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                break;
+            }
+            close_connection(c);
+            return;
+        }
+        c.out_sent += (size_t)n;
+    }
+    if (c.out_sent == c.out.size())
+    {
+        c.out.clear();
+        c.out_sent = 0;
+        if (c.close_after_write)
+        {
+            close_connection(c);
+            return;
+        }
+    }
+    update_interest(c);
+}
+
+void event_loop::on_readable(connection &c)
+{
+    char buf[EVENT_LOOP_READ_CHUNK];
+    ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+        close_connection(c);
+        return;
+    }
+    if (n > 0)
+    {
+        c.in.append(buf, (size_t)n);
+        c.last_active_ms = steady_ms();
+        process_input(c);
+    }
+    flush_output(c);
+}
+
+void event_loop::on_commit()
+{
+    uint64_t count;
+    (void)!read(commit_fd_, &count, sizeof(count));
+    uint64_t committed = writer_.committed();
+    while (!waiting_.empty() && waiting_.front().seq <= committed)
+    {
+        waiter w = waiting_.front();
+        waiting_.pop_front();
+        auto found = connections_.find(w.fd);
+        // The connection may have closed, or timed out waiting, in the meantime
+        if (found == connections_.end() || found->second->id != w.id || found->second->waiting_seq != w.seq)
+        {
+            continue;
+        }
+        connection &c = *found->second;
+        c.waiting_seq = 0;
+        if (writer_.take_rejected(w.seq))
+        {
+            respond(c, 400, BODY_FAILED, c.keep_alive);
+        }
+        else
+        {
+            respond(c, 200, BODY_OK, c.keep_alive);
+        }
+        process_input(c);
+        flush_output(c);
+    }
+}
+
+void event_loop::sweep(int64_t now_ms)
+{
+    std::vector<int> fds;
+    fds.reserve(connections_.size());
+    for (auto &entry : connections_)
+    {
+        fds.push_back(entry.first);
+    }
+    for (int fd : fds)
+    {
+        connection &c = *connections_[fd];
+        if (c.waiting_seq && now_ms - c.waiting_since_ms > config_.commit_timeout_s * 1000)
+        {
+            // The rows stay queued and will be stored, the device's retry may store them twice
+            c.waiting_seq = 0;
+            respond(c, 503, BODY_NOT_COMMITTED, c.keep_alive, config_.retry_after_s);
+            process_input(c);
+            flush_output(c);
+        }
+        else if (!c.waiting_seq && c.out.empty() && now_ms - c.last_active_ms > config_.idle_timeout_s * 1000LL)
+        {
+            close_connection(c);
+        }
+    }
+}
+
+void event_loop::run(const std::atomic<bool> &running)
+{
+    epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    int64_t next_sweep_ms = steady_ms() + EVENT_LOOP_SWEEP_MS;
+    while (running.load(std::memory_order_relaxed))
+    {
+        int n = epoll_wait(epoll_fd_, events, EVENT_LOOP_MAX_EVENTS, EVENT_LOOP_SWEEP_MS);
+        for (int i = 0; i < n; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_)
+            {
+                accept_all();
+                continue;
+            }
+            if (fd == commit_fd_)
+            {
+                on_commit();
+                continue;
+            }
+            auto found = connections_.find(fd);
+            if (found == connections_.end())
+            {
+                continue;
+            }
+            connection &c = *found->second;
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+            {
+                on_readable(c); // Reads the EOF or error and closes on HUP/ERR
+            }
+            else if (events[i].events & EPOLLOUT)
+            {
+                flush_output(c);
+            }
+        }
+        int64_t now_ms = steady_ms();
+        if (now_ms >= next_sweep_ms)
+        {
+            sweep(now_ms);
+            next_sweep_ms = now_ms + EVENT_LOOP_SWEEP_MS;
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "config.h"
+#include "http.h"
+#include "ingest-writer.h"
+
+/*
+ * One epoll event loop on one thread. Every loop has its own SO_REUSEPORT
+ * listening socket, so the kernel spreads connections over the loops and they
+ * share nothing but the ingest writer. In committed durability mode a request
+ * is parked until the writer signals the loop's eventfd with its commit.
+ */
+
+class event_loop
+{
+public:
+    event_loop(const gateway_config &config, ingest_writer &writer) : config_(config), writer_(writer) {}
+    ~event_loop();
+    event_loop(const event_loop &) = delete;
+    event_loop &operator=(const event_loop &) = delete;
+
+    /**
+     * @brief Create the listening socket, the epoll instance and the commit eventfd.
+     * @param error Set to the failing call on failure
+     */
+    bool open(std::string &error);
+
+    /**
+     * @brief eventfd the writer signals after every commit, valid after open().
+     */
+    int commit_eventfd() const { return commit_fd_; }
+
+    /**
+     * @brief Serve until running turns false.
+     */
+    void run(const std::atomic<bool> &running);
+
+private:
+    struct connection
+    {
+        int fd;
+        uint64_t id;              // Tells a reused fd apart in the commit waiting list
+        std::string in;           // Received bytes not yet consumed
+        std::string out;          // Response bytes not yet sent
+        size_t out_sent = 0;
+        uint32_t events = 0;      // Current epoll interest
+        bool continue_sent = false;
+        bool close_after_write = false;
+        bool keep_alive = true;   // Of the request waiting for its commit
+        uint64_t waiting_seq = 0; // Upload waiting for its commit, 0 if none
+        int64_t waiting_since_ms = 0;
+        int64_t last_active_ms = 0;
+    };
+
+    struct waiter
+    {
+        uint64_t seq;
+        int fd;
+        uint64_t id;
+    };
+
+    void accept_all();
+    void on_readable(connection &c);
+    void process_input(connection &c);
+    void handle_request(connection &c, const http_request &req, std::string_view body);
+    void respond(connection &c, int status, std::string_view body, bool keep_alive, unsigned retry_after_s = 0);
+    void flush_output(connection &c);
+    void update_interest(connection &c);
+    void close_connection(connection &c);
+    void on_commit();
+    void sweep(int64_t now_ms);
+
+    const gateway_config &config_;
+    ingest_writer &writer_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int commit_fd_ = -1;
+    uint64_t next_id_ = 1;
+    std::unordered_map<int, std::unique_ptr<connection>> connections_;
+    std::deque<waiter> waiting_; // Ordered by seq, the writer commits in submit order
+};
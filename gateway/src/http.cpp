@@ -0,0 +1,187 @@
+#include <charconv>
+#include "http.h"
+
+static char lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c + 'a' - 'A') : c;
+}
+
+bool http_iequals(std::string_view a, std::string_view b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (lower(a[i]) != lower(b[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string_view trim(std::string_view s)
+{
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+    {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+    {
+        s.remove_suffix(1);
+    }
+    return s;
+}
+
+/**
+ * @brief True if the comma separated header value lists token.
+ */
+static bool has_token(std::string_view value, std::string_view token)
+{
+    while (!value.empty())
+    {
+        size_t comma = value.find(',');
+        if (http_iequals(trim(value.substr(0, comma)), token))
+        {
+            return true;
+        }
+        value = (comma == std::string_view::npos) ? std::string_view() : value.substr(comma + 1);
+    }
+    return false;
+}
+
+http_parse_result http_parse_head(std::string_view buf, http_request &req)
+{
+    size_t end = buf.find("\r\n\r\n");
+    if (end == std::string_view::npos)
+    {
+        return http_parse_result::incomplete;
+    }
+    req = http_request();
+    req.head_size = end + 4;
+    std::string_view head = buf.substr(0, end + 2);
+
+    // Request line: METHOD SP target SP HTTP/1.x
+    size_t eol = head.find("\r\n");
+    std::string_view line = head.substr(0, eol);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.rfind(' ');
+    if (sp1 == std::string_view::npos || sp2 == sp1)
+    {
+        return http_parse_result::bad_request;
+    }
+    req.method = line.substr(0, sp1);
+    std::string_view target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    std::string_view version = line.substr(sp2 + 1);
+    if (version == "HTTP/1.0")
+    {
+        req.keep_alive = false;
+    }
+    else if (version != "HTTP/1.1")
+    {
+        return http_parse_result::bad_request;
+    }
+    req.path = target.substr(0, target.find('?'));
+
+    bool has_length = false;
+    head.remove_prefix(eol + 2);
+    while (!head.empty())
+    {
+        eol = head.find("\r\n");
+        line = head.substr(0, eol);
+        head.remove_prefix(eol + 2);
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0)
+        {
+            return http_parse_result::bad_request;
+        }
+        std::string_view name = line.substr(0, colon);
+        std::string_view value = trim(line.substr(colon + 1));
+        if (http_iequals(name, "Content-Length"))
+        {
+            size_t length;
+            auto result = std::from_chars(value.data(), value.data() + value.size(), length);
+            // Conflicting lengths are a request smuggling vector, refuse them
+            if (result.ec != std::errc() || result.ptr != value.data() + value.size() ||
+                (has_length && length != req.content_length))
+            {
+                return http_parse_result::bad_request;
+            }
+            req.content_length = length;
+            has_length = true;
+        }
+        else if (http_iequals(name, "Content-Type"))
+        {
+            req.mime_type = trim(value.substr(0, value.find(';')));
+        }
+        else if (http_iequals(name, "Connection"))
+        {
+            if (has_token(value, "close"))
+            {
+                req.keep_alive = false;
+            }
+            else if (has_token(value, "keep-alive"))
+            {
+                req.keep_alive = true;
+            }
+        }
+        else if (http_iequals(name, "Transfer-Encoding"))
+        {
+            req.chunked = true;
+        }
+        else if (http_iequals(name, "Expect"))
+        {
+            req.expect_continue = http_iequals(value, "100-continue");
+        }
+    }
+    return http_parse_result::complete;
+}
+
+static const char *reason(int status)
+{
+    switch (status)
+    {
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    case 411:
+        return "Length Required";
+    case 413:
+        return "Payload Too Large";
+    case 431:
+        return "Request Header Fields Too Large";
+    case 503:
+        return "Service Unavailable";
+    default:
+        return "Error";
+    }
+}
+
+void http_append_response(std::string &out, int status, std::string_view body, bool keep_alive,
+                          unsigned retry_after_s)
+{
+    out += "HTTP/1.1 ";
+    out += std::to_string(status);
+    out += ' ';
+    out += reason(status);
+    out += "\r\nContent-Type: application/json\r\nContent-Length: ";
+    out += std::to_string(body.size());
+    if (retry_after_s)
+    {
+        out += "\r\nRetry-After: ";
+        out += std::to_string(retry_after_s);
+    }
+    if (!keep_alive)
+    {
+        out += "\r\nConnection: close";
+    }
+    out += "\r\n\r\n";
+    out += body;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/*
+ * The subset of HTTP/1.1 the upload route needs: request heads with
+ * Content-Length bodies, keep-alive, pipelining and Expect: 100-continue.
+ * Chunked request bodies are refused with 411, esp_http_client and the load
+ * generator always send a length.
+ */
+
+// Longest request head accepted, larger ones get 431
+#define HTTP_MAX_HEAD 8192
+
+struct http_request
+{
+    std::string_view method;
+    std::string_view path;      // Target without the query string
+    std::string_view mime_type; // Content-Type without parameters
+    size_t head_size = 0;       // Bytes up to and including the blank line
+    size_t content_length = 0;
+    bool keep_alive = true;
+    bool expect_continue = false;
+    bool chunked = false;
+};
+
+enum class http_parse_result
+{
+    incomplete, // The head has not fully arrived
+    complete,
+    bad_request,
+};
+
+/**
+ * @brief Parse a request head at the start of buf, without copying.
+ * @param buf Received bytes, the views in req point into it
+ * @param req Filled in when the result is complete
+ */
+http_parse_result http_parse_head(std::string_view buf, http_request &req);
+
+/**
+ * @brief Compare ASCII strings ignoring case.
+ */
+bool http_iequals(std::string_view a, std::string_view b);
+
+/**
+ * @brief Append a complete response with a JSON body.
+ * @param retry_after_s Adds a Retry-After header if not 0
+ */
+void http_append_response(std::string &out, int status, std::string_view body, bool keep_alive,
+                          unsigned retry_after_s = 0);
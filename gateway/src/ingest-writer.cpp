@@ -0,0 +1,223 @@
+#include <algorithm>
+#include <string>
+#include <unistd.h>
+#include "ingest-writer.h"
+#include "log.h"
+
+ingest_writer::ingest_writer(const gateway_config &config) : config_(config)
+{
+    if (!config.dry_run)
+    {
+        store_ = std::make_unique<mysql_store>(config);
+    }
+}
+
+ingest_writer::~ingest_writer()
+{
+    stop(0);
+}
+
+void ingest_writer::add_listener(int eventfd)
+{
+    listeners_.push_back(eventfd);
+}
+
+void ingest_writer::start()
+{
+    thread_ = std::thread(&ingest_writer::run, this);
+}
+
+uint64_t ingest_writer::submit(upload &&up)
+{
+    size_t rows = up.rows();
+    std::lock_guard<std::mutex> guard(lock_);
+    if (rows_ && rows_ + rows > config_.queue_max_rows)
+    {
+        stats_.rejected++;
+        return 0;
+    }
+    uint64_t seq = next_seq_++;
+    batches_.push_back(batch{seq, std::move(up), std::chrono::steady_clock::now()});
+    rows_ += rows;
+    cond_.notify_all();
+    return seq;
+}
+
+bool ingest_writer::take_rejected(uint64_t seq)
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    auto found = std::find(rejected_seqs_.begin(), rejected_seqs_.end(), seq);
+    if (found == rejected_seqs_.end())
+    {
+        return false;
+    }
+    rejected_seqs_.erase(found);
+    return true;
+}
+
+ingest_stats ingest_writer::stats()
+{
+    std::lock_guard<std::mutex> guard(lock_);
+    ingest_stats s = stats_;
+    s.queued_rows = rows_;
+    return s;
+}
+
+bool ingest_writer::stop(double timeout_s)
+{
+    std::unique_lock<std::mutex> guard(lock_);
+    stopping_ = true;
+    cond_.notify_all();
+    bool drained = cond_.wait_for(guard, std::chrono::duration<double>(timeout_s), [this] { return rows_ == 0; });
+    abort_ = true;
+    cond_.notify_all();
+    guard.unlock();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+    return drained;
+}
+
+/**
+ * @brief Wait until a group is due: flush_rows rows are queued, or the oldest upload has waited flush_ms.
+ * The group stays queued until it is committed.
+ * @return false once the writer has to exit
+ */
+bool ingest_writer::next_group(std::vector<const upload *> &group, size_t &rows)
+{
+    std::unique_lock<std::mutex> guard(lock_);
+    cond_.wait(guard, [this] { return abort_ || !batches_.empty(); });
+    if (abort_)
+    {
+        return false;
+    }
+    auto deadline = batches_.front().queued_at + std::chrono::milliseconds(config_.flush_ms);
+    cond_.wait_until(guard, deadline, [this] { return abort_ || stopping_ || rows_ >= config_.flush_rows; });
+    if (abort_)
+    {
+        return false;
+    }
+    group.clear();
+    rows = 0;
+    for (const batch &b : batches_)
+    {
+        if (!group.empty() && rows + b.up.rows() > config_.flush_rows)
+        {
+            break;
+        }
+        group.push_back(&b.up);
+        rows += b.up.rows();
+    }
+    return true;
+}
+
+/**
+ * @brief Remove the count oldest uploads from the queue once stored or dropped and wake their waiters.
+ */
+void ingest_writer::finish(size_t count, bool stored)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        size_t rows = 0;
+        uint64_t seq = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            rows += batches_.front().up.rows();
+            seq = batches_.front().seq;
+            if (!stored && config_.durability_committed)
+            {
+                if (rejected_seqs_.size() == WRITER_REJECTED_SEQS)
+                {
+                    rejected_seqs_.pop_front();
+                }
+                rejected_seqs_.push_back(seq);
+            }
+            batches_.pop_front();
+        }
+        rows_ -= rows;
+        if (stored)
+        {
+            stats_.rows += rows;
+            stats_.commits++;
+        }
+        else
+        {
+            stats_.dropped_rows += rows;
+        }
+        committed_.store(seq, std::memory_order_release);
+        cond_.notify_all();
+    }
+    uint64_t one = 1;
+    for (int fd : listeners_)
+    {
+        (void)!write(fd, &one, sizeof(one));
+    }
+}
+
+/**
+ * @brief Store every upload of a refused group in its own transaction and drop the ones still refused.
+ * @return false on any other failure, the uploads not stored yet stay queued
+ */
+bool ingest_writer::store_each(const std::vector<const upload *> &group)
+{
+    for (const upload *up : group)
+    {
+        std::string error;
+        store_result result = store_->store({up}, error);
+        if (result == store_result::failed)
+        {
+            LOG_E(TAG_DB, "Flushing %zu rows failed: %s", up->rows(), error.c_str());
+            return false;
+        }
+        if (result == store_result::rejected)
+        {
+            LOG_E(TAG_DB, "Dropping %zu rows, the database refuses them: %s", up->rows(), error.c_str());
+        }
+        finish(1, result == store_result::committed);
+    }
+    return true;
+}
+
+void ingest_writer::run()
+{
+    if (store_)
+    {
+        mysql_thread_init();
+    }
+    std::vector<const upload *> group;
+    size_t rows;
+    int backoff_s = 0;
+    while (next_group(group, rows))
+    {
+        std::string error;
+        store_result result = store_ ? store_->store(group, error) : store_result::committed;
+        if (result == store_result::rejected)
+        {
+            // Retrying the group would fail forever and hold back everything queued behind it
+            LOG_W(TAG_DB, "Flushing %zu rows was refused, storing %zu uploads one by one: %s", rows, group.size(),
+                  error.c_str());
+            result = store_each(group) ? store_result::committed : store_result::failed;
+            group.clear();
+        }
+        if (result == store_result::failed)
+        {
+            backoff_s = std::min(std::max(backoff_s * 2, 1), FLUSH_RETRY_MAX_S);
+            LOG_E(TAG_DB, "Flushing %zu rows failed, retrying in %d s: %s", rows, backoff_s, error.c_str());
+            std::unique_lock<std::mutex> guard(lock_);
+            stats_.failed_flushes++;
+            cond_.wait_for(guard, std::chrono::seconds(backoff_s), [this] { return abort_; });
+            continue;
+        }
+        backoff_s = 0;
+        if (!group.empty())
+        {
+            finish(group.size(), true);
+        }
+    }
+    if (store_)
+    {
+        store_.reset();
+        mysql_thread_end();
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "config.h"
+#include "mysql-store.h"
+#include "records.h"
+
+/*
+ * Write-behind queue with group commit, the gateway's counterpart of
+ * server/ingest_queue.py with the same settings and durability semantics.
+ * Event loops submit uploads, one writer thread stores everything that
+ * arrived within flush_ms of the oldest queued upload, up to flush_rows rows,
+ * in one transaction. Uploads stay queued until their group is committed, a
+ * failed flush is retried with backoff. A group MySQL refuses for its values
+ * is stored one upload at a time and the uploads still refused are dropped,
+ * in committed mode their requests fail with 400.
+ */
+
+// Backoff after a failed flush doubles from 1 s up to this
+#define FLUSH_RETRY_MAX_S 30
+// Sequence numbers of dropped uploads kept for committed mode, a waiter that timed out never collects its own
+#define WRITER_REJECTED_SEQS 1024
+
+struct ingest_stats
+{
+    uint64_t rows;
+    uint64_t commits;
+    uint64_t rejected;
+    uint64_t failed_flushes;
+    uint64_t dropped_rows;
+    size_t queued_rows;
+};
+
+class ingest_writer
+{
+public:
+    explicit ingest_writer(const gateway_config &config);
+    ~ingest_writer();
+
+    /**
+     * @brief Register an eventfd that is signalled after every commit. Call before start().
+     */
+    void add_listener(int eventfd);
+
+    /**
+     * @brief Start the writer thread.
+     */
+    void start();
+
+    /**
+     * @brief Queue the rows of one upload.
+     * An upload larger than the whole queue is still accepted while the queue is empty.
+     * @return Sequence number of the upload, 0 if the queue is full
+     */
+    uint64_t submit(upload &&up);
+
+    /**
+     * @brief Highest committed sequence number, uploads are committed in order.
+     */
+    uint64_t committed() const { return committed_.load(std::memory_order_acquire); }
+
+    /**
+     * @brief Whether a committed upload was dropped because MySQL refused its rows, committed mode only.
+     * Answers once per sequence number.
+     */
+    bool take_rejected(uint64_t seq);
+
+    /**
+     * @brief Wait up to timeout_s for the queue to drain, then stop the writer thread.
+     * @return false if rows were left uncommitted
+     */
+    bool stop(double timeout_s);
+
+    ingest_stats stats();
+
+private:
+    struct batch
+    {
+        uint64_t seq;
+        upload up;
+        std::chrono::steady_clock::time_point queued_at;
+    };
+
+    bool next_group(std::vector<const upload *> &group, size_t &rows);
+    bool store_each(const std::vector<const upload *> &group);
+    void finish(size_t count, bool stored);
+    void run();
+
+    const gateway_config &config_;
+    std::unique_ptr<mysql_store> store_; // nullptr in dry run mode
+    std::vector<int> listeners_;
+    std::thread thread_;
+
+    std::mutex lock_;
+    std::condition_variable cond_;
+    std::deque<batch> batches_; // Only the writer pops, references stay valid across push_back
+    size_t rows_ = 0;
+    uint64_t next_seq_ = 1;
+    bool stopping_ = false; // Flush without waiting for flush_ms
+    bool abort_ = false;    // Exit even if rows are left
+    ingest_stats stats_ = {};
+    std::deque<uint64_t> rejected_seqs_;
+    std::atomic<uint64_t> committed_{0};
+};
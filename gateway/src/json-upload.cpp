@@ -0,0 +1,156 @@
+#include "decoder.h"
+#include "json.h"
+
+// Members read per sample, the firmware sends at most 11
+#define UPLOAD_MAX_FIELDS 16
+// Upper bounds that keep the timestamp arithmetic in place_upload() from overflowing
+#define UPLOAD_MAX_TS_US (1LL << 62)
+#define UPLOAD_MAX_TS_MS (UPLOAD_MAX_TS_US / 1000)
+
+struct field_list
+{
+    json_field fields[UPLOAD_MAX_FIELDS];
+    size_t count;
+
+    // The last occurrence wins, like a Python dict
+    const json_field *find(std::string_view key) const
+    {
+        for (size_t i = count; i-- > 0;)
+        {
+            if (fields[i].key == key)
+            {
+                return &fields[i];
+            }
+        }
+        return nullptr;
+    }
+};
+
+/**
+ * @brief Read an integer member.
+ * @param fallback Used if the member is missing, nullptr if it is required
+ */
+static bool get_int(const field_list &obj, std::string_view key, int64_t min, int64_t max, int64_t &out,
+                    const int64_t *fallback = nullptr)
+{
+    const json_field *f = obj.find(key);
+    if (!f)
+    {
+        out = fallback ? *fallback : 0;
+        return fallback != nullptr;
+    }
+    return f->type == json_type::number && json_to_int(f->text, out) && out >= min && out <= max;
+}
+
+static bool get_double(const field_list &obj, std::string_view key, double &out)
+{
+    const json_field *f = obj.find(key);
+    return f && f->type == json_type::number && json_to_double(f->text, out);
+}
+
+static bool decode_sample(const field_list &obj, upload &out)
+{
+    static const int64_t zero = 0;
+    sample_row row;
+    int64_t raw, mode, mtreg, channel, ts_us;
+    if (obj.find("raw"))
+    {
+        if (!get_int(obj, "raw", 0, UINT16_MAX, raw) || !get_int(obj, "mode", 0, UINT8_MAX, mode) ||
+            !get_int(obj, "mtreg", 0, UINT8_MAX, mtreg))
+        {
+            return false;
+        }
+        row.has_raw = true;
+        row.raw = (uint16_t)raw;
+        row.mode = (uint8_t)mode;
+        row.mtreg = (uint8_t)mtreg;
+    }
+    else if (!get_double(obj, "lux", row.lux))
+    {
+        return false;
+    }
+    if (!get_int(obj, "ch", 0, UINT8_MAX, channel, &zero))
+    {
+        return false;
+    }
+    if (obj.find("ts_us"))
+    {
+        if (!get_int(obj, "ts_us", 0, UPLOAD_MAX_TS_US, ts_us))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // Older firmware sends "ts" in ms
+        if (!get_int(obj, "ts", 0, UPLOAD_MAX_TS_MS, ts_us, &zero))
+        {
+            return false;
+        }
+        ts_us *= 1000;
+    }
+    row.channel = (uint8_t)channel;
+    row.timestamp_us = ts_us;
+    out.samples.push_back(row);
+    return true;
+}
+
+static bool decode_window(const field_list &obj, upload &out)
+{
+    static const int64_t zero = 0;
+    window_row row;
+    int64_t ts_ms, window_ms, count, channel;
+    if (!get_int(obj, "ts", 0, UPLOAD_MAX_TS_MS, ts_ms) || !get_int(obj, "win", 0, UINT32_MAX, window_ms) ||
+        !get_int(obj, "n", 0, UINT16_MAX, count) || !get_int(obj, "ch", 0, UINT8_MAX, channel, &zero) ||
+        !get_double(obj, "min", row.min) || !get_double(obj, "max", row.max) ||
+        !get_double(obj, "mean", row.mean) || !get_double(obj, "sd", row.stddev) ||
+        !get_double(obj, "first", row.first) || !get_double(obj, "last", row.last))
+    {
+        return false;
+    }
+    row.timestamp_us = ts_ms * 1000;
+    row.window_ms = (uint32_t)window_ms;
+    row.count = (uint16_t)count;
+    row.channel = (uint8_t)channel;
+    out.windows.push_back(row);
+    return true;
+}
+
+static bool decode_object(json_scanner &scanner, upload &out)
+{
+    field_list obj;
+    if (!scanner.read_object(obj.fields, UPLOAD_MAX_FIELDS, obj.count) || obj.count == 0)
+    {
+        return false;
+    }
+    return obj.find("win") ? decode_window(obj, out) : decode_sample(obj, out);
+}
+
+bool decode_json_upload(std::string_view body, upload &out)
+{
+    json_scanner scanner(body);
+    // The firmware sends a batch as a JSON array, a single object is still accepted
+    if (scanner.consume('['))
+    {
+        if (scanner.consume(']'))
+        {
+            return false;
+        }
+        do
+        {
+            if (!decode_object(scanner, out))
+            {
+                return false;
+            }
+        } while (scanner.consume(','));
+        if (!scanner.consume(']'))
+        {
+            return false;
+        }
+    }
+    else if (!decode_object(scanner, out))
+    {
+        return false;
+    }
+    return scanner.at_end();
+}
@@ -0,0 +1,239 @@
+#include <charconv>
+#include <cmath>
+#include "json.h"
+
+// Nesting deeper than this inside a sample is rejected instead of recursing further
+#define JSON_MAX_DEPTH 32
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+void json_scanner::skip_ws()
+{
+    while (pos_ < end_ && (*pos_ == ' ' || *pos_ == '\t' || *pos_ == '\n' || *pos_ == '\r'))
+    {
+        pos_++;
+    }
+}
+
+bool json_scanner::consume(char c)
+{
+    skip_ws();
+    if (pos_ < end_ && *pos_ == c)
+    {
+        pos_++;
+        return true;
+    }
+    return false;
+}
+
+bool json_scanner::at_end()
+{
+    skip_ws();
+    return pos_ == end_;
+}
+
+bool json_scanner::read_string(std::string_view &out)
+{
+    if (pos_ == end_ || *pos_ != '"')
+    {
+        return false;
+    }
+    const char *start = ++pos_;
+    while (pos_ < end_)
+    {
+        char c = *pos_;
+        if (c == '"')
+        {
+            out = std::string_view(start, pos_ - start);
+            pos_++;
+            return true;
+        }
+        if ((unsigned char)c < 0x20)
+        {
+            return false;
+        }
+        // The escaped character is skipped, \uXXXX needs no special case to find the closing quote
+        pos_ += (c == '\\') ? 2 : 1;
+    }
+    return false;
+}
+
+bool json_scanner::read_number(std::string_view &out)
+{
+    const char *start = pos_;
+    if (pos_ < end_ && *pos_ == '-')
+    {
+        pos_++;
+    }
+    if (pos_ == end_ || !is_digit(*pos_))
+    {
+        return false;
+    }
+    if (*pos_ == '0')
+    {
+        pos_++;
+    }
+    else
+    {
+        while (pos_ < end_ && is_digit(*pos_))
+        {
+            pos_++;
+        }
+    }
+    if (pos_ < end_ && *pos_ == '.')
+    {
+        pos_++;
+        if (pos_ == end_ || !is_digit(*pos_))
+        {
+            return false;
+        }
+        while (pos_ < end_ && is_digit(*pos_))
+        {
+            pos_++;
+        }
+    }
+    if (pos_ < end_ && (*pos_ == 'e' || *pos_ == 'E'))
+    {
+        pos_++;
+        if (pos_ < end_ && (*pos_ == '+' || *pos_ == '-'))
+        {
+            pos_++;
+        }
+        if (pos_ == end_ || !is_digit(*pos_))
+        {
+            return false;
+        }
+        while (pos_ < end_ && is_digit(*pos_))
+        {
+            pos_++;
+        }
+    }
+    out = std::string_view(start, pos_ - start);
+    return true;
+}
+
+bool json_scanner::read_value(json_type &type, std::string_view &text, int depth)
+{
+    skip_ws();
+    if (pos_ == end_ || depth > JSON_MAX_DEPTH)
+    {
+        return false;
+    }
+    const char *start = pos_;
+    std::string_view literal;
+    switch (*pos_)
+    {
+    case '"':
+        type = json_type::string;
+        return read_string(text);
+    case '{':
+    case '[':
+    {
+        char close = (*pos_ == '{') ? '}' : ']';
+        type = (close == '}') ? json_type::object : json_type::array;
+        pos_++;
+        if (!consume(close))
+        {
+            do
+            {
+                std::string_view key, value;
+                json_type value_type;
+                if (close == '}')
+                {
+                    skip_ws();
+                    if (!read_string(key) || !consume(':'))
+                    {
+                        return false;
+                    }
+                }
+                if (!read_value(value_type, value, depth + 1))
+                {
+                    return false;
+                }
+            } while (consume(','));
+            if (!consume(close))
+            {
+                return false;
+            }
+        }
+        text = std::string_view(start, pos_ - start);
+        return true;
+    }
+    case 't':
+        type = json_type::boolean;
+        literal = "true";
+        break;
+    case 'f':
+        type = json_type::boolean;
+        literal = "false";
+        break;
+    case 'n':
+        type = json_type::null_value;
+        literal = "null";
+        break;
+    default:
+        type = json_type::number;
+        return read_number(text);
+    }
+    if ((size_t)(end_ - pos_) < literal.size() || std::string_view(pos_, literal.size()) != literal)
+    {
+        return false;
+    }
+    pos_ += literal.size();
+    text = literal;
+    return true;
+}
+
+bool json_scanner::read_object(json_field *fields, size_t max, size_t &count)
+{
+    count = 0;
+    if (!consume('{'))
+    {
+        return false;
+    }
+    if (consume('}'))
+    {
+        return true;
+    }
+    do
+    {
+        json_field field;
+        skip_ws();
+        if (!read_string(field.key) || !consume(':') || !read_value(field.type, field.text, 1))
+        {
+            return false;
+        }
+        if (count < max)
+        {
+            fields[count++] = field;
+        }
+    } while (consume(','));
+    return consume('}');
+}
+
+bool json_to_int(std::string_view number, int64_t &out)
+{
+    const char *end = number.data() + number.size();
+    auto result = std::from_chars(number.data(), end, out);
+    if (result.ec == std::errc() && result.ptr == end)
+    {
+        return true;
+    }
+    double value;
+    if (!json_to_double(number, value) || !(std::fabs(value) < 9.2e18))
+    {
+        return false;
+    }
+    out = (int64_t)value;
+    return true;
+}
+
+bool json_to_double(std::string_view number, double &out)
+{
+    const char *end = number.data() + number.size();
+    auto result = std::from_chars(number.data(), end, out);
+    return result.ec == std::errc() && result.ptr == end && std::isfinite(out);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/*
+ * Zero-copy JSON scanner for upload bodies. Nothing is allocated or unescaped:
+ * keys and values are string_views into the request buffer, numbers are
+ * converted only when a field is used. Nested values inside an object are
+ * validated and skipped.
+ */
+
+enum class json_type
+{
+    null_value,
+    boolean,
+    number,
+    string, // text is the raw content between the quotes, escapes are not decoded
+    array,  // text is the whole array including brackets
+    object, // text is the whole object including braces
+};
+
+struct json_field
+{
+    std::string_view key;
+    json_type type;
+    std::string_view text;
+};
+
+class json_scanner
+{
+public:
+    explicit json_scanner(std::string_view text) : pos_(text.data()), end_(text.data() + text.size()) {}
+
+    /**
+     * @brief Consume the character c after optional whitespace.
+     * @return false, consuming nothing but the whitespace, if the next character is not c
+     */
+    bool consume(char c);
+
+    /**
+     * @brief True if only whitespace is left.
+     */
+    bool at_end();
+
+    /**
+     * @brief Read one object.
+     * @param fields Receives the members in the order they appear
+     * @param max Capacity of fields, further members are validated and dropped
+     * @param count Number of members stored in fields
+     * @return false on malformed JSON
+     */
+    bool read_object(json_field *fields, size_t max, size_t &count);
+
+private:
+    void skip_ws();
+    bool read_string(std::string_view &out);
+    bool read_number(std::string_view &out);
+    bool read_value(json_type &type, std::string_view &text, int depth);
+
+    const char *pos_;
+    const char *end_;
+};
+
+/**
+ * @brief Convert a JSON number to an integer, fractions are truncated like Python's int().
+ * @return false if the number does not fit
+ */
+bool json_to_int(std::string_view number, int64_t &out);
+
+/**
+ * @brief Convert a JSON number to a double.
+ * @return false if it is out of range
+ */
+bool json_to_double(std::string_view number, double &out);
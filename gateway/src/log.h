@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdio>
+#include <ctime>
+
+/*
+ * Minimal stderr logging in the format of the firmware logs:
+ * "<level> (<unix ms>) <tag>: <message>".
+ */
+
+#define GATEWAY_LOG(level, tag, fmt, ...) \
+    do \
+    { \
+        struct timespec log_ts; \
+        clock_gettime(CLOCK_REALTIME, &log_ts); \
+        fprintf(stderr, level " (%lld) %s: " fmt "\n", \
+                (long long)log_ts.tv_sec * 1000 + log_ts.tv_nsec / 1000000, tag, ##__VA_ARGS__); \
+    } while (0)
+
+#define LOG_I(tag, fmt, ...) GATEWAY_LOG("I", tag, fmt, ##__VA_ARGS__)
+#define LOG_W(tag, fmt, ...) GATEWAY_LOG("W", tag, fmt, ##__VA_ARGS__)
+#define LOG_E(tag, fmt, ...) GATEWAY_LOG("E", tag, fmt, ##__VA_ARGS__)
+
+#define TAG_GATEWAY "gateway"
+#define TAG_HTTP "http"
+#define TAG_DB "db"
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "config.h"
+#include "event-loop.h"
+#include "ingest-writer.h"
+#include "log.h"
+
+#define GATEWAY_STATS_INTERVAL_S 10
+
+static std::atomic<bool> s_running{true};
+
+static void on_signal(int)
+{
+    s_running.store(false);
+}
+
+int main()
+{
+    gateway_config config;
+    std::string error;
+    if (!gateway_config_load(config, error))
+    {
+        LOG_E(TAG_GATEWAY, "%s", error.c_str());
+        return 1;
+    }
+    if (!config.dry_run && mysql_library_init(0, nullptr, nullptr))
+    {
+        LOG_E(TAG_GATEWAY, "mysql_library_init failed");
+        return 1;
+    }
+    unsigned threads = config.threads ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+
+    struct sigaction sa = {};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    ingest_writer writer(config);
+    std::vector<std::unique_ptr<event_loop>> loops;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        loops.push_back(std::make_unique<event_loop>(config, writer));
+        if (!loops.back()->open(error))
+        {
+            LOG_E(TAG_GATEWAY, "%s", error.c_str());
+            return 1;
+        }
+        writer.add_listener(loops.back()->commit_eventfd());
+    }
+    writer.start();
+    std::vector<std::thread> loop_threads;
+    for (auto &loop : loops)
+    {
+        loop_threads.emplace_back([&loop] { loop->run(s_running); });
+    }
+    LOG_I(TAG_GATEWAY, "Listening on port %u with %u event loops, durability %s%s", config.port, threads,
+          config.durability_committed ? "committed" : "queued", config.dry_run ? ", dry run: rows are dropped" : "");
+
+    ingest_stats last = writer.stats();
+    unsigned ticks = 0;
+    while (s_running.load())
+    {
+        usleep(100 * 1000);
+        if (++ticks % (GATEWAY_STATS_INTERVAL_S * 10) == 0)
+        {
+            ingest_stats now = writer.stats();
+            LOG_I(TAG_GATEWAY, "%.0f rows/s, %llu commits, %zu rows queued, %llu rejected, %llu failed flushes, %llu rows dropped",
+                  (double)(now.rows - last.rows) / GATEWAY_STATS_INTERVAL_S,
+                  (unsigned long long)(now.commits - last.commits), now.queued_rows,
+                  (unsigned long long)(now.rejected - last.rejected),
+                  (unsigned long long)(now.failed_flushes - last.failed_flushes),
+                  (unsigned long long)(now.dropped_rows - last.dropped_rows));
+            last = now;
+        }
+    }
+
+    LOG_I(TAG_GATEWAY, "Stopping, draining the queue");
+    for (auto &thread : loop_threads)
+    {
+        thread.join();
+    }
+    if (!writer.stop(config.exit_drain_s))
+    {
+        LOG_W(TAG_GATEWAY, "%zu queued rows were not stored", writer.stats().queued_rows);
+    }
+    loops.clear();
+    if (!config.dry_run)
+    {
+        mysql_library_end();
+    }
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include "mysql-store.h"
+
+static const char *const s_insert_prefix[] = {
+    "INSERT INTO data (timestamp, received_at, lux, raw, mode, mtreg, channel, device) VALUES ",
+    "INSERT INTO data_window (timestamp, received_at, window_ms, channel, device, count, "
+    "lux_min, lux_max, lux_mean, lux_stddev, lux_first, lux_last) VALUES ",
+    "INSERT INTO data_rollup (channel, resolution_s, bucket, device, count, lux_min, lux_max, lux_sum) VALUES ",
+};
+static const char *const s_insert_suffix[] = {
+    "",
+    "",
+    " ON DUPLICATE KEY UPDATE count = count + VALUES(count), lux_min = LEAST(lux_min, VALUES(lux_min)), "
+    "lux_max = GREATEST(lux_max, VALUES(lux_max)), lux_sum = lux_sum + VALUES(lux_sum)",
+};
+static const size_t s_params_per_row[] = {8, 12, 8};
+
+// Bucket lengths of data_rollup, same as ROLLUP_RESOLUTIONS_S in server/rollup.py
+static const uint32_t s_rollup_resolutions_s[] = {60, 3600};
+
+// Same conversion as counts_to_lux() in server/telemetry_frame.py
+static double counts_to_lux(uint16_t raw, uint8_t mode, uint8_t mtreg)
+{
+    double lux = raw / 1.2 * 69 / mtreg;
+    return mode == 0x11 || mode == 0x21 ? lux / 2 : lux;
+}
+
+static MYSQL_TIME to_mysql_time(int64_t epoch_us)
+{
+    time_t seconds = (time_t)(epoch_us / 1000000);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    MYSQL_TIME t;
+    memset(&t, 0, sizeof(t));
+    t.year = utc.tm_year + 1900;
+    t.month = utc.tm_mon + 1;
+    t.day = utc.tm_mday;
+    t.hour = utc.tm_hour;
+    t.minute = utc.tm_min;
+    t.second = utc.tm_sec;
+    t.second_part = (unsigned long)(epoch_us % 1000000);
+    t.time_type = MYSQL_TIMESTAMP_DATETIME;
+    return t;
+}
+
+static void bind_value(MYSQL_BIND &b, enum_field_types type, const void *value, bool is_unsigned = false)
+{
+    memset(&b, 0, sizeof(b));
+    b.buffer_type = type;
+    b.buffer = const_cast<void *>(value);
+    b.is_unsigned = is_unsigned;
+}
+
+static void bind_null(MYSQL_BIND &b)
+{
+    memset(&b, 0, sizeof(b));
+    b.buffer_type = MYSQL_TYPE_NULL;
+}
+
+bool mysql_store::connect(std::string &error)
+{
+    conn_ = mysql_init(nullptr);
+    if (!conn_)
+    {
+        error = "mysql_init failed";
+        return false;
+    }
+    if (!mysql_real_connect(conn_, config_.db_host.c_str(), config_.db_user.c_str(), config_.db_password.c_str(),
+                            config_.db_name.c_str(), config_.db_port, nullptr, 0) ||
+        mysql_autocommit(conn_, 0))
+    {
+        error = mysql_error(conn_);
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+void mysql_store::disconnect()
+{
+    for (auto &statements : statements_)
+    {
+        for (auto &entry : statements)
+        {
+            mysql_stmt_close(entry.second);
+        }
+        statements.clear();
+    }
+    if (conn_)
+    {
+        mysql_close(conn_);
+        conn_ = nullptr;
+    }
+}
+
+MYSQL_STMT *mysql_store::statement(table t, size_t rows, std::string &error)
+{
+    auto found = statements_[t].find(rows);
+    if (found != statements_[t].end())
+    {
+        return found->second;
+    }
+    std::string row = "(?";
+    for (size_t i = 1; i < s_params_per_row[t]; i++)
+    {
+        row += ",?";
+    }
+    row += ")";
+    std::string sql = s_insert_prefix[t];
+    sql.reserve(sql.size() + rows * (row.size() + 1));
+    for (size_t i = 0; i < rows; i++)
+    {
+        sql += (i ? "," : "") + row;
+    }
+    sql += s_insert_suffix[t];
+
+    MYSQL_STMT *stmt = mysql_stmt_init(conn_);
+    if (!stmt)
+    {
+        error = mysql_error(conn_);
+        return nullptr;
+    }
+    if (mysql_stmt_prepare(stmt, sql.data(), sql.size()))
+    {
+        error = mysql_stmt_error(stmt);
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+    statements_[t][rows] = stmt;
+    return stmt;
+}
+
+bool mysql_store::execute(table t, size_t rows, std::string &error)
+{
+    MYSQL_STMT *stmt = statement(t, rows, error);
+    if (!stmt)
+    {
+        return false;
+    }
+    if (mysql_stmt_bind_param(stmt, binds_.data()) || mysql_stmt_execute(stmt))
+    {
+        error = mysql_stmt_error(stmt);
+        // Class 22 is a data exception (out of range, invalid time), 23 an integrity constraint violation
+        const char *state = mysql_stmt_sqlstate(stmt);
+        rejected_ = !strncmp(state, "22", 2) || !strncmp(state, "23", 2);
+        return false;
+    }
+    return true;
+}
+
+bool mysql_store::insert_samples(const std::vector<const upload *> &uploads, std::string &error)
+{
+    size_t rows = 0;
+    for (const upload *up : uploads)
+    {
+        for (const sample_row &s : up->samples)
+        {
+            if (rows == 0)
+            {
+                binds_.resize(DB_STATEMENT_ROWS * s_params_per_row[TABLE_DATA]);
+                times_.resize(DB_STATEMENT_ROWS * 2);
+            }
+            MYSQL_BIND *b = &binds_[rows * s_params_per_row[TABLE_DATA]];
+            MYSQL_TIME *t = &times_[rows * 2];
+            t[0] = to_mysql_time(s.timestamp_us);
+            t[1] = to_mysql_time(s.received_at_us);
+            bind_value(b[0], MYSQL_TYPE_TIMESTAMP, &t[0]);
+            bind_value(b[1], MYSQL_TYPE_TIMESTAMP, &t[1]);
+            // Samples with a raw count store lux as NULL, it is derived on read
+            if (s.has_raw)
+            {
+                bind_null(b[2]);
+                bind_value(b[3], MYSQL_TYPE_SHORT, &s.raw, true);
+                bind_value(b[4], MYSQL_TYPE_TINY, &s.mode, true);
+                bind_value(b[5], MYSQL_TYPE_TINY, &s.mtreg, true);
+            }
+            else
+            {
+                bind_value(b[2], MYSQL_TYPE_DOUBLE, &s.lux);
+                bind_null(b[3]);
+                bind_null(b[4]);
+                bind_null(b[5]);
+            }
+            bind_value(b[6], MYSQL_TYPE_TINY, &s.channel, true);
+            bind_value(b[7], MYSQL_TYPE_LONG, &up->device, true);
+            if (++rows == DB_STATEMENT_ROWS)
+            {
+                if (!execute(TABLE_DATA, rows, error))
+                {
+                    return false;
+                }
+                rows = 0;
+            }
+        }
+    }
+    return rows == 0 || execute(TABLE_DATA, rows, error);
+}
+
+bool mysql_store::insert_windows(const std::vector<const upload *> &uploads, std::string &error)
+{
+    size_t rows = 0;
+    for (const upload *up : uploads)
+    {
+        for (const window_row &w : up->windows)
+        {
+            if (rows == 0)
+            {
+                binds_.resize(DB_STATEMENT_ROWS * s_params_per_row[TABLE_WINDOW]);
+                times_.resize(DB_STATEMENT_ROWS * 2);
+            }
+            MYSQL_BIND *b = &binds_[rows * s_params_per_row[TABLE_WINDOW]];
+            MYSQL_TIME *t = &times_[rows * 2];
+            t[0] = to_mysql_time(w.timestamp_us);
+            t[1] = to_mysql_time(w.received_at_us);
+            bind_value(b[0], MYSQL_TYPE_TIMESTAMP, &t[0]);
+            bind_value(b[1], MYSQL_TYPE_TIMESTAMP, &t[1]);
+            bind_value(b[2], MYSQL_TYPE_LONG, &w.window_ms, true);
+            bind_value(b[3], MYSQL_TYPE_TINY, &w.channel, true);
+            bind_value(b[4], MYSQL_TYPE_LONG, &up->device, true);
+            bind_value(b[5], MYSQL_TYPE_SHORT, &w.count, true);
+            bind_value(b[6], MYSQL_TYPE_DOUBLE, &w.min);
+            bind_value(b[7], MYSQL_TYPE_DOUBLE, &w.max);
+            bind_value(b[8], MYSQL_TYPE_DOUBLE, &w.mean);
+            bind_value(b[9], MYSQL_TYPE_DOUBLE, &w.stddev);
+            bind_value(b[10], MYSQL_TYPE_DOUBLE, &w.first);
+            bind_value(b[11], MYSQL_TYPE_DOUBLE, &w.last);
+            if (++rows == DB_STATEMENT_ROWS)
+            {
+                if (!execute(TABLE_WINDOW, rows, error))
+                {
+                    return false;
+                }
+                rows = 0;
+            }
+        }
+    }
+    return rows == 0 || execute(TABLE_WINDOW, rows, error);
+}
+
+bool mysql_store::upsert_rollups(const std::vector<const upload *> &uploads, std::string &error)
+{
+    rollups_.clear();
+    for (const upload *up : uploads)
+    {
+        for (const sample_row &s : up->samples)
+        {
+            // A zero MTreg has no lux, like the NULL it gives in SQL
+            if (s.has_raw && s.mtreg == 0)
+            {
+                continue;
+            }
+            double lux = s.has_raw ? counts_to_lux(s.raw, s.mode, s.mtreg) : s.lux;
+            for (uint32_t resolution_s : s_rollup_resolutions_s)
+            {
+                int64_t seconds = s.timestamp_us / 1000000;
+                rollup_key key = {s.channel, resolution_s, seconds - seconds % resolution_s, up->device};
+                auto inserted = rollups_.emplace(key, rollup_value{1, lux, lux, lux});
+                if (!inserted.second)
+                {
+                    rollup_value &v = inserted.first->second;
+                    v.count++;
+                    v.min = std::min(v.min, lux);
+                    v.max = std::max(v.max, lux);
+                    v.sum += lux;
+                }
+            }
+        }
+    }
+
+    size_t rows = 0;
+    for (const auto &entry : rollups_)
+    {
+        if (rows == 0)
+        {
+            binds_.resize(DB_STATEMENT_ROWS * s_params_per_row[TABLE_ROLLUP]);
+            times_.resize(DB_STATEMENT_ROWS);
+        }
+        MYSQL_BIND *b = &binds_[rows * s_params_per_row[TABLE_ROLLUP]];
+        times_[rows] = to_mysql_time(entry.first.bucket_s * 1000000);
+        bind_value(b[0], MYSQL_TYPE_TINY, &entry.first.channel, true);
+        bind_value(b[1], MYSQL_TYPE_LONG, &entry.first.resolution_s, true);
+        bind_value(b[2], MYSQL_TYPE_TIMESTAMP, &times_[rows]);
+        bind_value(b[3], MYSQL_TYPE_LONG, &entry.first.device, true);
+        bind_value(b[4], MYSQL_TYPE_LONG, &entry.second.count, true);
+        bind_value(b[5], MYSQL_TYPE_DOUBLE, &entry.second.min);
+        bind_value(b[6], MYSQL_TYPE_DOUBLE, &entry.second.max);
+        bind_value(b[7], MYSQL_TYPE_DOUBLE, &entry.second.sum);
+        if (++rows == DB_STATEMENT_ROWS)
+        {
+            if (!execute(TABLE_ROLLUP, rows, error))
+            {
+                return false;
+            }
+            rows = 0;
+        }
+    }
+    return rows == 0 || execute(TABLE_ROLLUP, rows, error);
+}
+
+store_result mysql_store::store(const std::vector<const upload *> &uploads, std::string &error)
+{
+    if (!conn_ && !connect(error))
+    {
+        return store_result::failed;
+    }
+    rejected_ = false;
+    if (insert_samples(uploads, error) && insert_windows(uploads, error) && upsert_rollups(uploads, error))
+    {
+        if (!mysql_commit(conn_))
+        {
+            return store_result::committed;
+        }
+        error = mysql_error(conn_);
+    }
+    if (rejected_ && !mysql_rollback(conn_))
+    {
+        return store_result::rejected;
+    }
+    mysql_rollback(conn_);
+    disconnect();
+    return store_result::failed;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <mysql.h>
+#include "config.h"
+#include "records.h"
+
+/*
+ * Writes groups of uploads into the data and data_window tables, and their
+ * lux rollups into data_rollup (see server/rollup.py), over one MySQL
+ * connection. Rows go in with prepared multi-row INSERTs of up to
+ * DB_STATEMENT_ROWS rows, bound straight from the row structs, and each group
+ * is one transaction. Statements are prepared once per row count and reused.
+ */
+
+// Rows per INSERT, a full statement binds 8, 12 or 8 parameters per row
+#define DB_STATEMENT_ROWS 256
+
+enum class store_result
+{
+    committed,
+    failed,   // Connection or server trouble, the same rows may go in later
+    rejected, // MySQL refused a value (SQLSTATE class 22 or 23), retrying the same rows fails again
+};
+
+class mysql_store
+{
+public:
+    explicit mysql_store(const gateway_config &config) : config_(config) {}
+    ~mysql_store() { disconnect(); }
+    mysql_store(const mysql_store &) = delete;
+    mysql_store &operator=(const mysql_store &) = delete;
+
+    /**
+     * @brief Insert all rows of the uploads and commit once.
+     * Connects on first use. On failure the transaction is rolled back, after
+     * a failure other than a refused value the connection is also dropped and
+     * the next call reconnects.
+     * @param error Set to the MySQL error on failure
+     */
+    store_result store(const std::vector<const upload *> &uploads, std::string &error);
+
+private:
+    enum table
+    {
+        TABLE_DATA,
+        TABLE_WINDOW,
+        TABLE_ROLLUP,
+    };
+
+    struct rollup_key
+    {
+        uint8_t channel;
+        uint32_t resolution_s;
+        int64_t bucket_s;
+        uint32_t device;
+
+        // Primary key order of data_rollup
+        bool operator<(const rollup_key &other) const
+        {
+            return std::tie(channel, device, resolution_s, bucket_s) <
+                   std::tie(other.channel, other.device, other.resolution_s, other.bucket_s);
+        }
+    };
+
+    struct rollup_value
+    {
+        uint32_t count;
+        double min;
+        double max;
+        double sum;
+    };
+
+    bool connect(std::string &error);
+    void disconnect();
+    MYSQL_STMT *statement(table t, size_t rows, std::string &error);
+    bool insert_samples(const std::vector<const upload *> &uploads, std::string &error);
+    bool insert_windows(const std::vector<const upload *> &uploads, std::string &error);
+    bool upsert_rollups(const std::vector<const upload *> &uploads, std::string &error);
+    bool execute(table t, size_t rows, std::string &error);
+
+    const gateway_config &config_;
+    MYSQL *conn_ = nullptr;
+    std::map<size_t, MYSQL_STMT *> statements_[3]; // Per table, keyed by row count
+    std::vector<MYSQL_BIND> binds_;
+    std::vector<MYSQL_TIME> times_;
+    bool rejected_ = false; // The last failed statement was refused for its values
+    std::map<rollup_key, rollup_value> rollups_; // Ordered, so concurrent writers lock buckets in the same order
+};
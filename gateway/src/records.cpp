@@ -0,0 +1,48 @@
+#include <algorithm>
+#include "records.h"
+
+static bool device_clock_valid(int64_t ts_us, int64_t received_at_us)
+{
+    return ts_us >= DEVICE_CLOCK_VALID_AFTER_US && ts_us <= received_at_us + DEVICE_CLOCK_MAX_AHEAD_US;
+}
+
+bool place_upload(upload &up, int64_t received_at_us)
+{
+    bool ok = true;
+    int64_t newest_unset_us = 0;
+    for (const sample_row &s : up.samples)
+    {
+        if (!device_clock_valid(s.timestamp_us, received_at_us))
+        {
+            newest_unset_us = std::max(newest_unset_us, s.timestamp_us);
+        }
+    }
+    for (sample_row &s : up.samples)
+    {
+        if (!device_clock_valid(s.timestamp_us, received_at_us))
+        {
+            s.timestamp_us = received_at_us - (newest_unset_us - s.timestamp_us);
+        }
+        s.received_at_us = received_at_us;
+        ok &= s.timestamp_us >= MYSQL_TIMESTAMP_MIN_US;
+    }
+
+    int64_t newest_end_us = 0;
+    for (const window_row &w : up.windows)
+    {
+        if (!device_clock_valid(w.timestamp_us, received_at_us))
+        {
+            newest_end_us = std::max(newest_end_us, w.timestamp_us + (int64_t)w.window_ms * 1000);
+        }
+    }
+    for (window_row &w : up.windows)
+    {
+        if (!device_clock_valid(w.timestamp_us, received_at_us))
+        {
+            w.timestamp_us = received_at_us - (newest_end_us - w.timestamp_us);
+        }
+        w.received_at_us = received_at_us;
+        ok &= w.timestamp_us >= MYSQL_TIMESTAMP_MIN_US;
+    }
+    return ok;
+}
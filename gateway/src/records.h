@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ * Rows of the data and data_window tables, as decoded from one upload.
+ * Field types match the columns so the MySQL writer binds them in place.
+ */
+
+// Device timestamps before this come from a clock that was never set (firmware TIME_SYNC_VALID_AFTER_S)
+#define DEVICE_CLOCK_VALID_AFTER_US (1704067200LL * 1000000)
+// Device timestamps further than this past the receive time come from a clock that is off
+#define DEVICE_CLOCK_MAX_AHEAD_US (60LL * 1000000)
+// Earliest value of a MySQL TIMESTAMP column
+#define MYSQL_TIMESTAMP_MIN_US 1000000LL
+
+struct sample_row
+{
+    int64_t timestamp_us = 0;   // Device time in epoch us, see place_upload()
+    int64_t received_at_us = 0; // Server time of the upload
+    double lux = 0;             // Only for JSON samples without raw
+    bool has_raw = false;       // raw, mode and mtreg are set, lux is NULL
+    uint16_t raw = 0;
+    uint8_t mode = 0;
+    uint8_t mtreg = 0;
+    uint8_t channel = 0;
+};
+
+struct window_row
+{
+    int64_t timestamp_us = 0; // Window start, device time in epoch us
+    int64_t received_at_us = 0;
+    uint32_t window_ms = 0;
+    uint16_t count = 0;
+    uint8_t channel = 0;
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    double stddev = 0;
+    double first = 0;
+    double last = 0;
+};
+
+struct upload
+{
+    std::vector<sample_row> samples;
+    std::vector<window_row> windows;
+    uint32_t device = 0; // Device id of binary frames, 0 for JSON uploads
+
+    size_t rows() const { return samples.size() + windows.size(); }
+};
+
+/**
+ * @brief Stamp an upload with its receive time and fix the timestamps of devices whose clock is not set.
+ * Same rules as batch_to_records() and windows_to_records() in server/app.py:
+ * valid device times are kept. Until the clock is set, device times are only
+ * used for spacing: the newest sample, or the end of the newest window, is
+ * placed at the receive time and the others are shifted back by their age
+ * relative to it.
+ * @param up Upload with device times in timestamp_us, none of them negative
+ * @param received_at_us Server time in epoch us
+ * @return false if a timestamp ends up before the range of a TIMESTAMP column
+ */
+bool place_upload(upload &up, int64_t received_at_us);
@@ -0,0 +1,142 @@
+#include <cstring>
+#include "decoder.h"
+
+/*
+ * Port of server/telemetry_frame.py, the layout is documented in
+ * firmware/main/telemetry-frame.h. Keep all three in sync.
+ */
+
+#define FRAME_MAGIC 0xB1
+#define FRAME_HEADER_V1_SIZE 24 // magic, version, count, device id, base time, period, mode, MTreg, first count
+#define FRAME_HEADER_V2_SIZE 26 // version 2 and 3 add the channel and a flags byte before the first count
+#define FRAME_FLAG_US 0x01      // Times are in us instead of ms
+
+struct frame_reader
+{
+    const uint8_t *pos;
+    const uint8_t *end;
+
+    template <typename T>
+    T read_le()
+    {
+        T value = 0;
+        for (size_t i = 0; i < sizeof(T); i++)
+        {
+            value |= (T)((T)pos[i] << (8 * i));
+        }
+        pos += sizeof(T);
+        return value;
+    }
+
+    // LEB128 varint, at most 5 bytes like the Python decoder
+    bool read_varint(uint32_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift <= 28; shift += 7)
+        {
+            if (pos == end)
+            {
+                return false;
+            }
+            uint8_t byte = *pos++;
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static bool decode_one(frame_reader &r, uint32_t &device_id, upload &out)
+{
+    if (r.end - r.pos < 2 || r.pos[0] != FRAME_MAGIC || r.pos[1] < 1 || r.pos[1] > 3)
+    {
+        return false;
+    }
+    uint8_t version = r.pos[1];
+    if (r.end - r.pos < (version == 1 ? FRAME_HEADER_V1_SIZE : FRAME_HEADER_V2_SIZE))
+    {
+        return false;
+    }
+    r.pos += 2;
+    uint16_t count = r.read_le<uint16_t>();
+    device_id = r.read_le<uint32_t>();
+    int64_t base = (int64_t)r.read_le<uint64_t>();
+    uint32_t period = r.read_le<uint32_t>();
+    uint8_t mode = r.read_le<uint8_t>();
+    uint8_t mtreg = r.read_le<uint8_t>();
+    uint8_t channel = 0;
+    uint8_t flags = 0;
+    if (version > 1)
+    {
+        channel = r.read_le<uint8_t>();
+        flags = r.read_le<uint8_t>();
+    }
+    int32_t raw = r.read_le<uint16_t>();
+    int64_t unit_us = (flags & FRAME_FLAG_US) ? 1 : 1000;
+    // Bound the times so the us conversion and place_upload() cannot overflow
+    if (count == 0 || mtreg == 0 || base < 0 || base > (1LL << 52))
+    {
+        return false;
+    }
+
+    sample_row row;
+    row.has_raw = true;
+    row.mode = mode;
+    row.mtreg = mtreg;
+    row.channel = channel;
+    int64_t ts = base;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (i > 0)
+        {
+            uint32_t zz, dt;
+            if (!r.read_varint(zz))
+            {
+                return false;
+            }
+            raw += (int32_t)(zz >> 1) ^ -(int32_t)(zz & 1);
+            if (raw < 0 || raw > UINT16_MAX)
+            {
+                return false;
+            }
+            if (version == 3)
+            {
+                if (!r.read_varint(dt))
+                {
+                    return false;
+                }
+                ts += dt;
+            }
+            else
+            {
+                ts = base + (int64_t)i * period;
+            }
+        }
+        row.raw = (uint16_t)raw;
+        row.timestamp_us = ts * unit_us;
+        out.samples.push_back(row);
+    }
+    return true;
+}
+
+bool decode_frame_upload(std::string_view body, upload &out)
+{
+    frame_reader r = {(const uint8_t *)body.data(), (const uint8_t *)body.data() + body.size()};
+    uint32_t device_id, frame_device_id;
+    if (!decode_one(r, device_id, out))
+    {
+        return false;
+    }
+    while (r.pos < r.end)
+    {
+        if (!decode_one(r, frame_device_id, out) || frame_device_id != device_id)
+        {
+            return false;
+        }
+    }
+    out.device = device_id;
+    return true;
+}
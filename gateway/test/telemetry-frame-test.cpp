@@ -0,0 +1,158 @@
+/*
+ * decode_frame_upload() against the golden vectors in test/telemetry-frame-vectors.txt,
+ * which the firmware encoder and the Flask decoder are checked against as well.
+ *
+ *   telemetry-frame-test ../test/telemetry-frame-vectors.txt
+ *
+ * Run by ctest. Prints every vector that does not match and exits with 1.
+ */
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "decoder.h"
+
+struct frame_vector
+{
+    std::string name;
+    uint32_t device = 0;
+    std::string body;
+    std::vector<sample_row> out;
+    bool invalid = false;
+};
+
+static bool parse_sample(std::istringstream &fields, sample_row &row)
+{
+    std::string ts_us, raw, mode, mtreg, channel;
+    if (!(fields >> ts_us >> raw >> mode >> mtreg >> channel))
+    {
+        return false;
+    }
+    row.timestamp_us = std::stoll(ts_us, nullptr, 0);
+    row.has_raw = true;
+    row.raw = (uint16_t)std::stoul(raw, nullptr, 0);
+    row.mode = (uint8_t)std::stoul(mode, nullptr, 0);
+    row.mtreg = (uint8_t)std::stoul(mtreg, nullptr, 0);
+    row.channel = (uint8_t)std::stoul(channel, nullptr, 0);
+    return true;
+}
+
+static bool load_vectors(const char *path, std::vector<frame_vector> &vectors)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    std::string line;
+    bool open = false;
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+        {
+            open = false;
+            continue;
+        }
+        if (line[0] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string keyword;
+        fields >> keyword;
+        if (keyword == "vector")
+        {
+            vectors.emplace_back();
+            vectors.back().name = line.substr(7);
+            open = true;
+            continue;
+        }
+        if (!open)
+        {
+            fprintf(stderr, "Line outside a vector: %s\n", line.c_str());
+            return false;
+        }
+        frame_vector &v = vectors.back();
+        std::string hex;
+        sample_row row;
+        if (keyword == "device")
+        {
+            fields >> hex;
+            v.device = (uint32_t)std::stoul(hex, nullptr, 0);
+        }
+        else if (keyword == "frame" && fields >> hex && hex.size() % 2 == 0)
+        {
+            for (size_t i = 0; i < hex.size(); i += 2)
+            {
+                v.body += (char)std::stoul(hex.substr(i, 2), nullptr, 16);
+            }
+        }
+        else if (keyword == "out" && parse_sample(fields, row))
+        {
+            v.out.push_back(row);
+        }
+        else if (keyword == "invalid")
+        {
+            v.invalid = true;
+        }
+        else if (keyword != "in") // Encoder input, checked by the firmware test app
+        {
+            fprintf(stderr, "Bad line: %s\n", line.c_str());
+            return false;
+        }
+    }
+    return !vectors.empty();
+}
+
+static bool check_vector(const frame_vector &v)
+{
+    upload up;
+    bool ok = decode_frame_upload(v.body, up);
+    if (v.invalid)
+    {
+        if (ok)
+        {
+            fprintf(stderr, "%s: decoded, expected a refusal\n", v.name.c_str());
+        }
+        return !ok;
+    }
+    if (!ok || up.device != v.device || up.samples.size() != v.out.size())
+    {
+        fprintf(stderr, "%s: %s, device %08x, %zu samples, expected device %08x, %zu samples\n", v.name.c_str(),
+                ok ? "decoded" : "refused", up.device, up.samples.size(), v.device, v.out.size());
+        return false;
+    }
+    for (size_t i = 0; i < v.out.size(); i++)
+    {
+        const sample_row &got = up.samples[i];
+        const sample_row &want = v.out[i];
+        if (got.timestamp_us != want.timestamp_us || !got.has_raw || got.raw != want.raw || got.mode != want.mode ||
+            got.mtreg != want.mtreg || got.channel != want.channel)
+        {
+            fprintf(stderr, "%s: sample %zu is %lld %u 0x%02x %u %u, expected %lld %u 0x%02x %u %u\n", v.name.c_str(), i,
+                    (long long)got.timestamp_us, got.raw, got.mode, got.mtreg, got.channel,
+                    (long long)want.timestamp_us, want.raw, want.mode, want.mtreg, want.channel);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<frame_vector> vectors;
+    if (argc != 2 || !load_vectors(argv[1], vectors))
+    {
+        fprintf(stderr, "Usage: %s <telemetry-frame-vectors.txt>\n", argv[0]);
+        return 2;
+    }
+    size_t failed = 0;
+    for (const frame_vector &v : vectors)
+    {
+        failed += !check_vector(v);
+    }
+    printf("%zu of %zu vectors match\n", vectors.size() - failed, vectors.size());
+    return failed ? 1 : 0;
+}
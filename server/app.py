@@ -1,61 +1,402 @@
 from flask import Flask, request, render_template, jsonify
-from datetime import datetime, timezone
+from datetime import datetime, timezone, timedelta
 from dotenv import load_dotenv
+import math
 import os
-import mysql.connector
+import db_pool
+import ingest_queue
+import rollup
+import series
+import telemetry_frame
 
-# Load environment variables from .env file
+# Load environment variables from .env file, the database settings are read in db_pool
 load_dotenv()
-DB_USER = os.getenv("DB_USER")
-DB_PASSWORD = os.getenv("DB_PASSWORD")
-DB_NAME = os.getenv("DB_NAME")
+
+# Devices in report-by-exception mode report at least this often (firmware REPORT_HEARTBEAT_MS).
+# A value older than two heartbeats is treated as missing, not as unchanged.
+REPORT_HEARTBEAT_MS = int(os.getenv("REPORT_HEARTBEAT_MS", "300000"))
+STEPS_MAX_POINTS = 10000
+HISTORY_PAGE_SIZE = 100
+HISTORY_MAX_PAGE_SIZE = 1000
+SERIES_POINTS = 1000
+SERIES_MAX_POINTS = 10000
+
+# Device timestamps before this come from a clock that was never set (firmware TIME_SYNC_VALID_AFTER_S),
+# ones further than DEVICE_CLOCK_MAX_AHEAD past the receive time from a clock that is off
+DEVICE_CLOCK_VALID_AFTER = datetime(2024, 1, 1, tzinfo=timezone.utc)
+DEVICE_CLOCK_MAX_AHEAD = timedelta(seconds=60)
+EPOCH = datetime(1970, 1, 1, tzinfo=timezone.utc)
+# Earliest value of a MySQL TIMESTAMP column, samples placed before it are refused
+TIMESTAMP_MIN = datetime(1970, 1, 1, 0, 0, 1, tzinfo=timezone.utc)
+# Same bounds as the gateway (gateway/src/json-upload.cpp)
+UPLOAD_MAX_TS_US = 1 << 62
+UPLOAD_MAX_TS_MS = UPLOAD_MAX_TS_US // 1000
+
+# Rows from binary frames only store the raw BH1750 count, lux is computed when read.
+LUX_COLUMN = f"{telemetry_frame.LUX_SQL} AS lux"
 
 
 app = Flask(__name__)
 
+@app.errorhandler(db_pool.PoolTimeout)
+def database_busy(error):
+    return '{"status": "database busy"}', 503, {"Retry-After": str(ingest_queue.INGEST_RETRY_AFTER_S)}
+
 @app.route("/")
 def home():
     return "<h1>Homepage</h1>"
 
 @app.route("/api/data", methods=["POST"])
 def receive_data():
-    new_data = request.get_json()
-    if not new_data:
+    if request.mimetype == telemetry_frame.CONTENT_TYPE:
+        try:
+            device, samples = telemetry_frame.decode_frames(request.get_data())
+        except ValueError:
+            return '{"status": "record failed"}', 400
+    else:
+        new_data = request.get_json(silent=True)
+        if not new_data:
+            return '{"status": "record failed"}', 400
+        # The firmware sends a batch as a JSON array, a single object is still accepted
+        samples = new_data if isinstance(new_data, list) else [new_data]
+        # JSON uploads carry no device id
+        device = 0
+
+    # Window summaries from on-device aggregation arrive as JSON objects with a "win" length
+    windows = [sample for sample in samples if isinstance(sample, dict) and "win" in sample]
+    samples = [sample for sample in samples if not (isinstance(sample, dict) and "win" in sample)]
+    received_at = datetime.now(timezone.utc)
+    try:
+        records = batch_to_records(samples, received_at, device)
+        window_records = windows_to_records(windows, received_at, device)
+    except (KeyError, TypeError, ValueError, AttributeError, OverflowError):
         return '{"status": "record failed"}', 400
-    
-    record = {
-        "timestamp": datetime.now(timezone.utc),
-        "lux": new_data["lux"]
-    }
-
-    with mysql.connector.connect(
-        host = "localhost",
-        user = DB_USER,
-        password = DB_PASSWORD,
-        database = DB_NAME
-    ) as conn:
-        with conn.cursor() as curs:
-            insert_query = "INSERT INTO data (timestamp, lux) VALUES (%s, %s)"
-            insert_query_argument = (record["timestamp"], record["lux"])
-            curs.execute(insert_query, insert_query_argument)
-            conn.commit()
+
+    # Rows are written by the ingest queue's writer thread, see ingest_queue for the durability modes
+    batch = ingest.submit(records, window_records, received_at)
+    if batch is None:
+        return '{"status": "busy"}', 503, {"Retry-After": str(ingest_queue.INGEST_RETRY_AFTER_S)}
+    if ingest_queue.INGEST_DURABILITY == "committed":
+        if not batch.committed.wait(ingest_queue.INGEST_COMMIT_TIMEOUT_S):
+            return '{"status": "not committed"}', 503, {"Retry-After": str(ingest_queue.INGEST_RETRY_AFTER_S)}
+        if batch.rejected:
+            return '{"status": "record failed"}', 400
 
     return '{"status": "record succes"}'
 
+def bounded_int(value, low, high):
+    """An uploaded integer, raises ValueError if it is outside [low, high] and so would not fit its column."""
+    value = int(value)
+    if not low <= value <= high:
+        raise ValueError("value out of range")
+    return value
+
+def finite_float(value):
+    """An uploaded lux value, raises ValueError on NaN and infinity, which a FLOAT column refuses."""
+    value = float(value)
+    if not math.isfinite(value):
+        raise ValueError("value not finite")
+    return value
+
+def check_timestamp(timestamp):
+    """Raise ValueError if a stored time would land before the range of a TIMESTAMP column."""
+    if timestamp < TIMESTAMP_MIN:
+        raise ValueError("timestamp before 1970")
+    return timestamp
+
+def sample_time_us(sample):
+    """Device timestamp of a sample in epoch us, older firmware sends "ts" in ms."""
+    if "ts_us" in sample:
+        return bounded_int(sample["ts_us"], 0, UPLOAD_MAX_TS_US)
+    return bounded_int(sample.get("ts", 0), 0, UPLOAD_MAX_TS_MS) * 1000
+
+def device_time(ts_us, received_at):
+    """Device timestamp as a datetime, None if the device clock was not set."""
+    try:
+        timestamp = EPOCH + timedelta(microseconds=ts_us)
+    except OverflowError:
+        return None
+    return timestamp if DEVICE_CLOCK_VALID_AFTER <= timestamp <= received_at + DEVICE_CLOCK_MAX_AHEAD else None
+
+def store_records(conn, batches):
+    """Insert the decoded samples and window summaries of several uploads (ingest_queue.Batch) and their rollups in one transaction."""
+    with conn.cursor() as curs:
+        insert_query_argument = [
+            (record["timestamp"], batch.received_at, record["lux"], record["raw"], record["mode"], record["mtreg"], record["channel"],
+             record["device"])
+            for batch in batches for record in batch.records
+        ]
+        if insert_query_argument:
+            # executemany() rewrites this into one multi-row INSERT
+            insert_query = "INSERT INTO data (timestamp, received_at, lux, raw, mode, mtreg, channel, device) VALUES (%s, %s, %s, %s, %s, %s, %s, %s)"
+            curs.executemany(insert_query, insert_query_argument)
+        insert_query_argument = [
+            (record["timestamp"], batch.received_at, record["window_ms"], record["channel"], record["device"], record["count"],
+             record["min"], record["max"], record["mean"], record["stddev"], record["first"], record["last"])
+            for batch in batches for record in batch.window_records
+        ]
+        if insert_query_argument:
+            insert_query = (
+                "INSERT INTO data_window (timestamp, received_at, window_ms, channel, device, count, lux_min, lux_max, lux_mean, lux_stddev, "
+                "lux_first, lux_last) VALUES (%s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s, %s)"
+            )
+            curs.executemany(insert_query, insert_query_argument)
+        # Buckets for /api/series, in the same transaction so they always match the data table
+        rollup.store_rollups(curs, batches)
+        conn.commit()
+
+# One writer thread shared by all requests, started with the first upload
+ingest = ingest_queue.WriteBehindQueue(store_records, ingest_queue.INGEST_QUEUE_MAX_ROWS,
+                                       ingest_queue.INGEST_FLUSH_ROWS, ingest_queue.INGEST_FLUSH_MS)
+
+def batch_to_records(samples, received_at, device=0):
+    """
+    Turn uploaded samples into database records of the given device id.
+    Samples are stored at their device time, the device keeps it synchronized over SNTP.
+    Until its clock is set, its timestamps are only used for spacing: the newest
+    such sample is stamped with the receive time, older ones are shifted back by
+    their age relative to it.
+    Raises ValueError if a field is out of the range of its column.
+    """
+    times_us = [sample_time_us(sample) for sample in samples]
+    newest_unset_us = max((ts_us for ts_us in times_us if device_time(ts_us, received_at) is None), default=0)
+    records = []
+    for sample, ts_us in zip(samples, times_us):
+        if "raw" in sample:
+            record = {"lux": None, "raw": bounded_int(sample["raw"], 0, 0xFFFF),
+                      "mode": bounded_int(sample["mode"], 0, 0xFF), "mtreg": bounded_int(sample["mtreg"], 0, 0xFF)}
+        else:
+            record = {"lux": finite_float(sample["lux"]), "raw": None, "mode": None, "mtreg": None}
+        # Samples from firmware without a sensor array have no channel
+        record["channel"] = bounded_int(sample.get("ch", 0), 0, 0xFF)
+        record["device"] = device
+        timestamp = device_time(ts_us, received_at)
+        record["timestamp"] = check_timestamp(timestamp or received_at - timedelta(microseconds=newest_unset_us - ts_us))
+        records.append(record)
+    return records
+
+def windows_to_records(windows, received_at, device=0):
+    """
+    Turn uploaded window summaries into database records of the given device id.
+    Like batch_to_records(), windows are stored at their device start time. While
+    the device clock is not set, the end of the newest window is taken as the
+    receive time and the other windows are placed relative to it.
+    Raises ValueError if a field is out of the range of its column.
+    """
+    starts_ms = [bounded_int(window["ts"], 0, UPLOAD_MAX_TS_MS) for window in windows]
+    lengths_ms = [bounded_int(window["win"], 0, 0xFFFFFFFF) for window in windows]
+    newest_end = max((start_ms + length_ms for start_ms, length_ms in zip(starts_ms, lengths_ms)
+                      if device_time(start_ms * 1000, received_at) is None), default=0)
+    records = []
+    for window, start_ms, length_ms in zip(windows, starts_ms, lengths_ms):
+        timestamp = device_time(start_ms * 1000, received_at)
+        records.append({
+            "timestamp": check_timestamp(timestamp or received_at - timedelta(milliseconds=newest_end - start_ms)),
+            "window_ms": length_ms,
+            "channel": bounded_int(window.get("ch", 0), 0, 0xFF),
+            "device": device,
+            "count": bounded_int(window["n"], 0, 0xFFFF),
+            "min": finite_float(window["min"]),
+            "max": finite_float(window["max"]),
+            "mean": finite_float(window["mean"]),
+            "stddev": finite_float(window["sd"]),
+            "first": finite_float(window["first"]),
+            "last": finite_float(window["last"]),
+        })
+    return records
+
+def format_cursor(record):
+    """Page cursor for a row, its position in (timestamp, id) order."""
+    return f"{record['timestamp'].isoformat()}_{record['id']}"
+
+def parse_cursor(value):
+    """Inverse of format_cursor(), raises ValueError on a malformed cursor."""
+    timestamp, _, row_id = value.rpartition("_")
+    return datetime.fromisoformat(timestamp), int(row_id)
+
+def history_page(conn, before=None, after=None, channel=None, limit=HISTORY_PAGE_SIZE):
+    """
+    One page of samples, newest first, by keyset pagination on (timestamp, id).
+    before/after are (timestamp, id) cursors: the page holds the rows just older
+    than before, or just newer than after, or the newest rows without either.
+    Every page is an index range scan of limit + 1 rows on idx_data_time or
+    idx_data_channel_time, however deep it is.
+    Returns (records, has_older, has_newer).
+    """
+    conditions, params = [], []
+    if channel is not None:
+        conditions.append("channel = %s")
+        params.append(channel)
+    # Spelled out instead of a row comparison, which MySQL only turns into an index range on a key prefix
+    if after is not None:
+        conditions.append("(timestamp > %s OR (timestamp = %s AND id > %s))")
+        params.extend((after[0], after[0], after[1]))
+        order = "ASC"
+    else:
+        if before is not None:
+            conditions.append("(timestamp < %s OR (timestamp = %s AND id < %s))")
+            params.extend((before[0], before[0], before[1]))
+        order = "DESC"
+    where = f"WHERE {' AND '.join(conditions)} " if conditions else ""
+    # One row past the page tells whether there is a next one
+    select_query = (
+        f"SELECT id, timestamp, channel, {LUX_COLUMN} FROM data {where}"
+        f"ORDER BY timestamp {order}, id {order} LIMIT %s"
+    )
+    with conn.cursor(dictionary = True) as curs:
+        curs.execute(select_query, (*params, limit + 1))
+        records = curs.fetchall()
+
+    more = len(records) > limit
+    records = records[:limit]
+    if after is not None:
+        records.reverse()
+        if not more:
+            # Paged back to the newest rows, show a full first page
+            return history_page(conn, channel=channel, limit=limit)
+        return records, True, True
+    return records, more, before is not None
+
 @app.route("/history", methods=["GET"])
 def get_data():
-    with mysql.connector.connect(
-        host = "localhost",
-        user = DB_USER,
-        password = DB_PASSWORD,
-        database = DB_NAME
-    ) as conn:
+    """Sample table, ?before=<cursor> or ?after=<cursor> pages through it, ?ch=<n> keeps one channel."""
+    try:
+        before = parse_cursor(request.args["before"]) if "before" in request.args else None
+        after = parse_cursor(request.args["after"]) if "after" in request.args else None
+        channel = int(request.args["ch"]) if request.args.get("ch") else None
+        limit = int(request.args.get("n", HISTORY_PAGE_SIZE))
+    except ValueError:
+        return '{"status": "bad request"}', 400
+    if not 1 <= limit <= HISTORY_MAX_PAGE_SIZE:
+        return '{"status": "bad request"}', 400
+
+    with db_pool.pool.connection() as conn:
+        records, has_older, has_newer = history_page(conn, before, after, channel, limit)
+
+    return render_template(
+        "data.html",
+        records=records,
+        channel=channel,
+        limit=limit,
+        older=format_cursor(records[-1]) if has_older else None,
+        newer=format_cursor(records[0]) if has_newer and records else None,
+    )
+
+def parse_time(value, default):
+    """Parse an ISO 8601 query parameter into naive UTC, the form TIMESTAMP columns come back in."""
+    if not value:
+        return default
+    parsed = datetime.fromisoformat(value)
+    if parsed.tzinfo is not None:
+        parsed = parsed.astimezone(timezone.utc).replace(tzinfo=None)
+    return parsed
+
+def fill_steps(reports, start, end, step, max_age):
+    """
+    Rebuild a report-by-exception series on a regular grid.
+    reports is a list of (timestamp, lux), oldest first, and may start before start.
+    Every grid point holds the last value reported at or before it, which the
+    device guarantees is still within its deadband, or None once that report is
+    older than max_age (the device went silent).
+    """
+    points = []
+    index, current = 0, None
+    t = start
+    while t <= end:
+        while index < len(reports) and reports[index][0] <= t:
+            current = reports[index]
+            index += 1
+        value = current[1] if current is not None and t - current[0] <= max_age else None
+        points.append({"ts": t.isoformat(), "lux": value})
+        t += step
+    return points
+
+@app.route("/api/steps", methods=["GET"])
+def get_steps():
+    """
+    Step-filled series of one channel of one device: ?ch=0&dev=0&from=<ISO 8601>&to=<ISO 8601>&step=<ms>.
+    Defaults to device 0 (JSON uploads) and the last hour in 1 s steps. Each device
+    reports by exception on its own, so their reports are never mixed.
+    """
+    try:
+        channel = int(request.args.get("ch", 0))
+        device = int(request.args.get("dev", 0))
+        end = parse_time(request.args.get("to"), datetime.now(timezone.utc).replace(tzinfo=None))
+        start = parse_time(request.args.get("from"), end - timedelta(hours=1))
+        step = timedelta(milliseconds=int(request.args.get("step", 1000)))
+    except ValueError:
+        return '{"status": "bad request"}', 400
+    if step <= timedelta(0) or start > end or (end - start) / step >= STEPS_MAX_POINTS:
+        return '{"status": "bad request"}', 400
+
+    with db_pool.pool.connection() as conn:
+        with conn.cursor() as curs:
+            # The last report before the range holds the value at its start
+            select_query = (
+                f"(SELECT timestamp, {LUX_COLUMN} FROM data WHERE channel = %s AND device = %s AND timestamp <= %s "
+                "ORDER BY timestamp DESC LIMIT 1) "
+                f"UNION ALL (SELECT timestamp, {LUX_COLUMN} FROM data WHERE channel = %s AND device = %s "
+                "AND timestamp > %s AND timestamp <= %s) "
+                "ORDER BY timestamp"
+            )
+            curs.execute(select_query, (channel, device, start, channel, device, start, end))
+            reports = curs.fetchall()
+
+    max_age = timedelta(milliseconds=2 * REPORT_HEARTBEAT_MS)
+    return jsonify(fill_steps(reports, start, end, step, max_age))
+
+@app.route("/api/series", methods=["GET"])
+def get_series():
+    """
+    Downsampled series of one channel of one device:
+    ?ch=0&dev=0&from=<ISO 8601>&to=<ISO 8601>&points=<N>&method=minmax|lttb.
+    Defaults to device 0 (JSON uploads) and the last day in 1000 min/max/mean buckets, see series.py.
+    """
+    try:
+        channel = int(request.args.get("ch", 0))
+        device = int(request.args.get("dev", 0))
+        end = parse_time(request.args.get("to"), datetime.now(timezone.utc).replace(tzinfo=None))
+        start = parse_time(request.args.get("from"), end - timedelta(days=1))
+        points = int(request.args.get("points", SERIES_POINTS))
+    except ValueError:
+        return '{"status": "bad request"}', 400
+    method = request.args.get("method", "minmax")
+    if start >= end or not 2 <= points <= SERIES_MAX_POINTS or method not in series.SERIES_METHODS:
+        return '{"status": "bad request"}', 400
+
+    with db_pool.pool.connection() as conn:
+        body = series.series(conn, channel, device, start, end, points, method)
+
+    return jsonify(body)
+
+@app.route("/api/latency", methods=["GET"])
+def get_latency():
+    """
+    Delay from sampling to arrival per channel, for samples received in ?from=<ISO 8601>&to=<ISO 8601>.
+    Defaults to the last hour. Covers buffering on the device, the spool backlog and the upload.
+    Samples taken before the device clock was set only count with their age inside their batch.
+    """
+    try:
+        end = parse_time(request.args.get("to"), datetime.now(timezone.utc).replace(tzinfo=None))
+        start = parse_time(request.args.get("from"), end - timedelta(hours=1))
+    except ValueError:
+        return '{"status": "bad request"}', 400
+
+    with db_pool.pool.connection() as conn:
         with conn.cursor(dictionary = True) as curs:
-            select_query = "SELECT timestamp, lux FROM data ORDER BY timestamp DESC"
-            curs.execute(select_query)
-            records = curs.fetchall()
+            select_query = (
+                "SELECT channel, COUNT(*) AS count, "
+                "AVG(TIMESTAMPDIFF(MICROSECOND, timestamp, received_at)) / 1000 AS avg_ms, "
+                "MAX(TIMESTAMPDIFF(MICROSECOND, timestamp, received_at)) / 1000 AS max_ms "
+                "FROM data WHERE received_at > %s AND received_at <= %s GROUP BY channel ORDER BY channel"
+            )
+            curs.execute(select_query, (start, end))
+            rows = curs.fetchall()
 
-    return render_template("data.html", records=records)
+    return jsonify([
+        {"ch": row["channel"], "count": row["count"], "avg_ms": float(row["avg_ms"]), "max_ms": float(row["max_ms"])}
+        for row in rows
+    ])
 
 if __name__ == "__main__":
     app.run(host="0.0.0.0", debug=True)
@@ -0,0 +1,92 @@
+"""
+Insert latency of the upload route's database work, pooled and unpooled.
+
+Simulates N devices that each upload one sample every --period seconds, i.e.
+N / period inserts per second, handled by --workers threads like a threaded
+WSGI server. Every insert is timed from when it was due until its commit, so
+a mode that cannot keep up shows up as queueing delay in the percentiles.
+"connect" opens a connection per insert like the routes used to, "pool"
+checks one out of db_pool.
+
+Against a throwaway MySQL container:
+    docker run -d --name lightsense-bench -e MYSQL_ROOT_PASSWORD=bench -p 3306:3306 \
+        -v "$PWD/database/init_db.sql:/docker-entrypoint-initdb.d/init.sql" mysql:8
+    DB_USER=root DB_PASSWORD=bench DB_NAME=bh1750_db python server/bench_db_pool.py --devices 100 1000 10000
+
+Rows are written to the data table on BENCH_CHANNEL and deleted afterwards.
+It has only been run against a stubbed connector so far, there are no
+recorded results for either mode.
+"""
+import argparse
+import statistics
+import time
+from concurrent.futures import ThreadPoolExecutor
+from datetime import datetime, timezone
+
+import mysql.connector
+
+import app
+import db_pool
+import ingest_queue
+
+BENCH_CHANNEL = 255
+
+
+def insert_once(mode):
+    received_at = datetime.now(timezone.utc)
+    sample = {"raw": 100, "mode": 16, "mtreg": 69, "ch": BENCH_CHANNEL, "ts_us": int(received_at.timestamp() * 1e6)}
+    batch = ingest_queue.Batch(app.batch_to_records([sample], received_at), [], received_at)
+    if mode == "pool":
+        with db_pool.pool.connection() as conn:
+            app.store_records(conn, [batch])
+    else:
+        with mysql.connector.connect(**db_pool.pool.config) as conn:
+            app.store_records(conn, [batch])
+
+
+def run(mode, devices, period, duration, workers):
+    """Offer devices / period inserts per second for duration seconds, return (latencies in s, elapsed s)."""
+    rate = devices / period
+    latencies = []
+
+    def job(due):
+        delay = due - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+        insert_once(mode)
+        latencies.append(time.perf_counter() - due)
+
+    start = time.perf_counter() + 0.1
+    with ThreadPoolExecutor(workers) as executor:
+        futures = [executor.submit(job, start + i / rate) for i in range(int(rate * duration))]
+    for future in futures:
+        future.result()  # Re-raise the first failed insert
+    return latencies, time.perf_counter() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--devices", type=int, nargs="+", default=[100, 1000, 10000])
+    parser.add_argument("--period", type=float, default=0.5, help="upload period of one device in s")
+    parser.add_argument("--duration", type=float, default=10, help="length of each run in s")
+    parser.add_argument("--workers", type=int, default=db_pool.DB_POOL_SIZE, help="concurrent requests")
+    parser.add_argument("--modes", nargs="+", default=["connect", "pool"], choices=["connect", "pool"])
+    args = parser.parse_args()
+
+    print(f"{'devices':>8} {'mode':>8} {'offered/s':>10} {'done/s':>8} {'p50 ms':>8} {'p99 ms':>8}")
+    try:
+        for devices in args.devices:
+            for mode in args.modes:
+                latencies, elapsed = run(mode, devices, args.period, args.duration, args.workers)
+                quantiles = statistics.quantiles(latencies, n=100)
+                print(f"{devices:>8} {mode:>8} {devices / args.period:>10.0f} {len(latencies) / elapsed:>8.0f} "
+                      f"{quantiles[49] * 1000:>8.2f} {quantiles[98] * 1000:>8.2f}")
+    finally:
+        with db_pool.pool.connection() as conn:
+            with conn.cursor() as curs:
+                curs.execute("DELETE FROM data WHERE channel = %s", (BENCH_CHANNEL,))
+            conn.commit()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,118 @@
+"""
+/history page time at increasing depth, keyset pagination against OFFSET.
+
+Fills the data table with --rows synthetic samples on BENCH_CHANNEL, 2 Hz
+going back from now, then loads pages at several depths. "keyset" is the
+route's own query (app.history_page) from a cursor at that depth, "page"
+is the whole request through Flask including the template, "offset" the
+LIMIT/OFFSET query the keyset cursor replaces. Keyset pages stay flat with
+depth, OFFSET grows linearly with it.
+
+Against a throwaway MySQL container (filling 100M rows takes a while and
+about 10 GB of disk, the rows are kept for later runs unless --cleanup):
+    docker run -d --name lightsense-bench -e MYSQL_ROOT_PASSWORD=bench -p 3306:3306 \
+        -v "$PWD/database/init_db.sql:/docker-entrypoint-initdb.d/init.sql" mysql:8
+    DB_USER=root DB_PASSWORD=bench DB_NAME=bh1750_db python server/bench_history.py --rows 100000000
+"""
+import argparse
+import statistics
+import time
+from datetime import datetime, timedelta, timezone
+
+import app
+import db_pool
+from bench_db_pool import BENCH_CHANNEL
+
+SAMPLE_PERIOD = timedelta(milliseconds=500)
+SEED_ROWS = 10000
+
+
+def fill(conn, rows):
+    """Add synthetic rows on BENCH_CHANNEL until there are rows of them, doubling with INSERT ... SELECT."""
+    with conn.cursor() as curs:
+        curs.execute("SELECT COUNT(*) FROM data WHERE channel = %s", (BENCH_CHANNEL,))
+        count = curs.fetchone()[0]
+        if count == 0:
+            newest = datetime.now(timezone.utc).replace(tzinfo=None)
+            seed = [(newest - i * SAMPLE_PERIOD, 100 + i % 7, 16, 69, BENCH_CHANNEL) for i in range(min(SEED_ROWS, rows))]
+            curs.executemany("INSERT INTO data (timestamp, raw, mode, mtreg, channel) VALUES (%s, %s, %s, %s, %s)", seed)
+            conn.commit()
+            count = len(seed)
+        while count < rows:
+            # Copies of the existing rows, shifted to just before the oldest one
+            add = min(count, rows - count)
+            shift_us = count * SAMPLE_PERIOD // timedelta(microseconds=1)
+            curs.execute(
+                "INSERT INTO data (timestamp, raw, mode, mtreg, channel) "
+                "SELECT timestamp - INTERVAL %s MICROSECOND, raw, mode, mtreg, channel FROM data "
+                "WHERE channel = %s ORDER BY timestamp DESC, id DESC LIMIT %s",
+                (shift_us, BENCH_CHANNEL, add),
+            )
+            conn.commit()
+            count += add
+            print(f"  {count} rows", flush=True)
+        return count
+
+
+def timed(fn, repeat):
+    """Median wall time of fn() in ms."""
+    samples = []
+    for _ in range(repeat):
+        start = time.perf_counter()
+        fn()
+        samples.append((time.perf_counter() - start) * 1000)
+    return statistics.median(samples)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--rows", type=int, default=100_000_000)
+    parser.add_argument("--page", type=int, default=app.HISTORY_PAGE_SIZE, help="rows per page")
+    parser.add_argument("--depths", type=float, nargs="+", default=[0, 0.001, 0.01, 0.1, 0.5, 0.99],
+                        help="page positions as a fraction of the bench rows")
+    parser.add_argument("--repeat", type=int, default=5)
+    parser.add_argument("--max-offset", type=int, default=10_000_000, help="skip OFFSET queries deeper than this")
+    parser.add_argument("--cleanup", action="store_true", help="delete the bench rows afterwards")
+    args = parser.parse_args()
+
+    client = app.app.test_client()
+    try:
+        with db_pool.pool.connection() as conn:
+            print(f"Filling {args.rows} rows on channel {BENCH_CHANNEL}")
+            count = fill(conn, args.rows)
+            with conn.cursor() as curs:
+                curs.execute("SELECT MAX(timestamp) FROM data WHERE channel = %s", (BENCH_CHANNEL,))
+                newest = curs.fetchone()[0]
+
+            print(f"{'depth':>10} {'keyset ms':>10} {'page ms':>10} {'offset ms':>10}")
+            for depth in args.depths:
+                offset = int(depth * count)
+                # Rows are SAMPLE_PERIOD apart, so the cursor for a depth is known without scanning
+                before = (newest - offset * SAMPLE_PERIOD + timedelta(microseconds=1), 0)
+                keyset = timed(lambda: app.history_page(conn, before=before, channel=BENCH_CHANNEL, limit=args.page),
+                               args.repeat)
+                cursor = f"{before[0].isoformat()}_{before[1]}"
+                page = timed(lambda: client.get(f"/history?ch={BENCH_CHANNEL}&n={args.page}&before={cursor}"),
+                             args.repeat)
+
+                def offset_query():
+                    with conn.cursor() as curs:
+                        curs.execute(
+                            f"SELECT id, timestamp, channel, {app.LUX_COLUMN} FROM data WHERE channel = %s "
+                            "ORDER BY timestamp DESC, id DESC LIMIT %s OFFSET %s",
+                            (BENCH_CHANNEL, args.page, offset),
+                        )
+                        curs.fetchall()
+
+                offset_ms = f"{timed(offset_query, args.repeat):10.2f}" if offset <= args.max_offset else f"{'skipped':>10}"
+                print(f"{offset:>10} {keyset:>10.2f} {page:>10.2f} {offset_ms}")
+    finally:
+        if args.cleanup:
+            with db_pool.pool.connection() as conn:
+                with conn.cursor() as curs:
+                    curs.execute("DELETE FROM data WHERE channel = %s", (BENCH_CHANNEL,))
+                conn.commit()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+"""
+Ingestion throughput with a commit per upload and with the write-behind queue.
+
+Simulates N devices that each upload --batch samples every --period seconds,
+handled by --workers threads like a threaded WSGI server. "direct" stores
+every upload in its own transaction, "queue" hands it to an
+ingest_queue.WriteBehindQueue and waits for its group commit like
+INGEST_DURABILITY=committed does. Latency is timed from when an upload was
+due until its rows are committed; uploads answered with 503, a full queue
+or no free pooled connection, are counted as rejected.
+
+Against a throwaway MySQL container:
+    docker run -d --name lightsense-bench -e MYSQL_ROOT_PASSWORD=bench -p 3306:3306 \
+        -v "$PWD/database/init_db.sql:/docker-entrypoint-initdb.d/init.sql" mysql:8
+    DB_USER=root DB_PASSWORD=bench DB_NAME=bh1750_db python server/bench_ingest.py --devices 100 1000 10000
+
+Rows are written to the data table on BENCH_CHANNEL and deleted afterwards.
+"""
+import argparse
+import statistics
+import time
+from concurrent.futures import ThreadPoolExecutor
+from datetime import datetime, timezone
+
+import app
+import db_pool
+import ingest_queue
+from bench_db_pool import BENCH_CHANNEL
+
+
+def make_upload(samples):
+    received_at = datetime.now(timezone.utc)
+    now_us = int(received_at.timestamp() * 1e6)
+    upload = [{"raw": 100, "mode": 16, "mtreg": 69, "ch": BENCH_CHANNEL, "ts_us": now_us - i * 500000} for i in range(samples)]
+    return app.batch_to_records(upload, received_at), received_at
+
+
+def run(mode, devices, args):
+    """Offer devices / period uploads per second for the run's duration, return (latencies in s, rejected, commits, elapsed s)."""
+    rate = devices / args.period
+    latencies = []
+    rejected = []
+    queue = ingest_queue.WriteBehindQueue(app.store_records, args.queue_rows, args.flush_rows, args.flush_ms)
+
+    def job(due):
+        delay = due - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+        records, received_at = make_upload(args.batch)
+        if mode == "direct":
+            try:
+                with db_pool.pool.connection() as conn:
+                    app.store_records(conn, [ingest_queue.Batch(records, [], received_at)])
+            except db_pool.PoolTimeout:
+                rejected.append(due)
+                return
+        else:
+            batch = queue.submit(records, [], received_at)
+            if batch is None:
+                rejected.append(due)
+                return
+            if not batch.committed.wait(ingest_queue.INGEST_COMMIT_TIMEOUT_S):
+                raise TimeoutError("upload not committed in time")
+        latencies.append(time.perf_counter() - due)
+
+    start = time.perf_counter() + 0.1
+    with ThreadPoolExecutor(args.workers) as executor:
+        futures = [executor.submit(job, start + i / rate) for i in range(int(rate * args.duration))]
+    for future in futures:
+        future.result()  # Re-raise the first failed upload
+    commits = queue.stats["commits"] if mode == "queue" else len(latencies)
+    return latencies, len(rejected), commits, time.perf_counter() - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--devices", type=int, nargs="+", default=[100, 1000, 10000])
+    parser.add_argument("--period", type=float, default=5, help="upload period of one device in s")
+    parser.add_argument("--batch", type=int, default=10, help="samples per upload")
+    parser.add_argument("--duration", type=float, default=10, help="length of each run in s")
+    parser.add_argument("--workers", type=int, default=64, help="concurrent requests")
+    parser.add_argument("--modes", nargs="+", default=["direct", "queue"], choices=["direct", "queue"])
+    parser.add_argument("--queue-rows", type=int, default=ingest_queue.INGEST_QUEUE_MAX_ROWS)
+    parser.add_argument("--flush-rows", type=int, default=ingest_queue.INGEST_FLUSH_ROWS)
+    parser.add_argument("--flush-ms", type=int, default=ingest_queue.INGEST_FLUSH_MS)
+    args = parser.parse_args()
+
+    print(f"{'devices':>8} {'mode':>8} {'offered/s':>10} {'rows/s':>8} {'commits':>8} {'rejected':>8} {'p50 ms':>8} {'p99 ms':>8}")
+    try:
+        for devices in args.devices:
+            for mode in args.modes:
+                latencies, rejected, commits, elapsed = run(mode, devices, args)
+                quantiles = statistics.quantiles(latencies, n=100) if len(latencies) > 1 else [0] * 99
+                print(f"{devices:>8} {mode:>8} {devices / args.period * args.batch:>10.0f} "
+                      f"{len(latencies) * args.batch / elapsed:>8.0f} {commits:>8} {rejected:>8} "
+                      f"{quantiles[49] * 1000:>8.2f} {quantiles[98] * 1000:>8.2f}")
+    finally:
+        with db_pool.pool.connection() as conn:
+            with conn.cursor() as curs:
+                curs.execute("DELETE FROM data WHERE channel = %s", (BENCH_CHANNEL,))
+            conn.commit()
+
+
+if __name__ == "__main__":
+    main()
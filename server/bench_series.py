@@ -0,0 +1,73 @@
+"""
+/api/series latency over week, month and year ranges against series.SERIES_LATENCY_TARGETS_MS.
+
+Fills the data table with --days of synthetic 2 Hz samples on BENCH_CHANNEL
+(bench_history.fill), rebuilds their rollups, then requests each range
+ending at the newest sample through Flask with both methods and reports the
+median time and whether it meets the target.
+
+Against a throwaway MySQL container (a year at 2 Hz is 63M rows, they are
+kept for later runs unless --cleanup):
+    docker run -d --name lightsense-bench -e MYSQL_ROOT_PASSWORD=bench -p 3306:3306 \\
+        -v "$PWD/database/init_db.sql:/docker-entrypoint-initdb.d/init.sql" mysql:8
+    DB_USER=root DB_PASSWORD=bench DB_NAME=bh1750_db python server/bench_series.py
+
+Not run against MySQL yet, whether the targets are met is still open.
+"""
+import argparse
+from datetime import timedelta
+
+import app
+import bench_history
+import db_pool
+import rollup
+import series
+from bench_db_pool import BENCH_CHANNEL
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--days", type=int, default=366)
+    parser.add_argument("--points", type=int, default=app.SERIES_POINTS)
+    parser.add_argument("--repeat", type=int, default=5)
+    parser.add_argument("--cleanup", action="store_true", help="delete the bench rows afterwards")
+    args = parser.parse_args()
+
+    client = app.app.test_client()
+    try:
+        with db_pool.pool.connection() as conn:
+            rows = timedelta(days=args.days) // bench_history.SAMPLE_PERIOD
+            print(f"Filling {rows} rows on channel {BENCH_CHANNEL}")
+            count = bench_history.fill(conn, rows)
+            with conn.cursor() as curs:
+                curs.execute("SELECT MIN(timestamp), MAX(timestamp) FROM data WHERE channel = %s", (BENCH_CHANNEL,))
+                oldest, newest = curs.fetchone()
+                curs.execute("SELECT SUM(count) FROM data_rollup WHERE channel = %s AND resolution_s = %s",
+                             (BENCH_CHANNEL, min(rollup.ROLLUP_RESOLUTIONS_S)))
+                rolled = curs.fetchone()[0] or 0
+            # fill() copies rows with INSERT ... SELECT, which bypasses the rollups
+            if rolled != count:
+                print("Rebuilding rollups")
+                rollup.rebuild(conn, oldest, newest + timedelta(seconds=1), BENCH_CHANNEL)
+
+        end = newest + timedelta(microseconds=1)
+        print(f"{'range':>6} {'method':>7} {'ms':>8} {'target':>7} {'points':>7}  source")
+        for name, (span, target_ms) in series.SERIES_LATENCY_TARGETS_MS.items():
+            for method in series.SERIES_METHODS:
+                url = (f"/api/series?ch={BENCH_CHANNEL}&from={(end - span).isoformat()}&to={end.isoformat()}"
+                       f"&points={args.points}&method={method}")
+                body = client.get(url).get_json()
+                ms = bench_history.timed(lambda: client.get(url), args.repeat)
+                verdict = "ok" if ms <= target_ms else "SLOW"
+                print(f"{name:>6} {method:>7} {ms:8.2f} {target_ms:>7} {len(body['points']):>7}  {body['source']} {verdict}")
+    finally:
+        if args.cleanup:
+            with db_pool.pool.connection() as conn:
+                with conn.cursor() as curs:
+                    curs.execute("DELETE FROM data WHERE channel = %s", (BENCH_CHANNEL,))
+                    curs.execute("DELETE FROM data_rollup WHERE channel = %s", (BENCH_CHANNEL,))
+                conn.commit()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,84 @@
+"""
+Pooled MySQL connections shared by every route.
+The routes used to open a connection per request. The pool keeps DB_POOL_SIZE
+connections open instead and hands them out one request at a time. Whether
+this lowers the insert latency has not been measured against MySQL yet,
+bench_db_pool.py is the benchmark for it.
+"""
+import os
+import threading
+import time
+from contextlib import contextmanager
+
+from dotenv import load_dotenv
+from mysql.connector import pooling
+
+load_dotenv()
+DB_CONFIG = {
+    "host": os.getenv("DB_HOST", "localhost"),
+    "user": os.getenv("DB_USER"),
+    "password": os.getenv("DB_PASSWORD"),
+    "database": os.getenv("DB_NAME"),
+}
+# mysql-connector caps a pool at 32 connections
+DB_POOL_SIZE = int(os.getenv("DB_POOL_SIZE", "8"))
+# Seconds a request waits for a free connection before PoolTimeout
+DB_POOL_TIMEOUT = float(os.getenv("DB_POOL_TIMEOUT", "5"))
+# Connections idle for longer than this many seconds are pinged before use,
+# the server drops them after its wait_timeout
+DB_POOL_PING_AFTER = float(os.getenv("DB_POOL_PING_AFTER", "30"))
+
+
+class PoolTimeout(Exception):
+    """No connection became free within DB_POOL_TIMEOUT."""
+
+
+class ConnectionPool:
+    def __init__(self, size, timeout, ping_after, **config):
+        self.size = size
+        self.timeout = timeout
+        self.ping_after = ping_after
+        self.config = config
+        self._pool = None
+        self._init_lock = threading.Lock()
+        # mysql-connector fails at once when the pool is empty, the semaphore makes callers wait
+        self._slots = threading.BoundedSemaphore(size)
+        self._last_used = {}  # Server connection id -> monotonic time it was returned
+
+    def _get_pool(self):
+        # Created on first use, so the app starts even while the database is down
+        with self._init_lock:
+            if self._pool is None:
+                self._pool = pooling.MySQLConnectionPool(pool_name="lightsense", pool_size=self.size, **self.config)
+            return self._pool
+
+    @contextmanager
+    def connection(self):
+        """
+        Check out a connection for the duration of a with block.
+        Waits up to the pool timeout for a free one, then raises PoolTimeout.
+        A connection that sat idle for longer than ping_after is pinged and
+        reconnected if the server closed it. On return the pool rolls back
+        anything left uncommitted.
+        """
+        if not self._slots.acquire(timeout=self.timeout):
+            raise PoolTimeout()
+        try:
+            conn = self._get_pool().get_connection()
+        except Exception:
+            self._slots.release()
+            raise
+        try:
+            if time.monotonic() - self._last_used.pop(conn.connection_id, 0) > self.ping_after:
+                conn.ping(reconnect=True, attempts=2, delay=0)
+            yield conn
+        finally:
+            try:
+                self._last_used[conn.connection_id] = time.monotonic()
+                conn.close()
+            finally:
+                self._slots.release()
+
+
+pool = ConnectionPool(DB_POOL_SIZE, DB_POOL_TIMEOUT, DB_POOL_PING_AFTER, **DB_CONFIG)
+
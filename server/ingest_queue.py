@@ -0,0 +1,211 @@
+"""
+Write-behind ingestion with group commit.
+
+/api/data validates an upload and queues its rows here. One writer thread
+drains the queue: everything that arrives within INGEST_FLUSH_MS of the
+oldest queued upload, up to INGEST_FLUSH_ROWS rows, goes into the database
+with multi-row INSERTs and a single commit, so MySQL syncs its log once per
+group instead of once per request.
+
+Durability, set with INGEST_DURABILITY:
+  queued     The upload is acknowledged as soon as it is queued. If the
+             process dies, the rows still queued are lost (at most
+             INGEST_QUEUE_MAX_ROWS), the device has already dropped them.
+  committed  The upload is acknowledged after the commit of its group, so
+             nothing acknowledged is lost. Requests take up to one flush
+             interval longer. A request whose group is not committed within
+             INGEST_COMMIT_TIMEOUT_S fails with 503 while its rows stay
+             queued, the device's retry may then store them twice.
+In both modes a full queue is answered with 503 and Retry-After.
+
+A failed flush is handled by the kind of error:
+  transient  Connection loss, timeouts, a full pool, anything not below.
+             The group stays queued and is retried with backoff, so while
+             the database is down the queue fills up and pushes back on the
+             devices.
+  data       DataError or IntegrityError, MySQL refuses a value. Retrying
+             would fail forever and hold back everything queued behind it,
+             so each upload of the group is stored on its own and the ones
+             still refused are dropped. They are logged and, if
+             INGEST_DEAD_LETTER names a file, appended to it as JSON lines.
+             In committed mode their requests fail with 400.
+"""
+import atexit
+import json
+import logging
+import os
+import threading
+import time
+from collections import deque
+
+from mysql.connector import errors as mysql_errors
+
+import db_pool
+
+INGEST_DURABILITY = os.getenv("INGEST_DURABILITY", "queued")
+INGEST_QUEUE_MAX_ROWS = int(os.getenv("INGEST_QUEUE_MAX_ROWS", "50000"))
+INGEST_FLUSH_ROWS = int(os.getenv("INGEST_FLUSH_ROWS", "1000"))
+INGEST_FLUSH_MS = int(os.getenv("INGEST_FLUSH_MS", "200"))
+INGEST_COMMIT_TIMEOUT_S = float(os.getenv("INGEST_COMMIT_TIMEOUT_S", "10"))
+# Sent with 503 answers, the firmware pauses its uploads this long
+INGEST_RETRY_AFTER_S = int(os.getenv("INGEST_RETRY_AFTER_S", "5"))
+# Seconds to wait for the queue to drain when the process exits
+INGEST_EXIT_DRAIN_S = float(os.getenv("INGEST_EXIT_DRAIN_S", "5"))
+# File that refused uploads are appended to, empty to only log them
+INGEST_DEAD_LETTER = os.getenv("INGEST_DEAD_LETTER", "")
+FLUSH_RETRY_MAX_S = 30
+
+# Errors that come from the rows themselves, see the module docstring
+DATA_ERRORS = (mysql_errors.DataError, mysql_errors.IntegrityError)
+
+if INGEST_DURABILITY not in ("queued", "committed"):
+    raise ValueError("INGEST_DURABILITY must be queued or committed")
+
+log = logging.getLogger(__name__)
+
+
+class Batch:
+    """The rows of one upload."""
+
+    def __init__(self, records, window_records, received_at):
+        self.records = records
+        self.window_records = window_records
+        self.received_at = received_at
+        self.rows = len(records) + len(window_records)
+        self.queued_at = time.monotonic()
+        self.committed = threading.Event()  # Set once stored or rejected
+        self.rejected = False  # The database refused its rows, they were dropped
+
+
+class WriteBehindQueue:
+    def __init__(self, store, max_rows, flush_rows, flush_ms):
+        """store(conn, batches) inserts the rows of batches and commits once."""
+        self.store = store
+        self.max_rows = max_rows
+        self.flush_rows = flush_rows
+        self.flush_ms = flush_ms
+        self._cond = threading.Condition()
+        self._batches = deque()
+        self._rows = 0
+        self._thread = None
+        self.stats = {"rows": 0, "commits": 0, "rejected": 0, "failed_flushes": 0, "dropped_rows": 0}
+
+    def submit(self, records, window_records, received_at):
+        """Queue the rows of one upload, return its Batch, or None if the queue is full."""
+        batch = Batch(records, window_records, received_at)
+        with self._cond:
+            # An upload larger than the whole queue still goes through when the queue is empty
+            if self._rows and self._rows + batch.rows > self.max_rows:
+                self.stats["rejected"] += 1
+                return None
+            self._batches.append(batch)
+            self._rows += batch.rows
+            if self._thread is None:
+                self._thread = threading.Thread(target=self._run, name="ingest-writer", daemon=True)
+                self._thread.start()
+                atexit.register(self.drain, INGEST_EXIT_DRAIN_S)
+            self._cond.notify()
+        return batch
+
+    def pending_rows(self):
+        with self._cond:
+            return self._rows
+
+    def drain(self, timeout):
+        """Wait until everything queued so far is committed, return False on timeout."""
+        deadline = time.monotonic() + timeout
+        with self._cond:
+            while self._rows:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return False
+                self._cond.wait(remaining)
+        return True
+
+    def _next_group(self):
+        """
+        Wait until a group is due: flush_rows rows are queued, or the oldest
+        upload has waited flush_ms. The group stays queued until it is committed.
+        """
+        with self._cond:
+            while not self._batches:
+                self._cond.wait()
+            deadline = self._batches[0].queued_at + self.flush_ms / 1000
+            while self._rows < self.flush_rows and time.monotonic() < deadline:
+                self._cond.wait(deadline - time.monotonic())
+            group, rows = [], 0
+            for batch in self._batches:
+                if group and rows + batch.rows > self.flush_rows:
+                    break
+                group.append(batch)
+                rows += batch.rows
+            return group, rows
+
+    def _run(self):
+        backoff = 0
+        while True:
+            group, rows = self._next_group()
+            try:
+                try:
+                    with db_pool.pool.connection() as conn:
+                        self.store(conn, group)
+                except DATA_ERRORS:
+                    if len(group) == 1:
+                        self._reject(group[0])
+                    else:
+                        # Find the refused upload so the others are not held back by it
+                        log.warning("Flushing %d rows was refused, storing %d uploads one by one", rows, len(group))
+                        self._store_each(group)
+                else:
+                    self._finish(group, stored=True)
+            except Exception:
+                # Uploads already stored one by one have left the queue, the rest is retried
+                self.stats["failed_flushes"] += 1
+                backoff = min(max(backoff * 2, 1), FLUSH_RETRY_MAX_S)
+                log.exception("Flushing %d rows failed, retrying in %d s", rows, backoff)
+                time.sleep(backoff)
+                continue
+            backoff = 0
+
+    def _store_each(self, group):
+        """Store every upload of group in its own transaction, drop the ones refused, raise on any other error."""
+        for batch in group:
+            try:
+                with db_pool.pool.connection() as conn:
+                    self.store(conn, [batch])
+            except DATA_ERRORS:
+                self._reject(batch)
+            else:
+                self._finish([batch], stored=True)
+
+    def _reject(self, batch):
+        """Drop an upload the database refuses, see the module docstring."""
+        log.exception("Dropping %d rows received at %s, the database refuses them", batch.rows, batch.received_at)
+        if INGEST_DEAD_LETTER:
+            try:
+                with open(INGEST_DEAD_LETTER, "a") as dead_letter:
+                    dead_letter.write(json.dumps({
+                        "received_at": batch.received_at,
+                        "records": batch.records,
+                        "window_records": batch.window_records,
+                    }, default=str) + "\n")
+            except OSError:
+                log.exception("Writing to %s failed", INGEST_DEAD_LETTER)
+        batch.rejected = True
+        self._finish([batch], stored=False)
+
+    def _finish(self, batches, stored):
+        """Remove batches, the oldest queued ones, from the queue once stored or dropped."""
+        rows = sum(batch.rows for batch in batches)
+        with self._cond:
+            for _ in batches:
+                self._batches.popleft()
+            self._rows -= rows
+            if stored:
+                self.stats["rows"] += rows
+                self.stats["commits"] += 1
+            else:
+                self.stats["dropped_rows"] += rows
+            self._cond.notify_all()
+        for batch in batches:
+            batch.committed.set()
@@ -0,0 +1,173 @@
+"""
+Lux rollups of the data table for /api/series.
+
+data_rollup holds the count, min, max and sum of lux per channel and device
+in fixed buckets of every ROLLUP_RESOLUTIONS_S length. Each insert into data updates
+its buckets in the same transaction (store_rollups() from app.store_records,
+the gateway does the same in C++), so a series over months reads a few
+thousand rollup rows instead of millions of samples.
+
+Rows that reach data some other way, and everything stored before the table
+existed, need a rebuild:
+    python server/rollup.py [--from <ISO 8601>] [--to <ISO 8601>] [--ch <n>]
+
+Stop ingestion (the Flask server and the gateway) while a rebuild runs. A
+rebuild deletes the buckets of a range and sums them again from data, while
+every insert adds its samples to the same buckets. An upload stored between
+the two is counted twice or not at all. Locking the buckets in the rebuild
+would not help: inserts lock data first and data_rollup second, a rebuild
+would need them the other way round, so the two would deadlock.
+"""
+import argparse
+from datetime import datetime, timedelta, timezone
+
+import db_pool
+import telemetry_frame
+
+# Every resolution is a multiple of the first, which the others are rebuilt from
+ROLLUP_RESOLUTIONS_S = (60, 3600)
+REBUILD_CHUNK = timedelta(days=1)
+
+EPOCH = datetime(1970, 1, 1)
+
+UPSERT_QUERY = (
+    "INSERT INTO data_rollup (channel, resolution_s, bucket, device, count, lux_min, lux_max, lux_sum) "
+    "VALUES (%s, %s, %s, %s, %s, %s, %s, %s) "
+    "ON DUPLICATE KEY UPDATE count = count + VALUES(count), lux_min = LEAST(lux_min, VALUES(lux_min)), "
+    "lux_max = GREATEST(lux_max, VALUES(lux_max)), lux_sum = lux_sum + VALUES(lux_sum)"
+)
+
+
+def epoch_seconds(timestamp):
+    """Seconds since the epoch of a naive UTC or an aware datetime."""
+    if timestamp.tzinfo is not None:
+        timestamp = timestamp.astimezone(timezone.utc).replace(tzinfo=None)
+    return (timestamp - EPOCH).total_seconds()
+
+
+def align(timestamp, resolution_s, up=False):
+    """Start of the bucket holding a naive UTC timestamp, or of the next one unless it is a start already."""
+    seconds = epoch_seconds(timestamp)
+    buckets = -(-seconds // resolution_s) if up else seconds // resolution_s
+    return EPOCH + timedelta(seconds=int(buckets) * resolution_s)
+
+
+def record_lux(record):
+    """Lux of a data record as LUX_SQL computes it, None if it has none."""
+    if record["raw"] is None:
+        return record["lux"]
+    if not record["mtreg"]:
+        return None
+    return telemetry_frame.counts_to_lux(record["raw"], record["mode"], record["mtreg"])
+
+
+def rollup_rows(batches):
+    """
+    data_rollup rows for the samples of several uploads (ingest_queue.Batch),
+    sorted in primary key order so concurrent writers lock buckets in the same order.
+    """
+    buckets = {}
+    for batch in batches:
+        for record in batch.records:
+            lux = record_lux(record)
+            if lux is None:
+                continue
+            seconds = epoch_seconds(record["timestamp"])
+            for resolution_s in ROLLUP_RESOLUTIONS_S:
+                key = (record["channel"], resolution_s, int(seconds // resolution_s) * resolution_s, record["device"])
+                bucket = buckets.get(key)
+                if bucket is None:
+                    buckets[key] = [1, lux, lux, lux]
+                else:
+                    bucket[0] += 1
+                    bucket[1] = min(bucket[1], lux)
+                    bucket[2] = max(bucket[2], lux)
+                    bucket[3] += lux
+    return [
+        (channel, resolution_s, EPOCH + timedelta(seconds=start), device, *buckets[(channel, resolution_s, start, device)])
+        for channel, resolution_s, start, device in sorted(buckets, key=lambda k: (k[0], k[3], k[1], k[2]))
+    ]
+
+
+def store_rollups(curs, batches):
+    """Add the samples of several uploads to their buckets, in the caller's transaction."""
+    rows = rollup_rows(batches)
+    if rows:
+        curs.executemany(UPSERT_QUERY, rows)
+
+
+def rebuild(conn, start, end, channel=None):
+    """
+    Recompute the rollups of [start, end) from the data table, widened to whole
+    buckets of the largest resolution, one transaction per REBUILD_CHUNK.
+    start and end are naive UTC. Returns the number of rollup rows written.
+    Only while nothing is ingested, see the module docstring.
+    """
+    coarsest = max(ROLLUP_RESOLUTIONS_S)
+    finest = min(ROLLUP_RESOLUTIONS_S)
+    start = align(start, coarsest)
+    end = align(end, coarsest, up=True)
+    channel_filter = "" if channel is None else " AND channel = %s"
+    channel_param = () if channel is None else (channel,)
+    # Bucket start from the stored value, independent of the session time zone
+    bucket = "'1970-01-01' + INTERVAL (TIMESTAMPDIFF(SECOND, '1970-01-01', {column}) DIV %s * %s) SECOND"
+    written = 0
+    with conn.cursor() as curs:
+        while start < end:
+            chunk_end = min(start + REBUILD_CHUNK, end)
+            curs.execute(
+                f"DELETE FROM data_rollup WHERE bucket >= %s AND bucket < %s{channel_filter}",
+                (start, chunk_end, *channel_param),
+            )
+            curs.execute(
+                "INSERT INTO data_rollup (channel, resolution_s, bucket, device, count, lux_min, lux_max, lux_sum) "
+                f"SELECT channel, %s, {bucket.format(column='timestamp')} AS start, device, COUNT(lux), MIN(lux), MAX(lux), SUM(lux) "
+                f"FROM (SELECT channel, device, timestamp, {telemetry_frame.LUX_SQL} AS lux FROM data "
+                f"WHERE timestamp >= %s AND timestamp < %s{channel_filter}) AS samples "
+                "GROUP BY channel, start, device HAVING COUNT(lux) > 0",
+                (finest, finest, finest, start, chunk_end, *channel_param),
+            )
+            written += curs.rowcount
+            for resolution_s in ROLLUP_RESOLUTIONS_S:
+                if resolution_s == finest:
+                    continue
+                curs.execute(
+                    "INSERT INTO data_rollup (channel, resolution_s, bucket, device, count, lux_min, lux_max, lux_sum) "
+                    f"SELECT channel, %s, {bucket.format(column='bucket')} AS start, device, SUM(count), MIN(lux_min), MAX(lux_max), SUM(lux_sum) "
+                    f"FROM data_rollup WHERE resolution_s = %s AND bucket >= %s AND bucket < %s{channel_filter} "
+                    "GROUP BY channel, start, device",
+                    (resolution_s, resolution_s, resolution_s, finest, start, chunk_end, *channel_param),
+                )
+                written += curs.rowcount
+            conn.commit()
+            start = chunk_end
+    return written
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Rebuild data_rollup from the data table. Stop the Flask server and the gateway first, "
+                    "uploads stored during a rebuild are counted twice or lost.")
+    parser.add_argument("--from", dest="start", type=datetime.fromisoformat, help="default: oldest sample")
+    parser.add_argument("--to", dest="end", type=datetime.fromisoformat, help="default: newest sample")
+    parser.add_argument("--ch", type=int, help="default: all channels")
+    args = parser.parse_args()
+
+    with db_pool.pool.connection() as conn:
+        start, end = args.start, args.end
+        if start is None or end is None:
+            with conn.cursor() as curs:
+                curs.execute("SELECT MIN(timestamp), MAX(timestamp) FROM data")
+                oldest, newest = curs.fetchone()
+            if oldest is None:
+                print("No samples")
+                return
+            start = start or oldest
+            end = end or newest + timedelta(seconds=1)
+        start = start.astimezone(timezone.utc).replace(tzinfo=None) if start.tzinfo else start
+        end = end.astimezone(timezone.utc).replace(tzinfo=None) if end.tzinfo else end
+        print(f"{rebuild(conn, start, end, args.ch)} rollup rows written")
+
+
+if __name__ == "__main__":
+    main()
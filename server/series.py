@@ -0,0 +1,133 @@
+"""
+Downsampled lux series for /api/series.
+
+A range is cut into at most N equal buckets and each bucket is aggregated in
+MySQL, so the response stays N points however long the range is:
+  minmax  min, max, mean and count per bucket, what a chart needs to draw
+          the envelope without losing spikes.
+  lttb    at most N single points picked by Largest-Triangle-Three-Buckets
+          from the means of 4 * N buckets, keeps the shape of a line chart.
+Buckets longer than a rollup resolution are summed from data_rollup (see
+rollup.py) instead of the samples, their length is then rounded up to a
+multiple of that resolution and the range widened to whole rollup buckets.
+A series covers one channel of one device, like the rollup rows it is read
+from, so devices sharing a channel number are never merged.
+
+Latency targets for one channel sampled at 2 Hz and N = 1000, on the
+Flask side of a local MySQL. They are goals, not results: bench_series.py
+checks them, but it has not been run against MySQL yet.
+  week   50 ms   1 min rollups, 10k rows
+  month 100 ms   1 min rollups, 43k rows
+  year  200 ms   1 h rollups, 9k rows
+Ranges shorter than N minutes read the samples, at 2 Hz at most 120 per point.
+"""
+from datetime import timedelta
+
+import rollup
+import telemetry_frame
+
+SERIES_METHODS = ("minmax", "lttb")
+LTTB_OVERSAMPLE = 4
+SERIES_LATENCY_TARGETS_MS = {
+    "week": (timedelta(days=7), 50),
+    "month": (timedelta(days=30), 100),
+    "year": (timedelta(days=365), 200),
+}
+
+
+def aggregate(conn, channel, device, start, end, buckets):
+    """
+    Aggregate [start, end) of a channel of a device into at most buckets equal buckets.
+    start and end are naive UTC. Returns (origin, width, source, rows): bucket
+    i starts at origin + i * width, rows are (i, count, min, max, sum) for the
+    non-empty buckets in order, source names the table they were read from.
+    """
+    span_us = (end - start) // timedelta(microseconds=1)
+    width_us = max(1, -(-span_us // buckets))
+    resolution_s = max((r for r in rollup.ROLLUP_RESOLUTIONS_S if r * 1000000 <= width_us), default=None)
+
+    if resolution_s is not None:
+        origin = rollup.align(start, resolution_s)
+        stop = rollup.align(end, resolution_s, up=True)
+        width_s = -(-(stop - origin).total_seconds() // (buckets * resolution_s)) * resolution_s
+        select_query = (
+            "SELECT TIMESTAMPDIFF(SECOND, %s, bucket) DIV %s AS i, SUM(count), MIN(lux_min), MAX(lux_max), SUM(lux_sum) "
+            "FROM data_rollup WHERE channel = %s AND device = %s AND resolution_s = %s AND bucket >= %s AND bucket < %s "
+            "GROUP BY i ORDER BY i"
+        )
+        params = (origin, int(width_s), channel, device, resolution_s, origin, stop)
+        width, source = timedelta(seconds=width_s), f"rollup_{resolution_s}s"
+    else:
+        origin = start
+        select_query = (
+            "SELECT TIMESTAMPDIFF(MICROSECOND, %s, timestamp) DIV %s AS i, COUNT(lux), MIN(lux), MAX(lux), SUM(lux) "
+            f"FROM (SELECT timestamp, {telemetry_frame.LUX_SQL} AS lux FROM data "
+            "WHERE channel = %s AND device = %s AND timestamp >= %s AND timestamp < %s) AS samples "
+            "GROUP BY i HAVING COUNT(lux) > 0 ORDER BY i"
+        )
+        params = (origin, width_us, channel, device, start, end)
+        width, source = timedelta(microseconds=width_us), "data"
+
+    with conn.cursor() as curs:
+        curs.execute(select_query, params)
+        rows = [(int(i), int(n), float(lux_min), float(lux_max), float(lux_sum))
+                for i, n, lux_min, lux_max, lux_sum in curs.fetchall()]
+    return origin, width, source, rows
+
+
+def lttb(points, threshold):
+    """
+    Largest-Triangle-Three-Buckets: pick threshold of the (x, y) points, sorted
+    by x, that keep the visual shape. The first and last point are always kept.
+    """
+    if threshold >= len(points):
+        return points
+    if threshold < 3:
+        return [points[0], points[-1]]
+    picked = [points[0]]
+    every = (len(points) - 2) / (threshold - 2)
+    a = 0
+    for i in range(threshold - 2):
+        # Mean of the next bucket is the third corner of the triangle
+        next_start = int((i + 1) * every) + 1
+        next_end = min(int((i + 2) * every) + 1, len(points))
+        next_points = points[next_start:next_end]
+        avg_x = sum(p[0] for p in next_points) / len(next_points)
+        avg_y = sum(p[1] for p in next_points) / len(next_points)
+
+        ax, ay = points[a]
+        best, best_area = None, -1.0
+        for j in range(int(i * every) + 1, next_start):
+            x, y = points[j]
+            area = abs((ax - avg_x) * (y - ay) - (ax - x) * (avg_y - ay))
+            if area > best_area:
+                best, best_area = j, area
+        picked.append(points[best])
+        a = best
+    picked.append(points[-1])
+    return picked
+
+
+def series(conn, channel, device, start, end, points, method):
+    """The body of an /api/series response, see the module docstring."""
+    buckets = points * LTTB_OVERSAMPLE if method == "lttb" else points
+    origin, width, source, rows = aggregate(conn, channel, device, start, end, buckets)
+    if method == "lttb":
+        # Means at bucket midpoints, x in ms from origin
+        width_ms = width / timedelta(milliseconds=1)
+        picked = lttb([((i + 0.5) * width_ms, lux_sum / n) for i, n, _, _, lux_sum in rows], points)
+        data = [{"ts": (origin + timedelta(milliseconds=x)).isoformat(), "lux": y} for x, y in picked]
+    else:
+        data = [
+            {"ts": (origin + i * width).isoformat(), "min": lux_min, "max": lux_max, "avg": lux_sum / n, "n": n}
+            for i, n, lux_min, lux_max, lux_sum in rows
+        ]
+    return {
+        "ch": channel,
+        "dev": device,
+        "from": origin.isoformat(),  # Start of the first bucket, may be before the requested start
+        "bucket_ms": width / timedelta(milliseconds=1),
+        "source": source,
+        "method": method,
+        "points": data,
+    }
@@ -0,0 +1,104 @@
+"""
+Decoder for the binary telemetry frames sent by the firmware.
+The layout is documented in firmware/main/telemetry-frame.h, keep both in sync.
+"""
+import struct
+
+CONTENT_TYPE = "application/vnd.lightsense.frame"
+MAGIC = 0xB1
+
+# magic, version, count, device id, base timestamp (ms), period (ms), mode, MTreg, first count
+HEADER_V1 = struct.Struct("<BBHIqIBBH")
+# version 2 adds the sensor channel and a flags byte before the first count,
+# version 3 has the same header and a time delta after every count delta
+HEADER_V2 = struct.Struct("<BBHIqIBBBBH")
+FLAG_US = 0x01  # Times are in us instead of ms
+
+BH1750_MEASUREMENT_ACCURACY = 1.2
+BH1750_MTREG_DEFAULT = 69
+BH1750_HALF_LX_MODES = (0x11, 0x21)  # H-Resolution mode2 counts are 0.5 lx
+
+
+def counts_to_lux(count, mode, mtreg):
+    """Convert a raw BH1750 count to lux for the mode and MTreg it was measured with."""
+    lux = count / BH1750_MEASUREMENT_ACCURACY * BH1750_MTREG_DEFAULT / mtreg
+    if mode in BH1750_HALF_LX_MODES:
+        lux /= 2
+    return lux
+
+
+# counts_to_lux() over a row of the data table, rows from JSON uploads may only have lux
+LUX_SQL = "COALESCE(raw / 1.2 * 69 / mtreg / IF(mode IN (17, 33), 2, 1), lux)"
+
+
+def _read_varint(data, pos):
+    """Read an LEB128 varint at data[pos], return (value, position after it)."""
+    value, shift = 0, 0
+    while True:
+        if pos >= len(data) or shift > 28:
+            raise ValueError("truncated varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def _decode_one(data, pos):
+    """Decode the frame starting at data[pos], return (device_id, samples, end position)."""
+    if len(data) - pos < 2:
+        raise ValueError("frame shorter than header")
+    magic, version = data[pos], data[pos + 1]
+    if magic != MAGIC or version not in (1, 2, 3):
+        raise ValueError("unsupported frame magic/version")
+    if version == 1:
+        header, channel, flags = HEADER_V1, 0, 0
+        if len(data) - pos < header.size:
+            raise ValueError("frame shorter than header")
+        _, _, count, device_id, base, period, mode, mtreg, raw = header.unpack_from(data, pos)
+    else:
+        header = HEADER_V2
+        if len(data) - pos < header.size:
+            raise ValueError("frame shorter than header")
+        _, _, count, device_id, base, period, mode, mtreg, channel, flags, raw = header.unpack_from(data, pos)
+    if count == 0 or mtreg == 0:
+        raise ValueError("invalid frame header")
+    unit_us = 1 if flags & FLAG_US else 1000
+
+    counts = [raw]
+    times = [base]
+    pos += header.size
+    for _ in range(count - 1):
+        zz, pos = _read_varint(data, pos)
+        raw += (zz >> 1) ^ -(zz & 1)
+        if not 0 <= raw <= 0xFFFF:
+            raise ValueError("count out of range")
+        counts.append(raw)
+        if version == 3:
+            dt, pos = _read_varint(data, pos)
+            times.append(times[-1] + dt)
+        else:
+            times.append(base + len(times) * period)
+
+    samples = [
+        {"ts_us": ts * unit_us, "raw": c, "mode": mode, "mtreg": mtreg, "ch": channel}
+        for ts, c in zip(times, counts)
+    ]
+    return device_id, samples, pos
+
+
+def decode_frames(data):
+    """
+    Decode a request body of one or more frames into (device_id, samples) where
+    samples is a list of {"ts_us": epoch us, "raw": count, "mode": mode, "mtreg": MTreg, "ch": channel}.
+    Counts are kept raw, lux is derived when they are queried.
+    Raises ValueError on malformed input.
+    """
+    device_id, samples, pos = _decode_one(data, 0)
+    while pos < len(data):
+        frame_device_id, frame_samples, pos = _decode_one(data, pos)
+        if frame_device_id != device_id:
+            raise ValueError("frames from different devices")
+        samples.extend(frame_samples)
+    return device_id, samples
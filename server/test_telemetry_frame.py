@@ -0,0 +1,64 @@
+"""
+decode_frames() against the golden vectors in test/telemetry-frame-vectors.txt,
+which the firmware encoder and the gateway decoder are checked against as well.
+    python server/test_telemetry_frame.py
+"""
+import os
+import unittest
+
+import telemetry_frame
+
+VECTORS = os.path.join(os.path.dirname(__file__), "..", "test", "telemetry-frame-vectors.txt")
+
+
+def sample(fields):
+    """An "in" or "out" line as decode_frames() returns a sample."""
+    ts_us, raw, mode, mtreg, channel = (int(field, 0) for field in fields)
+    return {"ts_us": ts_us, "raw": raw, "mode": mode, "mtreg": mtreg, "ch": channel}
+
+
+def load_vectors(path=VECTORS):
+    """Parse the vectors file into dicts with name, device, body, out and invalid."""
+    vectors, vector = [], None
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith("#"):
+                continue
+            if not line:
+                vector = None
+                continue
+            keyword, _, rest = line.partition(" ")
+            if keyword == "vector":
+                vector = {"name": rest, "device": None, "body": b"", "out": [], "invalid": False}
+                vectors.append(vector)
+            elif keyword == "device":
+                vector["device"] = int(rest, 0)
+            elif keyword == "frame":
+                vector["body"] += bytes.fromhex(rest)
+            elif keyword == "out":
+                vector["out"].append(sample(rest.split()))
+            elif keyword == "invalid":
+                vector["invalid"] = True
+            elif keyword != "in":  # Encoder input, checked by the firmware test app
+                raise ValueError(f"unknown line {line!r}")
+    return vectors
+
+
+class GoldenVectorTest(unittest.TestCase):
+    def test_vectors(self):
+        vectors = load_vectors()
+        self.assertTrue(vectors)
+        for vector in vectors:
+            with self.subTest(vector["name"]):
+                if vector["invalid"]:
+                    with self.assertRaises(ValueError):
+                        telemetry_frame.decode_frames(vector["body"])
+                else:
+                    device_id, samples = telemetry_frame.decode_frames(vector["body"])
+                    self.assertEqual(vector["device"], device_id)
+                    self.assertEqual(vector["out"], samples)
+
+
+if __name__ == "__main__":
+    unittest.main()